@@ -0,0 +1,910 @@
+// ================================================================================
+// ================================================================================
+// - File:    logger_bench.c
+// - Purpose: Measure the per-call cost of the logger across message sizes,
+//            sinks, timestamp settings and thread counts
+//
+// Source Metadata
+// - Author:  Jonathan A. Webb
+// - Date:    October 16, 2026
+// - Version: 1.0
+// - Copyright: Copyright 2026, Jon Webb Inc.
+// ================================================================================
+// ================================================================================
+// Include modules here
+
+#define _POSIX_C_SOURCE 200809L
+#if defined(__linux__)
+  #define _DEFAULT_SOURCE   /* syscall() for perf_event_open */
+#endif
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(_WIN32)
+  #define BENCH_NULL_DEVICE "NUL"
+#else
+  #define BENCH_NULL_DEVICE "/dev/null"
+#endif
+
+#if defined(__linux__)
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+  #define BENCH_HAVE_PERF 1
+#else
+  #define BENCH_HAVE_PERF 0
+#endif
+// ================================================================================ 
+// ================================================================================ 
+
+/* ---- Scenario tables ---------------------------------------------------------- */
+
+typedef enum { CASE_FILTERED, CASE_SHORT, CASE_LONG, CASE_COUNT } bench_case;
+typedef enum { SINK_STREAM, SINK_FILE, SINK_DEVNULL, SINK_COUNT } bench_sink;
+
+static const char* const case_names[CASE_COUNT] = { "filtered", "short", "long" };
+static const char* const sink_names[SINK_COUNT] = { "stream", "file", "devnull" };
+
+#define BENCH_MAX_THREADS 64
+#define BENCH_MAX_RESULTS 256
+
+typedef enum {
+    PERF_CYCLES, PERF_INSTRUCTIONS, PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_BRANCH_MISSES,
+    PERF_COUNT
+} bench_perf;
+
+static const char* const perf_names[PERF_COUNT] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+};
+
+typedef struct {
+    char     name[64];
+    double   ns_per_call;   /* Mean time a caller spends per call */
+    double   calls_per_sec; /* Aggregate throughput across threads */
+    unsigned threads;
+    uint64_t calls;
+    double   perf[PERF_COUNT];     /* Hardware events per call (--perf) */
+    bool     perf_ok[PERF_COUNT];  /* Counter opened and was scheduled */
+} bench_result;
+
+/* Indexed by LoggerFlushPolicy; --tail and --replay both sweep it. */
+#define POLICY_COUNT 3
+static const char* const policy_names[POLICY_COUNT] = { "on_error", "always", "buffered" };
+
+/* A loaded trace, grouped by recorded thread (see --replay). */
+typedef struct {
+    const LoggerTraceEvent* ev;
+    const char**  files;        /* Synthetic file name per event, one pointer per site */
+    size_t*       order;        /* Event indices grouped by replay thread, in time order */
+    size_t        first[BENCH_MAX_THREADS];
+    size_t        count[BENCH_MAX_THREADS];
+    unsigned      threads;
+    double        speed;        /* Time compression; 0 = as fast as possible */
+} replay_plan;
+
+typedef struct {
+    Logger*    lg;
+    bench_case kind;
+    uint64_t   iters;
+    double     elapsed_ns;
+    /* --tail only */
+    bool          tail;
+    double        interval_ns;  /* Schedule spacing for this thread */
+    double        start_ns;     /* Common schedule origin */
+    LoggerLatency service;      /* Call start -> return */
+    LoggerLatency corrected;    /* Intended start -> return */
+    /* --replay only */
+    const replay_plan* plan;
+    unsigned           replay_thread;
+} bench_worker;
+
+static const char k_long_text[] =
+    "request completed: method=GET path=/api/v1/accounts/0000000000/transactions "
+    "status=200 bytes=18342 upstream=payments-7f9c4d duration_ms=12.734 "
+    "user_agent=\"Mozilla/5.0 (X11; Linux x86_64)\" trace=4bf92f3577b34da6a3ce929d0e0e4736";
+// -------------------------------------------------------------------------------- 
+
+static double now_ns(void) {
+    struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+// ================================================================================ 
+// ================================================================================ 
+
+/* ---- Threads -------------------------------------------------------------------
+   Same selection as the logger's mutex: C11 threads, Win32 or pthreads. */
+
+/* Open-loop pacing: call i is due at start + i * interval regardless of how
+   long earlier calls took. Measuring from the due time instead of the actual
+   start charges a stall to every call it delayed, which is the
+   coordinated-omission correction. A thread that was scheduled late starts
+   its own schedule on arrival; the delay was the OS's, not the logger's. */
+static void run_tail(bench_worker* w) {
+    double origin = now_ns();
+    if (origin < w->start_ns) origin = w->start_ns;
+    for (uint64_t i = 0; i < w->iters; ++i) {
+        double due = origin + (double)i * w->interval_ns;
+        double now = now_ns();
+        if (due - now > 200000.0) {
+            double gap = due - now - 100000.0;
+            struct timespec nap = { (time_t)(gap / 1e9), (long)((uint64_t)gap % 1000000000u) };
+            nanosleep(&nap, NULL);
+        }
+        while ((now = now_ns()) < due) {}
+        logger_log_impl(w->lg, LOG_INFO, __FILE__, __LINE__, __func__, "tick %llu",
+                        (unsigned long long)i);
+        double end = now_ns();
+        logger_latency_add(&w->service, (uint64_t)(end - now));
+        logger_latency_add(&w->corrected, (uint64_t)(end - due));
+    }
+}
+
+/* Replays this thread's share of a trace: same level, call site, message and
+   field sizes, at the recorded offsets divided by the speed factor. */
+static void run_replay(bench_worker* w) {
+    char msg[4096];
+    char val[4096];
+    static const char* const keys[16] = { "k0", "k1", "k2", "k3", "k4", "k5", "k6", "k7",
+                                          "k8", "k9", "ka", "kb", "kc", "kd", "ke", "kf" };
+    memset(msg, 'm', sizeof(msg));
+    memset(val, 'v', sizeof(val));
+    const replay_plan* p = w->plan;
+    size_t first = p->first[w->replay_thread];
+    for (size_t k = 0; k < p->count[w->replay_thread]; ++k) {
+        size_t i = p->order[first + k];
+        const LoggerTraceEvent* e = &p->ev[i];
+        if (p->speed > 0.0) {
+            double due = w->start_ns + (double)e->t_ns / p->speed;
+            double now = now_ns();
+            if (due - now > 200000.0) {
+                double gap = due - now - 100000.0;
+                struct timespec nap = { (time_t)(gap / 1e9), (long)((uint64_t)gap % 1000000000u) };
+                nanosleep(&nap, NULL);
+            }
+            while (now_ns() < due) {}
+        }
+        LogLevel level = (LogLevel)e->level;
+        size_t len = e->msg_len < sizeof(msg) - 1 ? e->msg_len : sizeof(msg) - 1;
+        double t0 = now_ns();
+        if (e->flags & LOGGER_TRACE_FILTERED) {
+            if (level < w->lg->level) {
+                logger_write(w->lg, level, p->files[i], (int)e->line, "replay", "x");
+            } else {
+                logger_count_filtered(w->lg, level);  /* category-filtered */
+            }
+        } else if (e->n_fields == 0) {
+            msg[len] = '\0';
+            logger_write(w->lg, level, p->files[i], (int)e->line, "replay", msg);
+            msg[len] = 'm';
+        } else {
+            LoggerField fields[16];
+            size_t nf = e->n_fields < 16 ? e->n_fields : 16;
+            size_t per = e->fields_len / nf;
+            size_t vlen = per > 2 ? per - 2 : 0;  /* keys are two bytes */
+            if (vlen > sizeof(val)) vlen = sizeof(val);
+            for (size_t f = 0; f < nf; ++f) fields[f] = LKV_STRN(keys[f], val, vlen);
+            LogSite site = { p->files[i], (int)e->line, "replay" };
+            msg[len] = '\0';
+            logger_kv_impl(w->lg, level, &site, msg, fields, nf);
+            msg[len] = 'm';
+        }
+        logger_latency_add(&w->service, (uint64_t)(now_ns() - t0));
+    }
+}
+
+static void run_worker(bench_worker* w) {
+    if (w->tail) { run_tail(w); return; }
+    if (w->plan) { run_replay(w); return; }
+    Logger* lg = w->lg;
+    double t0 = now_ns();
+    switch (w->kind) {
+        case CASE_FILTERED:
+            for (uint64_t i = 0; i < w->iters; ++i)
+                logger_log_impl(lg, LOG_DEBUG, __FILE__, __LINE__, __func__, "filtered %llu",
+                                (unsigned long long)i);
+            break;
+        case CASE_SHORT:
+            for (uint64_t i = 0; i < w->iters; ++i)
+                logger_log_impl(lg, LOG_INFO, __FILE__, __LINE__, __func__, "tick %llu",
+                                (unsigned long long)i);
+            break;
+        case CASE_LONG:
+        default:
+            for (uint64_t i = 0; i < w->iters; ++i)
+                logger_log_impl(lg, LOG_INFO, __FILE__, __LINE__, __func__, "%s seq=%llu",
+                                k_long_text, (unsigned long long)i);
+            break;
+    }
+    w->elapsed_ns = now_ns() - t0;
+}
+
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+static int worker_main(void* arg) { run_worker((bench_worker*)arg); return 0; }
+static bool thread_start(logger_thread_t* t, bench_worker* w) {
+    return thrd_create(t, worker_main, w) == thrd_success;
+}
+static void thread_join(logger_thread_t t) { thrd_join(t, NULL); }
+#elif defined(_WIN32)
+static DWORD WINAPI worker_main(LPVOID arg) { run_worker((bench_worker*)arg); return 0; }
+static bool thread_start(logger_thread_t* t, bench_worker* w) {
+    *t = CreateThread(NULL, 0, worker_main, w, 0, NULL);
+    return *t != NULL;
+}
+static void thread_join(logger_thread_t t) { WaitForSingleObject(t, INFINITE); CloseHandle(t); }
+#else
+static void* worker_main(void* arg) { run_worker((bench_worker*)arg); return NULL; }
+static bool thread_start(logger_thread_t* t, bench_worker* w) {
+    return pthread_create(t, NULL, worker_main, w) == 0;
+}
+static void thread_join(logger_thread_t t) { pthread_join(t, NULL); }
+#endif
+// ================================================================================ 
+// ================================================================================ 
+
+/* ---- Hardware counters (--perf) ------------------------------------------------
+   One perf_event_open counter per event for this process, user space only,
+   inherited by the worker threads created while it is enabled (their counts
+   fold into the parent's when they are joined). Counters are not grouped, so
+   the kernel may multiplex them; values are scaled by enabled/running time.
+   Any event that cannot be opened (no PMU in a VM, perf_event_paranoid,
+   seccomp) is reported as missing and the run continues. */
+
+typedef struct {
+    int fd[PERF_COUNT];
+} bench_counters;
+
+#if BENCH_HAVE_PERF
+static int perf_open(bench_perf which) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    switch (which) {
+        case PERF_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case PERF_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case PERF_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PERF_LLC_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case PERF_BRANCH_MISSES:
+        default:
+            attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    }
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/* Returns false (after one warning) when no counter at all is available. */
+static bool counters_open(bench_counters* c) {
+    static bool warned;
+    bool any = false;
+    int err = ENOSYS;
+    for (int i = 0; i < PERF_COUNT; ++i) {
+#if BENCH_HAVE_PERF
+        c->fd[i] = perf_open((bench_perf)i);
+        if (c->fd[i] < 0) err = errno;
+#else
+        c->fd[i] = -1;
+#endif
+        any |= c->fd[i] >= 0;
+    }
+    if (!any && !warned) {
+        warned = true;
+        fprintf(stderr, "logger_bench: hardware counters unavailable (%s); "
+                        "reporting wall-clock only\n", strerror(err));
+    }
+    return any;
+}
+
+static void counters_enable(bench_counters* c, bool on) {
+#if BENCH_HAVE_PERF
+    for (int i = 0; i < PERF_COUNT; ++i) {
+        if (c->fd[i] < 0) continue;
+        if (on) ioctl(c->fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(c->fd[i], on ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0);
+    }
+#else
+    (void)c; (void)on;
+#endif
+}
+
+/* Stores events per call in out->perf and closes the counters. */
+static void counters_close(bench_counters* c, bench_result* out) {
+    for (int i = 0; i < PERF_COUNT; ++i) {
+        out->perf_ok[i] = false;
+        out->perf[i] = 0.0;
+#if BENCH_HAVE_PERF
+        if (c->fd[i] < 0) continue;
+        uint64_t v[3];  /* value, time enabled, time running */
+        if (read(c->fd[i], v, sizeof(v)) == (ssize_t)sizeof(v) && v[2] > 0 && out->calls > 0) {
+            double scaled = (double)v[0] * ((double)v[1] / (double)v[2]);
+            out->perf[i] = scaled / (double)out->calls;
+            out->perf_ok[i] = true;
+        }
+        close(c->fd[i]);
+#endif
+        c->fd[i] = -1;
+    }
+}
+// ================================================================================ 
+// ================================================================================ 
+
+/* ---- Running one scenario ------------------------------------------------------ */
+
+static bool open_logger(Logger* lg, bench_sink sink, FILE** scratch, const char* file_path) {
+    *scratch = NULL;
+    switch (sink) {
+        case SINK_STREAM:
+            *scratch = tmpfile();
+            return *scratch && logger_init_stream(lg, *scratch, LOG_INFO);
+        case SINK_FILE:
+            return logger_init_file(lg, file_path, LOG_INFO);
+        case SINK_DEVNULL:
+        default:
+            return logger_init_file(lg, BENCH_NULL_DEVICE, LOG_INFO);
+    }
+}
+
+static bool run_scenario(bench_case kind, bench_sink sink, bool timestamps, unsigned threads,
+                         uint64_t total_iters, const char* file_path, bool perf,
+                         bench_result* out) {
+    Logger* lg = malloc(sizeof(*lg));
+    static bench_worker workers[BENCH_MAX_THREADS];
+    logger_thread_t tids[BENCH_MAX_THREADS];
+    FILE* scratch;
+    if (!lg || !open_logger(lg, sink, &scratch, file_path)) {
+        fprintf(stderr, "logger_bench: cannot open %s sink: %s\n", sink_names[sink], strerror(errno));
+        free(lg);
+        return false;
+    }
+    logger_enable_timestamps(lg, timestamps);
+    logger_enable_colors(lg, false);
+    logger_enable_locking(lg, true);
+
+    uint64_t per_thread = total_iters / threads ? total_iters / threads : 1u;
+    unsigned started = 0;
+    bench_counters counters;
+    bool counting = perf && counters_open(&counters);
+    if (counting) counters_enable(&counters, true);
+    double t0 = now_ns();
+    for (unsigned i = 0; i < threads; ++i) {
+        memset(&workers[i], 0, sizeof(workers[i]));
+        workers[i].lg = lg;
+        workers[i].kind = kind;
+        workers[i].iters = per_thread;
+        if (threads == 1) { run_worker(&workers[0]); started = 1; break; }
+        if (!thread_start(&tids[i], &workers[i])) break;
+        ++started;
+    }
+    if (threads > 1) for (unsigned i = 0; i < started; ++i) thread_join(tids[i]);
+    double wall = now_ns() - t0;
+    if (counting) counters_enable(&counters, false);
+
+    double busy = 0.0;
+    for (unsigned i = 0; i < started; ++i) busy += workers[i].elapsed_ns;
+    uint64_t calls = per_thread * started;
+
+    snprintf(out->name, sizeof(out->name), "%s/%s/%s/t%u", case_names[kind], sink_names[sink],
+             timestamps ? "ts" : "nots", threads);
+    out->threads = threads;
+    out->calls = calls;
+    out->ns_per_call = calls ? busy / (double)calls : 0.0;
+    out->calls_per_sec = wall > 0.0 ? (double)calls * 1e9 / wall : 0.0;
+    memset(out->perf_ok, 0, sizeof(out->perf_ok));
+    if (counting) counters_close(&counters, out);
+
+    logger_close(lg);
+    if (scratch) fclose(scratch);
+    if (sink == SINK_FILE) remove(file_path);
+    free(lg);
+    return started == threads;
+}
+// -------------------------------------------------------------------------------- 
+
+static const double k_tail_quantiles[] = { 0.5, 0.9, 0.99, 0.999, 0.9999 };
+#define TAIL_QUANTILES (sizeof(k_tail_quantiles) / sizeof(k_tail_quantiles[0]))
+
+static void merge_latency(LoggerLatency* into, const LoggerLatency* h) {
+    into->count += h->count;
+    into->sum_ns += h->sum_ns;
+    if (h->max_ns > into->max_ns) into->max_ns = h->max_ns;
+    for (size_t i = 0; i < LOGGER_LATENCY_BUCKETS; ++i) into->buckets[i] += h->buckets[i];
+}
+
+static void print_tail_row(FILE* f, const char* name, unsigned threads, double rate,
+                           const char* kind, const LoggerLatency* h, bool json, bool last) {
+    if (json) {
+        fprintf(f, "  {\"name\":\"%s\",\"threads\":%u,\"rate_per_thread\":%.0f,"
+                   "\"latency\":\"%s\",\"calls\":%llu", name, threads, rate, kind,
+                (unsigned long long)h->count);
+        for (size_t q = 0; q < TAIL_QUANTILES; ++q)
+            fprintf(f, ",\"p%g\":%llu", k_tail_quantiles[q] * 100.0,
+                    (unsigned long long)logger_latency_percentile(h, k_tail_quantiles[q]));
+        fprintf(f, ",\"max\":%llu}%s\n", (unsigned long long)h->max_ns, last ? "" : ",");
+    } else {
+        fprintf(f, "%s,%u,%.0f,%s,%llu", name, threads, rate, kind, (unsigned long long)h->count);
+        for (size_t q = 0; q < TAIL_QUANTILES; ++q)
+            fprintf(f, ",%llu", (unsigned long long)logger_latency_percentile(h, k_tail_quantiles[q]));
+        fprintf(f, ",%llu\n", (unsigned long long)h->max_ns);
+    }
+}
+
+/* Fixed-rate run: every thread issues rate calls/s for duration_ms under one
+   flush policy and keeps both the service-time and the corrected latency
+   histograms. The records are INFO, so ON_ERROR never flushes and behaves
+   like BUFFERED; ALWAYS pays for one write per record. */
+static bool run_tail_scenario(LoggerFlushPolicy policy, bench_sink sink, unsigned threads, double rate,
+                              uint32_t duration_ms, const char* file_path, bool json, bool last) {
+    Logger* lg = malloc(sizeof(*lg));
+    static bench_worker workers[BENCH_MAX_THREADS];
+    logger_thread_t tids[BENCH_MAX_THREADS];
+    FILE* scratch;
+    if (!lg || !open_logger(lg, sink, &scratch, file_path)) {
+        fprintf(stderr, "logger_bench: cannot open %s sink: %s\n", sink_names[sink], strerror(errno));
+        free(lg);
+        return false;
+    }
+    logger_enable_colors(lg, false);
+    logger_set_flush_policy(lg, policy);
+
+    uint64_t per_thread = (uint64_t)(rate * (double)duration_ms / 1000.0);
+    if (per_thread == 0) per_thread = 1;
+    /* Leave time for every thread to start: 1 ms plus 250 us per thread. */
+    double start = now_ns() + 1e6 + 2.5e5 * (double)threads;
+    unsigned started = 0;
+    for (unsigned i = 0; i < threads; ++i) {
+        bench_worker* w = &workers[i];
+        memset(w, 0, sizeof(*w));
+        w->lg = lg;
+        w->iters = per_thread;
+        w->tail = true;
+        w->interval_ns = 1e9 / rate;
+        w->start_ns = start;
+        if (!thread_start(&tids[i], w)) break;
+        ++started;
+    }
+    for (unsigned i = 0; i < started; ++i) thread_join(tids[i]);
+
+    static LoggerLatency service, corrected;
+    memset(&service, 0, sizeof(service));
+    memset(&corrected, 0, sizeof(corrected));
+    for (unsigned i = 0; i < started; ++i) {
+        merge_latency(&service, &workers[i].service);
+        merge_latency(&corrected, &workers[i].corrected);
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "tail/%s/%s/t%u", policy_names[policy], sink_names[sink], threads);
+    print_tail_row(stdout, name, threads, rate, "service", &service, json, false);
+    print_tail_row(stdout, name, threads, rate, "corrected", &corrected, json, last);
+
+    logger_close(lg);
+    if (scratch) fclose(scratch);
+    if (sink == SINK_FILE) remove(file_path);
+    free(lg);
+    return started == threads;
+}
+// ================================================================================ 
+// ================================================================================ 
+
+/* ---- Trace replay (--replay) ---------------------------------------------------
+   A trace from logger_trace_start()/logger_trace_save() is replayed once per
+   configuration: flush policy x stdio buffer size on a file sink. Each
+   recorded thread gets its own replay thread (ids beyond BENCH_MAX_THREADS
+   share). Call sites get stable synthetic file names of the recorded length
+   so per-site caches and the budget behave as they did in production. */
+
+#define REPLAY_SITE_SLOTS 65536u
+
+typedef struct {
+    uint32_t    site;
+    uint16_t    file_len;
+    const char* name;
+} replay_site;
+
+static const char* replay_site_name(replay_site* table, uint32_t site, uint16_t file_len) {
+    size_t h = ((size_t)site * 2654435761u + file_len) % REPLAY_SITE_SLOTS;
+    for (size_t probe = 0; probe < REPLAY_SITE_SLOTS; ++probe) {
+        replay_site* s = &table[(h + probe) % REPLAY_SITE_SLOTS];
+        if (s->name && s->site == site && s->file_len == file_len) return s->name;
+        if (!s->name) {
+            char* name = malloc((size_t)file_len + 1u);
+            if (!name) return "replay.c";
+            memset(name, '_', file_len);
+            char tag[16];
+            int n = snprintf(tag, sizeof(tag), "s%08x", (unsigned)site);
+            memcpy(name, tag, (size_t)n < file_len ? (size_t)n : file_len);
+            name[file_len] = '\0';
+            s->site = site;
+            s->file_len = file_len;
+            s->name = name;
+            return name;
+        }
+    }
+    return "replay.c";  /* table full: remaining sites share a name */
+}
+
+static bool replay_load(const char* path, double speed, replay_plan* p, size_t* n_out) {
+    size_t n = 0;
+    if (!logger_trace_load(path, NULL, 0, &n)) {
+        fprintf(stderr, "logger_bench: cannot read trace %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    if (n == 0) {
+        fprintf(stderr, "logger_bench: trace %s is empty\n", path);
+        return false;
+    }
+    LoggerTraceEvent* ev = malloc(n * sizeof(*ev));
+    replay_site* sites = calloc(REPLAY_SITE_SLOTS, sizeof(*sites));
+    memset(p, 0, sizeof(*p));
+    p->files = malloc(n * sizeof(*p->files));
+    p->order = malloc(n * sizeof(*p->order));
+    if (!ev || !sites || !p->files || !p->order || !logger_trace_load(path, ev, n, &n)) {
+        fprintf(stderr, "logger_bench: cannot load trace %s: %s\n", path, strerror(errno));
+        free(ev); free(sites); free(p->files); free(p->order);
+        return false;
+    }
+    /* Map recorded thread ids to replay threads in order of appearance. */
+    uint32_t ids[BENCH_MAX_THREADS];
+    unsigned* slot = malloc(n * sizeof(*slot));
+    if (!slot) { free(ev); free(sites); free(p->files); free(p->order); return false; }
+    for (size_t i = 0; i < n; ++i) {
+        unsigned t = 0;
+        while (t < p->threads && ids[t] != ev[i].thread) ++t;
+        if (t == p->threads) {
+            if (p->threads < BENCH_MAX_THREADS) ids[p->threads++] = ev[i].thread;
+            else t = ev[i].thread % BENCH_MAX_THREADS;
+        }
+        slot[i] = t;
+        p->count[t]++;
+        p->files[i] = ev[i].file_len ? replay_site_name(sites, ev[i].site, ev[i].file_len) : "";
+    }
+    for (unsigned t = 1; t < BENCH_MAX_THREADS; ++t) p->first[t] = p->first[t - 1] + p->count[t - 1];
+    size_t fill[BENCH_MAX_THREADS];
+    memcpy(fill, p->first, sizeof(fill));
+    for (size_t i = 0; i < n; ++i) p->order[fill[slot[i]]++] = i;
+    free(slot);
+    free(sites);  /* names stay allocated for the life of the process */
+    p->ev = ev;
+    p->speed = speed;
+    *n_out = n;
+    return true;
+}
+
+/* Lowest level that was emitted in the trace, so the replay filters alike. */
+static LogLevel replay_level(const replay_plan* p, size_t n) {
+    int lvl = LOG_CRITICAL;
+    bool any = false;
+    for (size_t i = 0; i < n; ++i) {
+        if (p->ev[i].flags & LOGGER_TRACE_FILTERED) continue;
+        if (p->ev[i].level < lvl) lvl = p->ev[i].level;
+        any = true;
+    }
+    return any ? (LogLevel)lvl : LOG_DEBUG;
+}
+
+static const size_t k_replay_buffers[] = { 4096u, 65536u, 1u << 20 };
+
+static bool run_replay_config(const replay_plan* plan, size_t n, LoggerFlushPolicy policy,
+                              size_t buf_size, const char* file_path, bool json, bool last) {
+    Logger* lg = malloc(sizeof(*lg));
+    char* buf = malloc(buf_size);
+    static bench_worker workers[BENCH_MAX_THREADS];
+    logger_thread_t tids[BENCH_MAX_THREADS];
+    if (!lg || !buf ||
+        !logger_init_file_buffered(lg, file_path, replay_level(plan, n), buf, buf_size)) {
+        fprintf(stderr, "logger_bench: cannot open %s: %s\n", file_path, strerror(errno));
+        free(lg); free(buf);
+        return false;
+    }
+    logger_set_flush_policy(lg, policy);
+    logger_enable_colors(lg, false);
+
+    double start = now_ns() + 1e6;
+    unsigned started = 0;
+    for (unsigned i = 0; i < plan->threads; ++i) {
+        bench_worker* w = &workers[i];
+        memset(w, 0, sizeof(*w));
+        w->lg = lg;
+        w->plan = plan;
+        w->replay_thread = i;
+        w->start_ns = start;
+        if (!thread_start(&tids[i], w)) break;
+        ++started;
+    }
+    for (unsigned i = 0; i < started; ++i) thread_join(tids[i]);
+    double wall = now_ns() - start;
+
+    static LoggerLatency service;
+    memset(&service, 0, sizeof(service));
+    for (unsigned i = 0; i < started; ++i) merge_latency(&service, &workers[i].service);
+    LoggerStats st;
+    logger_get_stats(lg, &st);
+
+    char name[64];
+    snprintf(name, sizeof(name), "replay/%s/buf%zu", policy_names[policy], buf_size);
+    double mean = service.count ? (double)service.sum_ns / (double)service.count : 0.0;
+    if (json) {
+        fprintf(stdout, "  {\"name\":\"%s\",\"events\":%zu,\"threads\":%u,\"speed\":%g,"
+                        "\"ns_per_call\":%.2f,\"p50\":%llu,\"p99\":%llu,\"p99.9\":%llu,"
+                        "\"max\":%llu,\"wall_ms\":%.1f,\"flushes\":%llu,\"bytes\":%llu}%s\n",
+                name, n, plan->threads, plan->speed, mean,
+                (unsigned long long)logger_latency_percentile(&service, 0.5),
+                (unsigned long long)logger_latency_percentile(&service, 0.99),
+                (unsigned long long)logger_latency_percentile(&service, 0.999),
+                (unsigned long long)service.max_ns, wall / 1e6,
+                (unsigned long long)st.flushes, (unsigned long long)st.bytes[LOGGER_SINK_FILE],
+                last ? "" : ",");
+    } else {
+        fprintf(stdout, "%s,%zu,%u,%g,%.2f,%llu,%llu,%llu,%llu,%.1f,%llu,%llu\n",
+                name, n, plan->threads, plan->speed, mean,
+                (unsigned long long)logger_latency_percentile(&service, 0.5),
+                (unsigned long long)logger_latency_percentile(&service, 0.99),
+                (unsigned long long)logger_latency_percentile(&service, 0.999),
+                (unsigned long long)service.max_ns, wall / 1e6,
+                (unsigned long long)st.flushes, (unsigned long long)st.bytes[LOGGER_SINK_FILE]);
+    }
+
+    logger_close(lg);
+    remove(file_path);
+    free(buf);
+    free(lg);
+    return started == plan->threads;
+}
+
+static int run_replay_suite(const char* trace, double speed, const char* file_path, bool json) {
+    replay_plan plan;
+    size_t n = 0;
+    if (!replay_load(trace, speed, &plan, &n)) return 1;
+    if (json) fputs("[\n", stdout);
+    else fputs("name,events,threads,speed,ns_per_call,p50_ns,p99_ns,p99.9_ns,max_ns,"
+               "wall_ms,flushes,bytes\n", stdout);
+    const size_t n_buf = sizeof(k_replay_buffers) / sizeof(k_replay_buffers[0]);
+    for (int pol = 0; pol <= LOGGER_FLUSH_BUFFERED; ++pol) {
+        for (size_t b = 0; b < n_buf; ++b) {
+            bool last = pol == LOGGER_FLUSH_BUFFERED && b + 1 == n_buf;
+            if (!run_replay_config(&plan, n, (LoggerFlushPolicy)pol, k_replay_buffers[b],
+                                   file_path, json, last)) {
+                return 1;
+            }
+        }
+    }
+    if (json) fputs("]\n", stdout);
+    free((void*)plan.ev);
+    free(plan.files);
+    free(plan.order);
+    return 0;
+}
+// ================================================================================ 
+// ================================================================================ 
+
+/* ---- Output and baseline comparison -------------------------------------------- */
+
+static void print_results(FILE* f, const bench_result* r, size_t n, bool json, bool perf) {
+    if (json) {
+        fputs("[\n", f);
+        for (size_t i = 0; i < n; ++i) {
+            fprintf(f, "  {\"name\":\"%s\",\"threads\":%u,\"calls\":%llu,"
+                       "\"ns_per_call\":%.2f,\"calls_per_sec\":%.0f",
+                    r[i].name, r[i].threads, (unsigned long long)r[i].calls,
+                    r[i].ns_per_call, r[i].calls_per_sec);
+            for (int k = 0; perf && k < PERF_COUNT; ++k) {
+                if (r[i].perf_ok[k]) fprintf(f, ",\"%s_per_call\":%.2f", perf_names[k], r[i].perf[k]);
+                else                 fprintf(f, ",\"%s_per_call\":null", perf_names[k]);
+            }
+            fprintf(f, "}%s\n", i + 1 < n ? "," : "");
+        }
+        fputs("]\n", f);
+    } else {
+        fputs("name,threads,calls,ns_per_call,calls_per_sec", f);
+        for (int k = 0; perf && k < PERF_COUNT; ++k) fprintf(f, ",%s_per_call", perf_names[k]);
+        fputc('\n', f);
+        for (size_t i = 0; i < n; ++i) {
+            fprintf(f, "%s,%u,%llu,%.2f,%.0f", r[i].name, r[i].threads,
+                    (unsigned long long)r[i].calls, r[i].ns_per_call, r[i].calls_per_sec);
+            for (int k = 0; perf && k < PERF_COUNT; ++k) {
+                if (r[i].perf_ok[k]) fprintf(f, ",%.2f", r[i].perf[k]);
+                else                 fputc(',', f);  /* empty = not available */
+            }
+            fputc('\n', f);
+        }
+    }
+}
+
+/* Reads "name,...,ns_per_call,..." rows written by --format csv. Returns the
+   number of scenarios slower than the baseline by more than threshold %. */
+static int compare_baseline(const char* path, const bench_result* r, size_t n, double threshold) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "logger_bench: cannot open baseline %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    int regressions = 0;
+    char line[256];
+    fprintf(stderr, "%-32s %12s %12s %8s\n", "scenario", "base ns", "now ns", "delta");
+    while (fgets(line, sizeof(line), f)) {
+        char name[64];
+        unsigned threads;
+        unsigned long long calls;
+        double ns;
+        if (sscanf(line, "%63[^,],%u,%llu,%lf", name, &threads, &calls, &ns) != 4) continue;
+        for (size_t i = 0; i < n; ++i) {
+            if (strcmp(name, r[i].name) != 0 || ns <= 0.0) continue;
+            double delta = (r[i].ns_per_call - ns) * 100.0 / ns;
+            bool bad = delta > threshold;
+            regressions += bad;
+            fprintf(stderr, "%-32s %12.2f %12.2f %+7.1f%%%s\n", name, ns, r[i].ns_per_call,
+                    delta, bad ? "  REGRESSION" : "");
+        }
+    }
+    fclose(f);
+    return regressions;
+}
+// ================================================================================ 
+// ================================================================================ 
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --format csv|json    result format on stdout (default csv)\n"
+            "  --iters N            calls per scenario, split across threads (default 200000)\n"
+            "  --threads a,b,...    thread counts, 1..%d (default 1,4,16,64)\n"
+            "  --only TEXT          run scenarios whose name contains TEXT\n"
+            "  --baseline FILE      compare ns/call against a saved csv run\n"
+            "  --threshold PCT      allowed slowdown before failing (default 10)\n"
+            "  --tail               fixed-rate latency spectrum per flush policy\n"
+            "  --rate R             calls/s per thread in --tail mode (default 10000)\n"
+            "  --duration-ms D      length of each --tail run (default 2000)\n"
+            "  --sink stream|file|devnull  sink for --tail (default file)\n"
+            "  --perf               add hardware counters per call (Linux perf events)\n"
+            "  --replay TRACE       replay a logger_trace_save() file per flush policy and buffer size\n"
+            "  --speed X            replay time compression (default 1, 0 = unpaced)\n",
+            prog, BENCH_MAX_THREADS);
+}
+
+// -------------------------------------------------------------------------------- 
+
+int main(int argc, char* argv[]) {
+    bool json = false;
+    uint64_t iters = 200000;
+    unsigned thread_counts[16] = { 1, 4, 16, 64 };
+    size_t n_threads = 4;
+    const char* only = NULL;
+    const char* baseline = NULL;
+    double threshold = 10.0;
+    bool tail = false;
+    double rate = 10000.0;
+    uint32_t duration_ms = 2000;
+    bench_sink tail_sink = SINK_FILE;
+    bool perf = false;
+    const char* replay = NULL;
+    double speed = 1.0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "--format") == 0 && v) {
+            json = strcmp(v, "json") == 0;
+            if (!json && strcmp(v, "csv") != 0) { usage(argv[0]); return 2; }
+            ++i;
+        } else if (strcmp(a, "--iters") == 0 && v) {
+            iters = strtoull(v, NULL, 10);
+            ++i;
+        } else if (strcmp(a, "--threads") == 0 && v) {
+            n_threads = 0;
+            for (char* p = argv[++i]; *p && n_threads < 16; ) {
+                unsigned long t = strtoul(p, &p, 10);
+                if (t < 1 || t > BENCH_MAX_THREADS) { usage(argv[0]); return 2; }
+                thread_counts[n_threads++] = (unsigned)t;
+                if (*p == ',') ++p;
+                else if (*p) { usage(argv[0]); return 2; }
+            }
+        } else if (strcmp(a, "--only") == 0 && v) {
+            only = argv[++i];
+        } else if (strcmp(a, "--baseline") == 0 && v) {
+            baseline = argv[++i];
+        } else if (strcmp(a, "--threshold") == 0 && v) {
+            threshold = strtod(argv[++i], NULL);
+        } else if (strcmp(a, "--replay") == 0 && v) {
+            replay = argv[++i];
+        } else if (strcmp(a, "--speed") == 0 && v) {
+            speed = strtod(argv[++i], NULL);
+        } else if (strcmp(a, "--perf") == 0) {
+            perf = true;
+        } else if (strcmp(a, "--tail") == 0) {
+            tail = true;
+        } else if (strcmp(a, "--rate") == 0 && v) {
+            rate = strtod(argv[++i], NULL);
+        } else if (strcmp(a, "--duration-ms") == 0 && v) {
+            duration_ms = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(a, "--sink") == 0 && v) {
+            int k = 0;
+            while (k < SINK_COUNT && strcmp(v, sink_names[k]) != 0) ++k;
+            if (k == SINK_COUNT) { usage(argv[0]); return 2; }
+            tail_sink = (bench_sink)k;
+            ++i;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (iters == 0 || n_threads == 0 || rate <= 0.0 || duration_ms == 0 || speed < 0.0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const char* file_path = "logger_bench.log";
+    if (replay) return run_replay_suite(replay, speed, file_path, json);
+    if (tail) {
+        if (json) fputs("[\n", stdout);
+        else {
+            fputs("name,threads,rate_per_thread,latency,calls", stdout);
+            for (size_t q = 0; q < TAIL_QUANTILES; ++q)
+                fprintf(stdout, ",p%g_ns", k_tail_quantiles[q] * 100.0);
+            fputs(",max_ns\n", stdout);
+        }
+        for (int m = 0; m < POLICY_COUNT; ++m) {
+            for (size_t t = 0; t < n_threads; ++t) {
+                bool last = m + 1 == POLICY_COUNT && t + 1 == n_threads;
+                if (!run_tail_scenario((LoggerFlushPolicy)m, tail_sink, thread_counts[t], rate,
+                                       duration_ms, file_path, json, last)) {
+                    return 1;
+                }
+            }
+        }
+        if (json) fputs("]\n", stdout);
+        return 0;
+    }
+
+    static bench_result results[BENCH_MAX_RESULTS];
+    size_t n = 0;
+    for (int c = 0; c < CASE_COUNT; ++c) {
+        for (int s = 0; s < SINK_COUNT; ++s) {
+            for (int ts = 1; ts >= 0; --ts) {
+                for (size_t t = 0; t < n_threads && n < BENCH_MAX_RESULTS; ++t) {
+                    bench_result r;
+                    char name[64];
+                    snprintf(name, sizeof(name), "%s/%s/%s/t%u", case_names[c], sink_names[s],
+                             ts ? "ts" : "nots", thread_counts[t]);
+                    if (only && !strstr(name, only)) continue;
+                    if (!run_scenario((bench_case)c, (bench_sink)s, ts != 0, thread_counts[t],
+                                      iters, file_path, perf, &r)) {
+                        return 1;
+                    }
+                    results[n++] = r;
+                }
+            }
+        }
+    }
+
+    print_results(stdout, results, n, json, perf);
+    if (baseline) {
+        int bad = compare_baseline(baseline, results, n, threshold);
+        if (bad != 0) return 1;
+    }
+    return 0;
+}
+// ================================================================================
+// ================================================================================
+// eof
@@ -20,16 +20,37 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 
+/* Atomic members of the public structs. A C++ includer sees std::atomic,
+   which has the same size and representation as the C11 type on the
+   supported compilers; the members are only operated on in logger.c and in
+   the inline helpers below. The macros built on compound literals (LOG_SITE,
+   LKV_*, LOG_KV, LFRAG, LOG_WRITEV and their users) remain C only; C++ code
+   calls the underlying functions directly. */
+#ifdef __cplusplus
+  #include <atomic>
+  #define LOGGER_ATOMIC(T)         std::atomic<T>
+  #define LOGGER_ALIGNAS(n)        alignas(n)
+  #define LOGGER_LOAD(p, order)    ((p)->load(std::memory_order_##order))
+#else
+  #include <stdatomic.h>
+  #define LOGGER_ATOMIC(T)         _Atomic(T)
+  #define LOGGER_ALIGNAS(n)        _Alignas(n)
+  #define LOGGER_LOAD(p, order)    atomic_load_explicit((p), memory_order_##order)
+#endif
+
 #if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
   /* C11 threads */
   #include <threads.h>
   typedef mtx_t logger_mutex_t;
   #define LOGGER_MUTEX_INIT_OK(m)    (mtx_init(&(m), mtx_plain) == thrd_success)
   #define LOGGER_MUTEX_LOCK(m)       mtx_lock(&(m))
+  #define LOGGER_MUTEX_TRYLOCK(m)    (mtx_trylock(&(m)) == thrd_success)
   #define LOGGER_MUTEX_UNLOCK(m)     mtx_unlock(&(m))
   #define LOGGER_MUTEX_DESTROY(m)    mtx_destroy(&(m))
+  typedef thrd_t logger_thread_t;
 
 #elif defined(_WIN32)
   /* Win32 */
@@ -38,8 +59,10 @@
   static inline bool logger_mutex_init_ok(logger_mutex_t* m) { InitializeCriticalSection(m); return true; }
   #define LOGGER_MUTEX_INIT_OK(m)    logger_mutex_init_ok(&(m))
   #define LOGGER_MUTEX_LOCK(m)       EnterCriticalSection(&(m))
+  #define LOGGER_MUTEX_TRYLOCK(m)    (TryEnterCriticalSection(&(m)) != 0)
   #define LOGGER_MUTEX_UNLOCK(m)     LeaveCriticalSection(&(m))
   #define LOGGER_MUTEX_DESTROY(m)    DeleteCriticalSection(&(m))
+  typedef HANDLE logger_thread_t;
 
 #else
   /* POSIX pthreads */
@@ -47,8 +70,10 @@
   typedef pthread_mutex_t logger_mutex_t;
   #define LOGGER_MUTEX_INIT_OK(m)    (pthread_mutex_init(&(m), NULL) == 0)
   #define LOGGER_MUTEX_LOCK(m)       pthread_mutex_lock(&(m))
+  #define LOGGER_MUTEX_TRYLOCK(m)    (pthread_mutex_trylock(&(m)) == 0)
   #define LOGGER_MUTEX_UNLOCK(m)     pthread_mutex_unlock(&(m))
   #define LOGGER_MUTEX_DESTROY(m)    pthread_mutex_destroy(&(m))
+  typedef pthread_t logger_thread_t;
 #endif
 // ================================================================================ 
 // ================================================================================ 
@@ -89,6 +114,429 @@ typedef enum {
 } LogLevel;
 // -------------------------------------------------------------------------------- 
 
+/**
+ * @enum LoggerFieldType
+ * @brief Type tag of a structured LoggerField.
+ */
+typedef enum {
+    LKV_T_INT,   /* int64_t   v.i */
+    LKV_T_UINT,  /* uint64_t  v.u */
+    LKV_T_F64,   /* double    v.f */
+    LKV_T_BOOL,  /* bool      v.b */
+    LKV_T_STR    /* string    v.s (n == (size_t)-1 means NUL-terminated) */
+} LoggerFieldType;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerField
+ * @brief One typed key/value pair attached to a structured record.
+ *
+ * Fields are consumed directly by the output encoders; values are never
+ * routed through a printf format string. Build them with the LKV_* macros.
+ * Neither the key nor string values are copied.
+ *
+ * Keys are written as given when they use only [A-Za-z0-9_.-] and are at
+ * most 63 bytes; other bytes become '_' and longer keys are cut. A key that
+ * names a part of the record itself (ts, level, logger, category, file, line,
+ * func, caller, msg, data) is written as "fields.<key>", so a field can never
+ * replace the record's own values.
+ */
+typedef struct LoggerField {
+    const char*     key;
+    LoggerFieldType type;
+    union {
+        int64_t  i;
+        uint64_t u;
+        double   f;
+        bool     b;
+        struct { const char* p; size_t n; } s;
+    } v;
+} LoggerField;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LogSite
+ * @brief Source location of a log call, captured by LOG_SITE().
+ */
+typedef struct LogSite {
+    const char* file;
+    int         line;
+    const char* func;
+} LogSite;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerFrag
+ * @brief One piece of a message passed to logger_writev().
+ *
+ * The bytes are read in place and need not be NUL-terminated. Build them
+ * with LFRAG() or LFRAG_LIT().
+ */
+typedef struct LoggerFrag {
+    const char* p;
+    size_t      n;
+} LoggerFrag;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LogRecord
+ * @brief One entry of a logger_write_batch() call.
+ *
+ * Nothing is copied; the message, site and fields must stay valid for the
+ * duration of the call.
+ */
+typedef struct LogRecord {
+    LogLevel           level;
+    const LogSite*     site;      /* Source location; NULL for unknown */
+    const char*        msg;       /* Message bytes, need not be NUL-terminated */
+    size_t             len;       /* (size_t)-1 means msg is NUL-terminated */
+    const LoggerField* fields;    /* Optional structured fields */
+    size_t             n_fields;
+} LogRecord;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @def LOGGER_MAX_CATEGORIES
+ * @brief Number of named category slots held inside each Logger.
+ *
+ * Categories live in a fixed table so that no heap is needed. Override at
+ * compile time (e.g., -DLOGGER_MAX_CATEGORIES=256) if more are required.
+ */
+#ifndef LOGGER_MAX_CATEGORIES
+#  define LOGGER_MAX_CATEGORIES 64
+#endif
+
+/**
+ * @def LOGGER_LEVEL_INHERIT
+ * @brief Pseudo-level meaning "use the nearest configured ancestor".
+ */
+#define LOGGER_LEVEL_INHERIT 0
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerCategory
+ * @brief One slot of a Logger's hierarchical category table.
+ *
+ * Categories are dotted paths such as "net.http.client". A category without
+ * an explicit level inherits from its nearest configured ancestor
+ * ("net.http", then "net"), and finally from the Logger's own level. The
+ * effective level is precomputed on every configuration change so that the
+ * runtime check is a single atomic load.
+ */
+typedef struct LoggerCategory {
+    const char*        name;       /* Dotted category path (not owned) */
+    int                configured; /* Explicit level, or LOGGER_LEVEL_INHERIT */
+    LOGGER_ATOMIC(int) level;      /* Effective level read on the hot path */
+} LoggerCategory;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerCategorySite
+ * @brief Per-call-site cache of a resolved category slot.
+ *
+ * Normally declared @c static by the LOG_CAT_* macros. The first call
+ * resolves the category name to a slot index; later calls reuse it.
+ * Zero-initialize before first use.
+ *
+ * The cached slot is tagged with the id of the logger that resolved it. A
+ * site shared by several loggers stays correct but re-resolves by name each
+ * time the logger changes, so give each logger its own site when that path
+ * is hot.
+ */
+typedef struct LoggerCategorySite {
+    LOGGER_ATOMIC(uint_least64_t) slot; /* (logger id << 16) | (index + 1); 0 = unresolved */
+} LoggerCategorySite;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @enum LoggerSinkId
+ * @brief Identifies one of a Logger's output sinks.
+ */
+typedef enum {
+    LOGGER_SINK_STREAM = 0, /* The 'stream' sink (e.g., stderr) */
+    LOGGER_SINK_FILE   = 1, /* The 'file' sink */
+    LOGGER_SINK_COUNT
+} LoggerSinkId;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @enum LoggerFormat
+ * @brief Record layout written to a sink.
+ */
+typedef enum {
+    LOGGER_FORMAT_TEXT = 0, /* Human-readable line (default); colors on TTYs */
+    LOGGER_FORMAT_JSON,     /* JSON Lines: one object per record */
+    LOGGER_FORMAT_LOGFMT,   /* logfmt: key=value pairs, one record per line */
+    LOGGER_FORMAT_CBOR,     /* Binary: one CBOR map per record (RFC 8949) */
+    LOGGER_FORMAT_OTLP,     /* Binary: length-delimited OTLP LogsData protobufs */
+    LOGGER_FORMAT_COUNT
+} LoggerFormat;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @enum LoggerFlushPolicy
+ * @brief When a record is pushed from the stdio buffer to the OS.
+ *
+ * Terminal streams are line-buffered at init, so each line still appears as
+ * soon as it is written; the policy matters for files, pipes and sockets.
+ */
+typedef enum {
+    LOGGER_FLUSH_ON_ERROR = 0, /* Flush ERROR and CRITICAL records (default) */
+    LOGGER_FLUSH_ALWAYS,       /* Flush after every record (one write per record) */
+    LOGGER_FLUSH_BUFFERED      /* Only when the buffer fills, on logger_flush() or logger_close() */
+} LoggerFlushPolicy;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerRepeatState
+ * @brief Per-sink record of the last emitted message for repeat collapsing.
+ *
+ * Holds a hash of the last record written to a sink and how many identical
+ * records have been swallowed since, plus enough of the call site to write
+ * the "last message repeated N times" summary.
+ */
+typedef struct LoggerRepeatState {
+    uint64_t    hash;     /* Hash of the last emitted record (0 = none) */
+    uint64_t    repeats;  /* Identical records swallowed since */
+    uint64_t    since_ns; /* Monotonic time of the last emission or summary */
+    LogLevel    level;    /* Call site of the last record, for the summary */
+    const char* category;
+    const char* file;
+    int         line;
+    const char* func;
+} LoggerRepeatState;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @def LOGGER_BUDGET_SITES
+ * @brief Number of call sites the adaptive budget can track per Logger.
+ *
+ * A site that logs nothing for a whole window and is not being sampled gives
+ * its slot back at the window's end. While the table is full, new sites are
+ * not throttled; logger_get_stats() counts their records as budget_untracked.
+ * Override at compile time if needed.
+ */
+#ifndef LOGGER_BUDGET_SITES
+#  define LOGGER_BUDGET_SITES 64
+#endif
+
+/**
+ * @def LOGGER_BUDGET_WINDOW_MS
+ * @brief Length of the adaptive budget's measurement window.
+ */
+#ifndef LOGGER_BUDGET_WINDOW_MS
+#  define LOGGER_BUDGET_WINDOW_MS 1000
+#endif
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerBudgetSite
+ * @brief Volume and sampling state of one call site under the adaptive budget.
+ */
+typedef struct LoggerBudgetSite {
+    LOGGER_ATOMIC(uintptr_t)      key;          /* Hash of file/line (0 = free slot) */
+    LOGGER_ATOMIC(uint_least64_t) records;      /* Admitted records this window */
+    LOGGER_ATOMIC(uint_least64_t) bytes;        /* Admitted message bytes this window */
+    LOGGER_ATOMIC(unsigned)       sample_shift; /* Keep 1 in 2^shift records (0 = all) */
+    LOGGER_ATOMIC(uint_least64_t) tick;         /* Sampling counter */
+} LoggerBudgetSite;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerBudget
+ * @brief Per-Logger records/bytes per second budget with automatic throttling.
+ *
+ * At the end of each window, if the Logger exceeded its budget, every call
+ * site producing more than its fair share of the volume is sampled down by
+ * a further power of two. Once volume falls below half the budget, throttled
+ * sites are restored one step per window. ERROR and CRITICAL are never
+ * throttled.
+ *
+ * Bytes are message bytes: the message text plus any binary payload
+ * (logger_hexdump()), before layout. Timestamps, prefixes, fields and the
+ * per-sink format are not charged, so the limit is the same whatever the
+ * sinks render.
+ */
+typedef struct LoggerBudget {
+    LOGGER_ATOMIC(uint_least32_t) records_per_sec;   /* 0 = no records limit */
+    LOGGER_ATOMIC(uint_least64_t) msg_bytes_per_sec; /* 0 = no message bytes limit */
+    LOGGER_ATOMIC(uint_least64_t) window_start_ns;   /* Monotonic start of the current window */
+    LOGGER_ATOMIC(uint_least64_t) window_records;    /* All records this window */
+    LOGGER_ATOMIC(uint_least64_t) window_bytes;      /* All message bytes this window */
+    LOGGER_ATOMIC(uint_least64_t) dropped;           /* Records sampled away (cumulative) */
+    LOGGER_ATOMIC(uint_least64_t) untracked;         /* Records from sites the table had no room for */
+    LoggerBudgetSite              sites[LOGGER_BUDGET_SITES];
+} LoggerBudget;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @def LOGGER_STATS_STRIPES
+ * @brief Number of counter stripes per Logger.
+ *
+ * Each thread updates the stripe picked for it on first use, so threads
+ * rarely share a cache line. logger_get_stats() sums all stripes.
+ */
+#ifndef LOGGER_STATS_STRIPES
+#  define LOGGER_STATS_STRIPES 8
+#endif
+
+/** @brief Number of LogLevel values; counters are indexed by level / 10 - 1. */
+#define LOGGER_LEVEL_COUNT 5
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerStatsStripe
+ * @brief One cache-line-aligned set of Logger counters (see LoggerStats).
+ */
+typedef struct LoggerStatsStripe {
+    LOGGER_ALIGNAS(64) LOGGER_ATOMIC(uint_least64_t) emitted[LOGGER_LEVEL_COUNT];
+    LOGGER_ATOMIC(uint_least64_t) filtered[LOGGER_LEVEL_COUNT];
+    LOGGER_ATOMIC(uint_least64_t) bytes[LOGGER_SINK_COUNT];
+    LOGGER_ATOMIC(uint_least64_t) flushes;
+    LOGGER_ATOMIC(uint_least64_t) write_errors;
+    LOGGER_ATOMIC(uint_least64_t) lock_wait_ns;
+    LOGGER_ATOMIC(uint_least64_t) truncated;
+    LOGGER_ATOMIC(uint_least64_t) collapsed;
+} LoggerStatsStripe;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerStats
+ * @brief Snapshot of a Logger's cumulative counters.
+ *
+ * Per-level arrays are indexed by level / 10 - 1 (DEBUG = 0 ... CRITICAL = 4).
+ */
+typedef struct LoggerStats {
+    uint64_t emitted[LOGGER_LEVEL_COUNT];  /* Records that passed every filter */
+    uint64_t filtered[LOGGER_LEVEL_COUNT]; /* Records below the level/category threshold */
+    uint64_t dropped;                      /* Records sampled away by the budget */
+    uint64_t budget_untracked;             /* Records from sites the budget table could not hold */
+    uint64_t bytes[LOGGER_SINK_COUNT];     /* Bytes handed to each sink */
+    uint64_t flushes;                      /* fflush calls */
+    uint64_t write_errors;                 /* Short writes or failed flushes */
+    uint64_t lock_wait_ns;                 /* Time spent blocked on the Logger lock */
+    uint64_t truncated;                    /* Records cut to fit the 1 MiB record limit */
+    uint64_t collapsed;                    /* Repeats folded into a summary (not in emitted) */
+} LoggerStats;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @def LOGGER_LATENCY_STRIPES
+ * @brief Number of latency histogram stripes per Logger.
+ *
+ * Threads map onto these the same way as onto the counter stripes.
+ */
+#ifndef LOGGER_LATENCY_STRIPES
+#  define LOGGER_LATENCY_STRIPES 4
+#endif
+
+/**
+ * @def LOGGER_LATENCY_BUCKETS
+ * @brief Buckets in a latency histogram.
+ *
+ * Values below 8 ns get exact buckets; above that each power of two is split
+ * into 8 linear sub-buckets (at most 12.5% wide), up to 2^40 ns.
+ */
+#define LOGGER_LATENCY_BUCKETS 304
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerLatencyStripe
+ * @brief One stripe of the call latency histogram (see LoggerLatency).
+ */
+typedef struct LoggerLatencyStripe {
+    LOGGER_ALIGNAS(64) LOGGER_ATOMIC(uint_least64_t) count;
+    LOGGER_ATOMIC(uint_least64_t) sum_ns;
+    LOGGER_ATOMIC(uint_least64_t) max_ns;
+    LOGGER_ATOMIC(uint_least64_t) buckets[LOGGER_LATENCY_BUCKETS];
+} LoggerLatencyStripe;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerLatencyHistogram
+ * @brief Caller-owned storage for a Logger's call latency histogram.
+ *
+ * About 10 KB; a Logger only points at one while the histogram is enabled
+ * (see logger_enable_latency_histogram()).
+ */
+typedef struct LoggerLatencyHistogram {
+    LoggerLatencyStripe stripes[LOGGER_LATENCY_STRIPES];
+} LoggerLatencyHistogram;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerLatency
+ * @brief Merged view of the time spent in a Logger's critical section.
+ *
+ * Filled by logger_latency_snapshot(); query it with logger_latency_percentile().
+ */
+typedef struct LoggerLatency {
+    uint64_t count;   /* Recorded calls */
+    uint64_t sum_ns;  /* Total time, for the mean */
+    uint64_t max_ns;  /* Slowest call */
+    uint64_t buckets[LOGGER_LATENCY_BUCKETS];
+} LoggerLatency;
+// -------------------------------------------------------------------------------- 
+
+/** @brief LoggerTraceEvent flag: the call was rejected by its level or category. */
+#define LOGGER_TRACE_FILTERED  0x01u
+/** @brief LoggerTraceEvent flag: the call was dropped by the adaptive budget. */
+#define LOGGER_TRACE_DROPPED   0x02u
+/** @brief LoggerTraceEvent flag: every sink folded the call into a repeat summary. */
+#define LOGGER_TRACE_COLLAPSED 0x04u
+
+/**
+ * @struct LoggerTraceEvent
+ * @brief Shape of one log call, recorded by logger_trace_start().
+ *
+ * Holds sizes and identities only, never message text, so a trace can be
+ * taken from production and replayed by logger_bench --replay.
+ */
+typedef struct LoggerTraceEvent {
+    uint64_t t_ns;       /* Monotonic time since logger_trace_start() */
+    uint32_t thread;     /* Per-thread id, 1-based, in order of first traced call */
+    uint32_t site;       /* Hash of the call site's file name pointer (0 = unknown) */
+    uint32_t line;       /* Call site line */
+    uint32_t msg_len;    /* Formatted message bytes (0 when not formatted) */
+    uint32_t fields_len; /* Bytes of field keys plus string values */
+    uint16_t file_len;   /* Length of the file name */
+    uint8_t  n_fields;   /* Structured fields (saturates at 255) */
+    uint8_t  level;      /* LogLevel */
+    uint8_t  flags;      /* LOGGER_TRACE_* */
+    uint8_t  reserved[7];
+} LoggerTraceEvent;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerTrace
+ * @brief Trace recorder state embedded in a Logger; treat as private.
+ */
+typedef struct LoggerTrace {
+    LOGGER_ATOMIC(bool)     on;
+    LOGGER_ATOMIC(unsigned) writers;  /* Calls currently filling an event */
+    LOGGER_ATOMIC(size_t)   next;     /* Events claimed, including those past cap */
+    LoggerTraceEvent*       events;   /* Caller-owned storage */
+    size_t                  cap;
+    uint64_t                start_ns;
+} LoggerTrace;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerRateLimit
+ * @brief Per-call-site limiter state for the *_RATELIMITED and *_EVERY_N macros.
+ *
+ * The token bucket is implemented as a generic cell-rate algorithm, so the
+ * whole bucket is one atomic timestamp updated by compare-and-swap. Calls
+ * that are dropped bump @c suppressed; the next emitted record reports and
+ * clears it. Zero-initialize (static storage does this automatically).
+ */
+typedef struct LoggerRateLimit {
+    LOGGER_ATOMIC(uint_least64_t) tat;        /* Theoretical arrival time (monotonic ns) */
+    LOGGER_ATOMIC(uint_least64_t) count;      /* Calls seen (EVERY_N) */
+    LOGGER_ATOMIC(uint_least64_t) suppressed; /* Calls dropped since the last emission */
+} LoggerRateLimit;
+// -------------------------------------------------------------------------------- 
+
 /**
  * @struct Logger
  * @brief Configurable logging object for emitting messages to file and/or stream.
@@ -104,11 +552,43 @@ typedef struct Logger {
     const char* name;       /* Optional logger name (not owned) */
     bool        timestamps; /* Prepend ISO-8601 timestamp */
     bool        colors;     /* ANSI colors for TTY streams */
+    bool        stream_tty; /* 'stream' was a terminal at init (cached isatty) */
     bool        owns_file;  /* Close 'file' on logger_close if true */
     bool        locking;    /* Enable/disable locking (for single-thread apps) */
     logger_mutex_t lock;    /* Portable mutex */
     bool initialized;       /* initialized flag */
+    uint32_t    id;         /* Process-unique instance id (call-site caches) */
+    LOGGER_ATOMIC(unsigned) category_gen;  /* Even = stable, odd = configuration in progress */
+    size_t      n_categories;  /* Slots in use in 'categories' */
+    LoggerCategory categories[LOGGER_MAX_CATEGORIES];
+    bool        collapse_repeats;  /* Swallow identical back-to-back records */
+    uint32_t    repeat_timeout_ms; /* Emit a summary at least this often (0 = only at run end) */
+    LoggerRepeatState repeat[LOGGER_SINK_COUNT];
+    LoggerFormat format[LOGGER_SINK_COUNT];  /* Layout per sink (default TEXT) */
+    LoggerFlushPolicy flush_policy;          /* When records are fflush()ed */
+    uint32_t    layout_gen;  /* Bumped when cached line prefixes become stale */
+    LoggerBudget budget;           /* Adaptive volume budget (disabled when zero) */
+    LoggerStatsStripe stats[LOGGER_STATS_STRIPES];  /* Cost counters, see logger_get_stats */
+    LOGGER_ATOMIC(LoggerLatencyHistogram*) latency;  /* Critical-section histogram (NULL = off) */
+    LoggerTrace trace;             /* Call-shape recorder (see logger_trace_start) */
 } Logger;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerExporter
+ * @brief Background thread that periodically publishes a Logger's metrics.
+ *
+ * Managed with logger_exporter_start() and logger_exporter_stop(); treat the
+ * fields as private.
+ */
+typedef struct LoggerExporter {
+    Logger*             lg;
+    const char*         path;         /* Target file (not owned) */
+    uint32_t            interval_ms;
+    LOGGER_ATOMIC(bool) stop;
+    bool                running;
+    logger_thread_t     thread;
+} LoggerExporter;
 // ================================================================================ 
 // ================================================================================ 
 
@@ -147,6 +627,29 @@ bool logger_init_file(Logger* lg, const char* path, LogLevel level);
 
 // -------------------------------------------------------------------------------- 
 
+/**
+ * @brief Initialize a file logger that uses caller-supplied buffer storage.
+ *
+ * Same as logger_init_file(), but the stdio buffer is @p buf instead of a
+ * 1 MiB block that the C library allocates on first write. Pass a static or
+ * stack array to keep logging off the heap. @p buf must stay valid until
+ * logger_close(). The FILE object itself still comes from fopen().
+ *
+ * @param[in,out] lg    Pointer to a Logger object to initialize.
+ * @param[in]     path  Path to the log file (opened in append mode).
+ * @param[in]     level Minimum log level to emit.
+ * @param[in]     buf   Buffer storage, or NULL to let stdio allocate @p size bytes.
+ * @param[in]     size  Buffer size in bytes (must be non-zero).
+ *
+ * @retval true  Initialization succeeded and file opened.
+ * @retval false Initialization failed; errno is EINVAL for a null @p lg or
+ *               @p path or a zero @p size, else set by fopen().
+ */
+bool logger_init_file_buffered(Logger* lg, const char* path, LogLevel level,
+                               char* buf, size_t size);
+
+// -------------------------------------------------------------------------------- 
+
 /**
  * @brief Initialize a logger that writes to both a file and a stream.
  *
@@ -177,6 +680,18 @@ bool logger_init_dual(Logger* lg, const char* path, FILE* stream, LogLevel level
  */
 void logger_close(Logger* lg);
 
+// --------------------------------------------------------------------------------
+
+/**
+ * @brief Free the calling thread's record buffers.
+ *
+ * Messages longer than 2 KiB and records longer than 4 KiB are built in
+ * per-thread buffers that grow on demand (up to 1 MiB, beyond which the
+ * record is truncated) and are kept for reuse. Call this before a thread
+ * that logged large records exits; logging afterwards is still safe.
+ */
+void logger_thread_release(void);
+
 // ================================================================================ 
 // ================================================================================ 
 
@@ -244,127 +759,941 @@ void logger_enable_colors(Logger* lg, bool on);
  */
 void logger_enable_locking(Logger* lg, bool on);
 
-// ================================================================================ 
-// ================================================================================ 
+// -------------------------------------------------------------------------------- 
 
 /**
- * @brief Emit a formatted log message with printf-style arguments.
- *
- * This is the core logging function used by the LOG_* macros. It applies
- * filtering based on the logger's current log level, formats the message,
- * and writes to the configured sinks (file and/or stream).
+ * @brief Enable or disable collapsing of repeated messages.
  *
- * Normally, you do not call this directly; instead, use the LOG_DEBUG,
- * LOG_INFO, LOG_WARNING, LOG_ERROR, or LOG_CRITICAL macros, which capture
- * @p file, @p line, and @p func automatically.
+ * When enabled, a record whose call site, level and formatted text match
+ * the previous record written to a sink is not written; the sink only
+ * counts it. When a different record arrives (or on logger_flush() and
+ * logger_close()), a single "last message repeated N times" line is
+ * emitted first. Disabling flushes any pending summary. Swallowed records
+ * are counted in LoggerStats::collapsed, not emitted, and are not charged
+ * to the budget.
  *
- * @param[in,out] lg   Pointer to the Logger to use.
- * @param[in]     level Severity level of the message.
- * @param[in]     file  Source filename where the log was emitted.
- * @param[in]     line  Source line number where the log was emitted.
- * @param[in]     func  Function name where the log was emitted.
- * @param[in]     fmt   printf-style format string for the log message.
- * @param[in]     ...   Variadic arguments matching @p fmt.
+ * @param[in,out] lg Pointer to the Logger to configure.
+ * @param[in]     on True to enable collapsing, false to disable.
  */
-void logger_log_impl(Logger* lg,
-                     LogLevel level,
-                     const char* file,
-                     int line,
-                     const char* func,
-                     const char* fmt, ...)
-#if defined(__GNUC__) || defined(__clang__)
-    __attribute__((format(printf, 6, 7)))
-#endif
-;
+void logger_enable_repeat_collapse(Logger* lg, bool on);
 
 // -------------------------------------------------------------------------------- 
 
 /**
- * @brief Emit a formatted log message using an existing va_list.
+ * @brief Bound how long a run of repeats may stay unreported.
  *
- * This variant of logger_log_impl() accepts a @c va_list rather than
- * variadic arguments. It is intended for cases where you already have a
- * va_list (e.g., inside a wrapper function). Otherwise, prefer the
- * LOG_* macros or logger_log_impl().
+ * While a run continues, a summary is written once at least @p ms
+ * milliseconds have passed since the previous one. The logger has no timer
+ * of its own: the check runs when the next repeat arrives and on each tick
+ * of a running logger_exporter_start() thread (locking loggers only). A run
+ * that stops with neither is reported by the next different record,
+ * logger_flush() or logger_close(). 0 (the default) reports only when the
+ * run ends.
  *
- * @param[in,out] lg   Pointer to the Logger to use.
- * @param[in]     level Severity level of the message.
- * @param[in]     file  Source filename where the log was emitted.
- * @param[in]     line  Source line number where the log was emitted.
- * @param[in]     func  Function name where the log was emitted.
- * @param[in]     fmt   printf-style format string for the log message.
- * @param[in]     args  va_list containing arguments matching @p fmt.
+ * @param[in,out] lg Pointer to the Logger to configure.
+ * @param[in]     ms Maximum summary interval in milliseconds.
  */
-void logger_vlog_impl(Logger* lg,
-                      LogLevel level,
-                      const char* file,
-                      int line,
-                      const char* func,
-                      const char* fmt,
-                      va_list args);
-// -------------------------------------------------------------------------------- 
+void logger_set_repeat_timeout(Logger* lg, uint32_t ms);
 
-/* Non-variadic message writer for MISRA-friendly use.
-   Caller preformats into 'msg' (NUL-terminated). */
-void logger_write(Logger* lg,
-                  LogLevel level,
-                  const char* file,
-                  int line,
-                  const char* func,
-                  const char* msg);
 // -------------------------------------------------------------------------------- 
-#if LOGGER_USE_MACROS
 
 /**
- * @def LOG_DEBUG
- * @brief Emit a debug-level log message.
+ * @brief Select the record layout for one sink.
  *
- * Convenience macro wrapping logger_log_impl() that automatically captures
- * the current source file, line, and function. Used for verbose diagnostic
- * messages intended primarily for developers.
+ * LOGGER_FORMAT_JSON writes one JSON object per line with the keys
+ * "ts" (when timestamps are enabled), "level", "logger" (when named),
+ * "category" (when set), "file", "line", "func" and "msg", followed by any
+ * structured fields as top-level keys. LOGGER_FORMAT_LOGFMT writes
+ * "ts=... level=INFO logger=... caller=file:line func=... msg=..." followed
+ * by the structured fields, quoting values only when they contain spaces,
+ * '=', quotes or control bytes. LOGGER_FORMAT_CBOR writes each record as
+ * one definite-length CBOR map with the same keys as JSON; structured
+ * fields keep their integer, float, bool or string type, and records are
+ * concatenated without framing (a CBOR sequence). LOGGER_FORMAT_OTLP writes
+ * each record as a varint length followed by an OpenTelemetry LogsData
+ * message with one LogRecord: the level maps to severity_number/text, the
+ * Logger name to the instrumentation scope, the message to the body, and
+ * file/line/func/category plus structured fields to attributes. Times are
+ * only set when timestamps are enabled. Colors apply to TEXT only.
  *
- * @param[in] lg   Pointer to the Logger to use.
- * @param[in] fmt  printf-style format string.
- * @param[in] ...  Optional arguments corresponding to @p fmt.
+ * @param[in,out] lg     Pointer to the Logger to configure.
+ * @param[in]     sink   LOGGER_SINK_STREAM or LOGGER_SINK_FILE.
+ * @param[in]     format Layout to use for that sink.
+ *
+ * @retval true  Format applied.
+ * @retval false Invalid argument (errno = EINVAL).
  */
-#define LOG_DEBUG(lg, fmt, ...)    logger_log_impl((lg), LOG_DEBUG,    __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+bool logger_set_format(Logger* lg, LoggerSinkId sink, LoggerFormat format);
 
 // -------------------------------------------------------------------------------- 
 
 /**
- * @def LOG_INFO
- * @brief Emit an informational log message.
+ * @brief Choose when records are flushed from the stdio buffers.
  *
- * Convenience macro wrapping logger_log_impl() that automatically captures
- * the current source file, line, and function. Use for general runtime events
- * or status updates.
+ * The default, LOGGER_FLUSH_ON_ERROR, lets ordinary records batch into the
+ * stdio buffer (one write per buffer-full) and flushes ERROR and CRITICAL
+ * records immediately so they survive a crash that follows them.
  *
- * @param[in] lg   Pointer to the Logger to use.
- * @param[in] fmt  printf-style format string.
- * @param[in] ...  Optional arguments corresponding to @p fmt.
+ * @param[in,out] lg     Pointer to the Logger.
+ * @param[in]     policy One of LoggerFlushPolicy.
+ *
+ * @retval true  Policy applied.
+ * @retval false Null @p lg or unknown @p policy (errno = EINVAL).
  */
-#define LOG_INFO(lg, fmt, ...)     logger_log_impl((lg), LOG_INFO,     __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+bool logger_set_flush_policy(Logger* lg, LoggerFlushPolicy policy);
 
 // -------------------------------------------------------------------------------- 
 
 /**
- * @def LOG_WARNING
- * @brief Emit a warning-level log message.
+ * @brief Flush both sinks now.
  *
- * Convenience macro wrapping logger_log_impl() that automatically captures
- * the current source file, line, and function. Use to report unexpected
- * events or conditions that may require attention but are not fatal.
+ * Also writes any pending "repeated" summaries. Use before handing a log
+ * file to another process when running with a buffered policy.
  *
- * @param[in] lg   Pointer to the Logger to use.
- * @param[in] fmt  printf-style format string.
- * @param[in] ...  Optional arguments corresponding to @p fmt.
+ * @param[in,out] lg Pointer to the Logger (NULL is ignored).
  */
-#define LOG_WARNING(lg, fmt, ...)  logger_log_impl((lg), LOG_WARNING,  __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+void logger_flush(Logger* lg);
 
 // -------------------------------------------------------------------------------- 
 
 /**
- * @def LOG_ERROR
+ * @brief Convert one CBOR-encoded record back into a readable line.
+ *
+ * Parses the record at the start of @p data, as written by a
+ * LOGGER_FORMAT_CBOR sink, and renders it with the TEXT, JSON or LOGFMT
+ * layout into @p out (not NUL-terminated). To walk a captured stream, call
+ * it repeatedly, advancing by @p *consumed each time.
+ *
+ * @param[in]  data     Encoded bytes.
+ * @param[in]  len      Number of bytes available at @p data.
+ * @param[out] consumed Bytes used by the record (may be NULL).
+ * @param[in]  format   LOGGER_FORMAT_TEXT, LOGGER_FORMAT_JSON or LOGGER_FORMAT_LOGFMT.
+ * @param[out] out      Destination buffer.
+ * @param[in]  out_cap  Capacity of @p out in bytes.
+ * @param[out] out_len  Bytes written to @p out (may be NULL).
+ *
+ * @retval true  Record decoded.
+ * @retval false Invalid argument, malformed or incomplete record
+ *               (errno = EINVAL), or @p out too small (errno = ERANGE).
+ */
+bool logger_cbor_decode(const void* data, size_t len, size_t* consumed,
+                        LoggerFormat format, char* out, size_t out_cap, size_t* out_len);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Cap the Logger's output volume and throttle the noisiest call sites.
+ *
+ * When either limit is exceeded over a LOGGER_BUDGET_WINDOW_MS window, the
+ * call sites contributing more than their fair share are sampled at 1/2,
+ * then 1/4, and so on (down to 1/1024) until the volume fits. Sites are
+ * restored gradually once load subsides. ERROR and CRITICAL records always
+ * pass. Passing 0 for both limits disables the budget and restores all
+ * sites immediately. May be called while other threads are logging.
+ *
+ * The byte limit counts message bytes (text plus hexdump payload), not the
+ * rendered line; see LoggerBudget.
+ *
+ * @param[in,out] lg                Pointer to the Logger to configure.
+ * @param[in]     records_per_sec   Maximum records per second (0 = unlimited).
+ * @param[in]     msg_bytes_per_sec Maximum message bytes per second (0 = unlimited).
+ */
+void logger_set_budget(Logger* lg, uint32_t records_per_sec, uint64_t msg_bytes_per_sec);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Read the Logger's cumulative cost counters.
+ *
+ * Counters are kept in per-thread stripes with relaxed atomics and summed
+ * here, so the snapshot is not a single consistent instant under
+ * concurrency. Lock wait time is only measured when the lock was contended.
+ *
+ * @param[in]  lg  Pointer to the Logger.
+ * @param[out] out Receives the summed counters.
+ *
+ * @retval true  Snapshot written.
+ * @retval false Invalid argument (errno = EINVAL).
+ */
+bool logger_get_stats(Logger* lg, LoggerStats* out);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Zero the Logger's cost counters.
+ *
+ * @param[in,out] lg Pointer to the Logger.
+ */
+void logger_reset_stats(Logger* lg);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Count a record that a macro filtered out before calling the library.
+ *
+ * Used by LOG_CAT(), LOG_RATELIMITED(), LOG_EVERY_N() and the LOG_SAMPLED
+ * family, whose level or category check is inlined at the call site, so
+ * that LoggerStats::filtered stays complete. Calls those macros drop for
+ * rate or sampling reasons are not counted here.
+ *
+ * @param[in,out] lg    Pointer to the Logger.
+ * @param[in]     level Level of the filtered record.
+ */
+void logger_count_filtered(Logger* lg, LogLevel level);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Record call latency into @p hist, or stop recording (off by default).
+ *
+ * While attached, every emitted record adds the time from acquiring the
+ * Logger lock through the last sink's write (and fflush, per the flush
+ * policy) to its thread's stripe of @p hist. This is the part of a LOG_*
+ * call that can block on a slow disk or a contended lock; message
+ * formatting is not included. Costs two monotonic clock reads per record.
+ * The storage is zeroed here and lives outside the Logger, so Loggers that
+ * never measure latency do not carry it.
+ *
+ * @param[in,out] lg   Pointer to the Logger to configure.
+ * @param[in]     hist Histogram storage, or NULL to stop recording. A
+ *                     detached histogram may still receive calls already in
+ *                     flight; keep it valid until logger_close().
+ *
+ * @retval true  Histogram attached or detached.
+ * @retval false Null @p lg (errno = EINVAL).
+ */
+bool logger_enable_latency_histogram(Logger* lg, LoggerLatencyHistogram* hist);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Merge the per-thread latency histograms.
+ *
+ * With @p reset, each counter is read and zeroed in one atomic step, so
+ * calls recorded concurrently land in either this snapshot or the next.
+ * Without an attached histogram, @p out is all zero.
+ *
+ * @param[in,out] lg    Pointer to the Logger.
+ * @param[out]    out   Receives the merged histogram.
+ * @param[in]     reset Zero the histogram after reading it.
+ *
+ * @retval true  Snapshot written.
+ * @retval false Invalid argument (errno = EINVAL).
+ */
+bool logger_latency_snapshot(Logger* lg, LoggerLatency* out, bool reset);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Estimate a latency quantile from a snapshot.
+ *
+ * Returns the upper edge of the bucket holding the @p q quantile (capped at
+ * the observed maximum), so the estimate never understates a tail.
+ *
+ * @param[in] h Snapshot from logger_latency_snapshot().
+ * @param[in] q Quantile in [0, 1], e.g. 0.5, 0.99, 0.999.
+ *
+ * @return Latency in nanoseconds, or 0 if @p h is NULL or empty.
+ */
+uint64_t logger_latency_percentile(const LoggerLatency* h, double q);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Add one sample to a caller-owned histogram.
+ *
+ * Uses the same buckets as the Logger's own histogram, so external
+ * measurements (e.g. benchmarks) can be merged with snapshots and queried
+ * with logger_latency_percentile(). Not thread-safe; keep one per thread.
+ *
+ * @param[in,out] h  Histogram to update (zero-initialize before first use).
+ * @param[in]     ns Sample in nanoseconds.
+ */
+void logger_latency_add(LoggerLatency* h, uint64_t ns);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Write the Logger's metrics to a file in Prometheus text format.
+ *
+ * Intended for node_exporter's textfile collector. The snapshot is written
+ * to "<path>.tmp" and renamed over @p path, so a scrape never sees a partial
+ * file. Exported series (all labelled with logger="<name>"):
+ * clog_records_total and clog_filtered_total (by level), clog_dropped_total,
+ * clog_bytes_total (by sink), clog_flushes_total, clog_write_errors_total,
+ * clog_lock_wait_seconds_total and, when the latency histogram is enabled,
+ * clog_call_duration_seconds.
+ *
+ * This does file I/O; call it from a housekeeping thread (or use
+ * logger_exporter_start()), never from a latency-sensitive producer.
+ *
+ * @param[in,out] lg   Pointer to the Logger.
+ * @param[in]     path Destination file, e.g. "/var/lib/node_exporter/app.prom".
+ *
+ * @retval true  File replaced.
+ * @retval false Invalid argument (errno = EINVAL) or I/O failure (errno from
+ *               the failing call).
+ */
+bool logger_export_prometheus(Logger* lg, const char* path);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Start a thread that calls logger_export_prometheus() periodically.
+ *
+ * The exporter owns its thread only; producers never do any of its work.
+ * @p path must outlive the exporter.
+ *
+ * @param[out]    ex          Exporter state to initialize.
+ * @param[in,out] lg          Logger to export.
+ * @param[in]     path        Destination file.
+ * @param[in]     interval_ms Time between exports (must be non-zero).
+ *
+ * @retval true  Thread started.
+ * @retval false Invalid argument (errno = EINVAL) or thread creation failed.
+ */
+bool logger_exporter_start(LoggerExporter* ex, Logger* lg, const char* path,
+                           uint32_t interval_ms);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Stop the exporter thread and write one final snapshot.
+ *
+ * Safe to call on an exporter that is not running.
+ *
+ * @param[in,out] ex Exporter started with logger_exporter_start().
+ */
+void logger_exporter_stop(LoggerExporter* ex);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Start recording the shape of every log call into @p events.
+ *
+ * Each call, including filtered and budget-dropped ones, claims one event
+ * with an atomic increment and fills it in place: time, thread, call site,
+ * level and argument sizes. No I/O and no allocation happen on the logging
+ * path. Once @p cap events are taken, later calls are only counted.
+ *
+ * @param[in,out] lg     Pointer to the Logger.
+ * @param[out]    events Storage for the trace; must outlive logger_trace_stop().
+ * @param[in]     cap    Capacity of @p events (must be non-zero).
+ *
+ * @retval true  Recording started (any previous trace is discarded).
+ * @retval false Null @p lg or @p events, or zero @p cap (errno = EINVAL).
+ */
+bool logger_trace_start(Logger* lg, LoggerTraceEvent* events, size_t cap);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Stop recording and wait for calls that are filling an event.
+ *
+ * @param[in,out] lg      Pointer to the Logger.
+ * @param[out]    dropped Optional; receives calls that found the buffer full.
+ *
+ * @return Number of valid events in the buffer given to logger_trace_start().
+ */
+size_t logger_trace_stop(Logger* lg, uint64_t* dropped);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Write a trace to @p path in the format read by logger_trace_load().
+ *
+ * The file is an 8-byte magic "CLOGTRC2", a little-endian uint32 event size
+ * (33), a uint32 event count, then each event's fields in declaration order,
+ * little-endian and unpadded, so traces load on any host.
+ *
+ * @retval true  File written.
+ * @retval false Invalid argument (errno = EINVAL) or an I/O error.
+ */
+bool logger_trace_save(const char* path, const LoggerTraceEvent* events, size_t n);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Read a trace written by logger_trace_save().
+ *
+ * Call with @p out NULL to learn the event count, then again with storage.
+ *
+ * @param[in]  path Trace file.
+ * @param[out] out  Destination, or NULL to query the count.
+ * @param[in]  cap  Capacity of @p out.
+ * @param[out] n    Events in the file (always set on success).
+ *
+ * @retval true  Success.
+ * @retval false Bad arguments or malformed file (errno = EINVAL), @p cap too
+ *               small (ERANGE), or an I/O error.
+ */
+bool logger_trace_load(const char* path, LoggerTraceEvent* out, size_t cap, size_t* n);
+
+// ================================================================================ 
+// ================================================================================ 
+
+/**
+ * @brief Set the level of a named category and everything beneath it.
+ *
+ * Registers @p category if it is not yet known, records @p level as its
+ * explicit threshold, and republishes the effective level of every slot.
+ * Descendants without their own explicit level (e.g., "net.http.client"
+ * below "net.http") inherit the new value. Pass LOGGER_LEVEL_INHERIT to
+ * drop the explicit level and fall back to the nearest ancestor.
+ *
+ * Readers never block: the change is published by bumping a generation
+ * counter, and call sites keep reading their cached slot.
+ *
+ * The @p category string is not copied and must outlive the Logger.
+ *
+ * @param[in,out] lg       Pointer to the Logger to configure.
+ * @param[in]     category Dotted category path (e.g., "net.http").
+ * @param[in]     level    New level, or LOGGER_LEVEL_INHERIT.
+ *
+ * @retval true  Level recorded.
+ * @retval false Invalid arguments (errno = EINVAL) or table full (errno = ENOSPC).
+ */
+bool logger_set_category_level(Logger* lg, const char* category, int level);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Return the effective level of a category.
+ *
+ * Resolves inheritance exactly as a call site would. Unknown categories
+ * are not registered; their level is computed from configured ancestors.
+ *
+ * @param[in] lg       Pointer to the Logger to query.
+ * @param[in] category Dotted category path.
+ *
+ * @return Effective level, or LOGGER_LEVEL_INHERIT on invalid arguments
+ *         (errno = EINVAL).
+ */
+int logger_category_level(Logger* lg, const char* category);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Resolve a category name to a slot and store it in @p site.
+ *
+ * Slow path of logger_category_enabled(); registers the category if
+ * necessary. Normally called at most once per call site.
+ *
+ * @param[in,out] lg       Pointer to the Logger.
+ * @param[in,out] site     Call-site cache to fill.
+ * @param[in]     category Dotted category path (not copied).
+ *
+ * @return Encoded slot value stored in @p site, or 0 if the table is full.
+ */
+uint_least64_t logger_category_resolve(Logger* lg,
+                                       LoggerCategorySite* site,
+                                       const char* category);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Test whether a category call site would emit at @p level.
+ *
+ * After the first call has resolved @p site, this is a cached slot lookup
+ * followed by one atomic load of the effective level. If the category table
+ * is full the Logger's own level is used.
+ *
+ * @param[in,out] lg       Pointer to the Logger.
+ * @param[in,out] site     Call-site cache (usually a static).
+ * @param[in]     category Dotted category path.
+ * @param[in]     level    Level of the prospective message.
+ *
+ * @retval true  Message would be emitted.
+ * @retval false Message is filtered out.
+ */
+static inline bool logger_category_enabled(Logger* lg,
+                                           LoggerCategorySite* site,
+                                           const char* category,
+                                           LogLevel level) {
+    if (!lg || !site) return true;  /* let the emitter report EINVAL */
+    uint_least64_t s = LOGGER_LOAD(&site->slot, acquire);
+    if ((uint32_t)(s >> 16) != lg->id || (s & 0xFFFFu) == 0) {
+        s = logger_category_resolve(lg, site, category);
+        if (s == 0) return level >= lg->level;
+    }
+    return (int)level >= LOGGER_LOAD(&lg->categories[(s & 0xFFFFu) - 1u].level, relaxed);
+}
+
+// ================================================================================ 
+// ================================================================================ 
+
+/**
+ * @brief Test whether a message at @p level passes the Logger's root level.
+ *
+ * Used by the conditional macros to filter before any limiter state is
+ * touched or arguments are evaluated. A NULL @p lg reports true so that
+ * the emitting function can set errno = EINVAL.
+ *
+ * @param[in] lg    Pointer to the Logger.
+ * @param[in] level Level of the prospective message.
+ */
+static inline bool logger_enabled(const Logger* lg, LogLevel level) {
+    return !lg || level >= lg->level;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Token-bucket admission check for one call site.
+ *
+ * Allows bursts of up to @p burst records and a sustained rate of
+ * @p per_sec records per second. Lock-free; safe to call from any thread.
+ *
+ * @param[in,out] rl         Limiter state (usually a static).
+ * @param[in]     per_sec    Sustained records per second (> 0).
+ * @param[in]     burst      Bucket depth; 0 is treated as 1.
+ * @param[out]    suppressed On success, number of calls dropped since the
+ *                           previous emission (may be NULL).
+ *
+ * @retval true  Emit this record.
+ * @retval false Drop this record (counted as suppressed).
+ */
+bool logger_ratelimit_allow(LoggerRateLimit* rl, double per_sec, unsigned burst,
+                            uint64_t* suppressed);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Modulo admission check: allow the first of every @p n calls.
+ *
+ * @param[in,out] rl         Limiter state (usually a static).
+ * @param[in]     n          Period; 0 or 1 allows every call.
+ * @param[out]    suppressed On success, calls dropped since the previous
+ *                           emission (may be NULL).
+ *
+ * @retval true  Emit this record.
+ * @retval false Drop this record (counted as suppressed).
+ */
+bool logger_every_n_allow(LoggerRateLimit* rl, uint64_t n, uint64_t* suppressed);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Give back a suppressed count that could not be reported.
+ *
+ * A successful logger_ratelimit_allow() or logger_every_n_allow() hands the
+ * count to its caller and clears it. If the record carrying it is then
+ * rejected (by the adaptive budget, say), the macros return the count here
+ * so the next emitted record still reports it.
+ *
+ * @param[in,out] rl         Limiter state the count was taken from.
+ * @param[in]     suppressed Count received from the allow call.
+ */
+void logger_ratelimit_restore(LoggerRateLimit* rl, uint64_t suppressed);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Random sampling decision with probability @p p.
+ *
+ * Draws from a per-thread xorshift64* generator, so there is no shared
+ * state and no locking. Values of @p p at or below 0 never sample; at or
+ * above 1 always sample.
+ *
+ * @param[in] p Probability of returning true.
+ */
+bool logger_sample(double p);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Deterministic sampling decision keyed by a caller-provided ID.
+ *
+ * The same @p key always gives the same answer for the same @p p, on every
+ * thread and in every process, so all lines of a sampled request are kept
+ * together. Keys are mixed with SplitMix64 before comparison.
+ *
+ * @param[in] p   Probability of returning true.
+ * @param[in] key Request, trace or session identifier.
+ */
+bool logger_sample_keyed(double p, uint64_t key);
+
+// ================================================================================ 
+// ================================================================================ 
+
+/**
+ * @brief Emit a formatted log message with printf-style arguments.
+ *
+ * This is the core logging function used by the LOG_* macros. It applies
+ * filtering based on the logger's current log level, formats the message,
+ * and writes to the configured sinks (file and/or stream).
+ *
+ * Normally, you do not call this directly; instead, use the LOG_DEBUG,
+ * LOG_INFO, LOG_WARNING, LOG_ERROR, or LOG_CRITICAL macros, which capture
+ * @p file, @p line, and @p func automatically.
+ *
+ * @param[in,out] lg   Pointer to the Logger to use.
+ * @param[in]     level Severity level of the message.
+ * @param[in]     file  Source filename where the log was emitted.
+ * @param[in]     line  Source line number where the log was emitted.
+ * @param[in]     func  Function name where the log was emitted.
+ * @param[in]     fmt   printf-style format string for the log message.
+ * @param[in]     ...   Variadic arguments matching @p fmt.
+ */
+void logger_log_impl(Logger* lg,
+                     LogLevel level,
+                     const char* file,
+                     int line,
+                     const char* func,
+                     const char* fmt, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 6, 7)))
+#endif
+;
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Emit a formatted log message using an existing va_list.
+ *
+ * This variant of logger_log_impl() accepts a @c va_list rather than
+ * variadic arguments. It is intended for cases where you already have a
+ * va_list (e.g., inside a wrapper function). Otherwise, prefer the
+ * LOG_* macros or logger_log_impl().
+ *
+ * @param[in,out] lg   Pointer to the Logger to use.
+ * @param[in]     level Severity level of the message.
+ * @param[in]     file  Source filename where the log was emitted.
+ * @param[in]     line  Source line number where the log was emitted.
+ * @param[in]     func  Function name where the log was emitted.
+ * @param[in]     fmt   printf-style format string for the log message.
+ * @param[in]     args  va_list containing arguments matching @p fmt.
+ */
+void logger_vlog_impl(Logger* lg,
+                      LogLevel level,
+                      const char* file,
+                      int line,
+                      const char* func,
+                      const char* fmt,
+                      va_list args);
+// -------------------------------------------------------------------------------- 
+
+/* Non-variadic message writer for MISRA-friendly use.
+   Caller preformats into 'msg' (NUL-terminated). */
+void logger_write(Logger* lg,
+                  LogLevel level,
+                  const char* file,
+                  int line,
+                  const char* func,
+                  const char* msg);
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Write exactly @p len bytes of @p msg as the record's message.
+ *
+ * Like logger_write(), but @p msg need not be NUL-terminated and is never
+ * scanned for a terminator, so a slice of a larger buffer (a network
+ * packet, a string view) can be logged in place. Embedded NUL bytes are
+ * written as-is by the text formats and escaped by JSON.
+ *
+ * @param[in,out] lg    Pointer to the Logger to use.
+ * @param[in]     level Severity level of the message.
+ * @param[in]     file  Source filename where the log was emitted.
+ * @param[in]     line  Source line number where the log was emitted.
+ * @param[in]     func  Function name where the log was emitted.
+ * @param[in]     msg   Message bytes (may be NULL only when @p len is 0).
+ * @param[in]     len   Number of bytes of @p msg to write.
+ */
+void logger_write_n(Logger* lg,
+                    LogLevel level,
+                    const char* file,
+                    int line,
+                    const char* func,
+                    const char* msg,
+                    size_t len);
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Emit a formatted message on behalf of a named category.
+ *
+ * Filters against the category's effective level (not the Logger's root
+ * level) and tags the record with the category name. Used by the LOG_CAT_*
+ * macros; MISRA users may call it directly with their own static @p site.
+ *
+ * @param[in,out] lg       Pointer to the Logger to use.
+ * @param[in,out] site     Call-site cache, or NULL to resolve on every call.
+ * @param[in]     category Dotted category path (not copied).
+ * @param[in]     level    Severity level of the message.
+ * @param[in]     file     Source filename where the log was emitted.
+ * @param[in]     line     Source line number where the log was emitted.
+ * @param[in]     func     Function name where the log was emitted.
+ * @param[in]     fmt      printf-style format string for the log message.
+ * @param[in]     ...      Variadic arguments matching @p fmt.
+ */
+void logger_log_cat_impl(Logger* lg,
+                         LoggerCategorySite* site,
+                         const char* category,
+                         LogLevel level,
+                         const char* file,
+                         int line,
+                         const char* func,
+                         const char* fmt, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 8, 9)))
+#endif
+;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Emit a formatted message that stands in for @p suppressed dropped ones.
+ *
+ * Behaves like logger_log_impl() but, when @p suppressed is non-zero,
+ * appends " (suppressed N similar)" to the message. Used by the
+ * *_RATELIMITED and *_EVERY_N macros.
+ *
+ * @param[in,out] lg         Pointer to the Logger to use.
+ * @param[in]     level      Severity level of the message.
+ * @param[in]     suppressed Number of records dropped at this call site.
+ * @param[in]     file       Source filename where the log was emitted.
+ * @param[in]     line       Source line number where the log was emitted.
+ * @param[in]     func       Function name where the log was emitted.
+ * @param[in]     fmt        printf-style format string for the log message.
+ * @param[in]     ...        Variadic arguments matching @p fmt.
+ *
+ * @return false if the record was filtered or dropped by the budget (or on
+ *         invalid arguments), so the caller can restore @p suppressed.
+ */
+bool logger_log_suppressed_impl(Logger* lg,
+                                LogLevel level,
+                                uint64_t suppressed,
+                                const char* file,
+                                int line,
+                                const char* func,
+                                const char* fmt, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 7, 8)))
+#endif
+;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Emit a structured record: a constant message plus typed fields.
+ *
+ * No format string is interpreted. The text layout appends the fields as
+ * " key=value" after @p msg; machine-readable encoders receive them as-is.
+ * Normally called through the logger_kv() or LOG_KV() macros.
+ *
+ * @param[in,out] lg       Pointer to the Logger to use.
+ * @param[in]     level    Severity level of the record.
+ * @param[in]     site     Source location (see LOG_SITE()); may be NULL.
+ * @param[in]     msg      NUL-terminated message text.
+ * @param[in]     fields   Array of @p n_fields fields (may be NULL if 0).
+ * @param[in]     n_fields Number of fields.
+ */
+void logger_kv_impl(Logger* lg,
+                    LogLevel level,
+                    const LogSite* site,
+                    const char* msg,
+                    const LoggerField* fields,
+                    size_t n_fields);
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Emit one record whose message is the concatenation of @p frags.
+ *
+ * The fragments are rendered straight into the record in order, so a line
+ * built from a prefix, a key and a payload needs no concatenation buffer.
+ * Normally called through the LOG_WRITEV() macro.
+ *
+ * @param[in,out] lg      Pointer to the Logger to use.
+ * @param[in]     level   Severity level of the record.
+ * @param[in]     site    Source location (see LOG_SITE()); may be NULL.
+ * @param[in]     frags   Array of @p n_frags fragments (may be NULL if 0).
+ * @param[in]     n_frags Number of fragments.
+ */
+void logger_writev(Logger* lg,
+                   LogLevel level,
+                   const LogSite* site,
+                   const LoggerFrag* frags,
+                   size_t n_frags);
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Emit many records with one lock acquisition.
+ *
+ * Each record is filtered exactly as a single call would be. The accepted
+ * ones share one timestamp, are rendered back to back into a per-thread
+ * buffer per sink and reach each FILE with one fwrite (one per 64 KiB).
+ * The flush policy is applied once, after the last record: the sink is
+ * flushed if any record in the batch would have flushed it. A bad entry
+ * (NULL msg with a nonzero length, or NULL fields with n_fields > 0)
+ * rejects the whole batch before anything is written.
+ *
+ * @param[in,out] lg   Pointer to the Logger to use.
+ * @param[in]     recs Array of @p n records (may be NULL if 0).
+ * @param[in]     n    Number of records.
+ */
+void logger_write_batch(Logger* lg, const LogRecord* recs, size_t n);
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Log a binary buffer as one record.
+ *
+ * The message is "hexdump N bytes". The text format follows it with a
+ * canonical dump (offset, 16 hex bytes, printable ASCII, as hexdump -C)
+ * inside the same record; JSON and logfmt add a "data" key holding the
+ * bytes as lowercase hex. CBOR stores the payload raw as a byte string
+ * and OTLP as a bytes_value attribute. Payloads whose rendering would
+ * pass the 1 MiB record limit are shortened.
+ *
+ * @param[in,out] lg    Pointer to the Logger to use.
+ * @param[in]     level Severity level of the record.
+ * @param[in]     site  Source location (see LOG_SITE()); may be NULL.
+ * @param[in]     p     Bytes to dump (may be NULL if @p n is 0).
+ * @param[in]     n     Number of bytes.
+ */
+void logger_hexdump(Logger* lg, LogLevel level, const LogSite* site, const void* p, size_t n);
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @struct LoggerRecord
+ * @brief A record being assembled with logger_record_begin/append/commit.
+ *
+ * Lives on the caller's stack; the text itself is built in a per-thread
+ * buffer, so a record must be appended to and closed on the thread that
+ * opened it. Treat the members as private.
+ */
+typedef struct LoggerRecord {
+    Logger*     lg;
+    LogLevel    level;
+    LogSite     site;
+    size_t      len;        /* Bytes assembled so far */
+    size_t      dropped;    /* Bytes cut at the record limit */
+    const void* owner;      /* Per-thread buffer the record was opened on */
+    bool        open;       /* Admitted and not yet committed */
+    bool        truncated;  /* Reached the 1 MiB record limit */
+} LoggerRecord;
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Start assembling one large record piece by piece.
+ *
+ * The level is checked here, once: when the record is filtered out (or
+ * dropped by the budget) this returns false and later appends format
+ * nothing. Otherwise appends accumulate in a per-thread buffer that grows
+ * as needed, and logger_record_commit() publishes the whole text as one
+ * record with a single write, so it is never interleaved with other
+ * threads' output. No lock is held between begin and commit.
+ *
+ * A thread can have one open record at a time; a second begin before the
+ * commit fails with EBUSY and leaves @p rec untouched, so the open record can
+ * still be committed. A record that will not be committed must be closed with
+ * logger_record_abort(), or every later begin on the thread fails.
+ *
+ * @param[in,out] lg    Pointer to the Logger to use.
+ * @param[out]    rec   Caller-owned record handle.
+ * @param[in]     level Severity level of the record.
+ * @param[in]     site  Source location (see LOG_SITE()); may be NULL. Copied.
+ * @return true if the record is open. On false, errno is EINVAL for NULL
+ *         arguments, EBUSY or ENOMEM, and is left unchanged when the record
+ *         was filtered.
+ */
+bool logger_record_begin(Logger* lg, LoggerRecord* rec, LogLevel level, const LogSite* site);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Append printf-formatted text to an open record.
+ *
+ * There is no per-append length limit. Text past the 1 MiB record limit is
+ * dropped and the call returns false; the committed record then ends with
+ * "...[truncated N bytes]".
+ *
+ * @param[in,out] rec Record handle from logger_record_begin().
+ * @param[in]     fmt printf-style format string.
+ * @return true if everything was appended; false for a filtered or closed
+ *         record, or when the text was cut. errno is EINVAL for NULL
+ *         arguments or a record opened on another thread.
+ */
+bool logger_record_append(LoggerRecord* rec, const char* fmt, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+;
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Publish an open record and close it.
+ *
+ * Safe on a record whose begin returned false (nothing is written). A
+ * record opened on another thread is left open and errno is set to EINVAL.
+ *
+ * @param[in,out] rec Record handle from logger_record_begin().
+ */
+void logger_record_commit(LoggerRecord* rec);
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @brief Close an open record without writing it.
+ *
+ * Use on error paths that abandon a record, so the thread can begin another.
+ * Nothing is written or counted. Safe on a record that is already closed or
+ * whose begin returned false; a record opened on another thread is left open
+ * and errno is set to EINVAL.
+ *
+ * @param[in,out] rec Record handle from logger_record_begin().
+ */
+void logger_record_abort(LoggerRecord* rec);
+// -------------------------------------------------------------------------------- 
+#if LOGGER_USE_MACROS
+
+/**
+ * @def LOG_DEBUG
+ * @brief Emit a debug-level log message.
+ *
+ * Convenience macro wrapping logger_log_impl() that automatically captures
+ * the current source file, line, and function. Used for verbose diagnostic
+ * messages intended primarily for developers.
+ *
+ * @param[in] lg   Pointer to the Logger to use.
+ * @param[in] fmt  printf-style format string.
+ * @param[in] ...  Optional arguments corresponding to @p fmt.
+ */
+#define LOG_DEBUG(lg, fmt, ...)    logger_log_impl((lg), LOG_DEBUG,    __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @def LOG_INFO
+ * @brief Emit an informational log message.
+ *
+ * Convenience macro wrapping logger_log_impl() that automatically captures
+ * the current source file, line, and function. Use for general runtime events
+ * or status updates.
+ *
+ * @param[in] lg   Pointer to the Logger to use.
+ * @param[in] fmt  printf-style format string.
+ * @param[in] ...  Optional arguments corresponding to @p fmt.
+ */
+#define LOG_INFO(lg, fmt, ...)     logger_log_impl((lg), LOG_INFO,     __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @def LOG_WARNING
+ * @brief Emit a warning-level log message.
+ *
+ * Convenience macro wrapping logger_log_impl() that automatically captures
+ * the current source file, line, and function. Use to report unexpected
+ * events or conditions that may require attention but are not fatal.
+ *
+ * @param[in] lg   Pointer to the Logger to use.
+ * @param[in] fmt  printf-style format string.
+ * @param[in] ...  Optional arguments corresponding to @p fmt.
+ */
+#define LOG_WARNING(lg, fmt, ...)  logger_log_impl((lg), LOG_WARNING,  __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @def LOG_ERROR
  * @brief Emit an error-level log message.
  *
  * Convenience macro wrapping logger_log_impl() that automatically captures
@@ -393,6 +1722,258 @@ void logger_write(Logger* lg,
  */
 #define LOG_CRITICAL(lg, fmt, ...) logger_log_impl((lg), LOG_CRITICAL, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
 
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @def LOG_SITE
+ * @brief Pointer to a LogSite describing the current source location.
+ */
+#define LOG_SITE() (&(const LogSite){ __FILE__, __LINE__, __func__ })
+
+/** @brief Signed integer field. */
+#define LKV_INT(k, x)   ((LoggerField){ .key = (k), .type = LKV_T_INT,  .v.i = (int64_t)(x) })
+/** @brief Unsigned integer field. */
+#define LKV_UINT(k, x)  ((LoggerField){ .key = (k), .type = LKV_T_UINT, .v.u = (uint64_t)(x) })
+/** @brief Double-precision field. */
+#define LKV_F64(k, x)   ((LoggerField){ .key = (k), .type = LKV_T_F64,  .v.f = (double)(x) })
+/** @brief Boolean field. */
+#define LKV_BOOL(k, x)  ((LoggerField){ .key = (k), .type = LKV_T_BOOL, .v.b = (x) ? true : false })
+/** @brief NUL-terminated string field (not copied). */
+#define LKV_STR(k, x)   ((LoggerField){ .key = (k), .type = LKV_T_STR,  .v.s = { (x), (size_t)-1 } })
+/** @brief Pointer+length string field (not copied, need not be NUL-terminated). */
+#define LKV_STRN(k, x, n) ((LoggerField){ .key = (k), .type = LKV_T_STR, .v.s = { (x), (n) } })
+
+/**
+ * @def logger_kv
+ * @brief Emit a structured record from a list of LKV_* fields.
+ *
+ * Example:
+ * @code
+ * logger_kv(&lg, LOG_INFO, LOG_SITE(), "request done",
+ *           LKV_INT("status", 200), LKV_STR("path", path), LKV_F64("ms", t));
+ * @endcode
+ *
+ * @param[in] lg    Pointer to the Logger to use.
+ * @param[in] level LogLevel of the record.
+ * @param[in] site  LogSite pointer, usually LOG_SITE().
+ * @param[in] msg   Constant message text.
+ * @param[in] ...   One or more LKV_* fields.
+ */
+#define logger_kv(lg, level, site, msg, ...)                                         \
+    logger_kv_impl((lg), (level), (site), (msg),                                     \
+                   (const LoggerField[]){ __VA_ARGS__ },                             \
+                   sizeof((const LoggerField[]){ __VA_ARGS__ }) / sizeof(LoggerField))
+
+/**
+ * @def LOG_KV
+ * @brief logger_kv() with the call site captured automatically.
+ */
+#define LOG_KV(lg, level, msg, ...) logger_kv((lg), (level), LOG_SITE(), (msg), __VA_ARGS__)
+
+/**
+ * @def LOG_HEXDUMP
+ * @brief logger_hexdump() with the call site captured automatically.
+ */
+#define LOG_HEXDUMP(lg, level, p, n) logger_hexdump((lg), (level), LOG_SITE(), (p), (n))
+
+/**
+ * @def LOG_RECORD_BEGIN
+ * @brief logger_record_begin() with the call site captured automatically.
+ */
+#define LOG_RECORD_BEGIN(lg, rec, level) logger_record_begin((lg), (rec), (level), LOG_SITE())
+
+/** @brief Message fragment of @p n bytes at @p p (not copied). */
+#define LFRAG(p, n)   ((LoggerFrag){ (p), (n) })
+/** @brief Message fragment holding a string literal, without its NUL. */
+#define LFRAG_LIT(s)  ((LoggerFrag){ ("" s), sizeof(s) - 1u })
+
+/**
+ * @def LOG_WRITEV
+ * @brief Emit one record from a list of LFRAG()/LFRAG_LIT() fragments.
+ *
+ * Example:
+ * @code
+ * LOG_WRITEV(&lg, LOG_INFO, LFRAG_LIT("peer "), LFRAG(name, name_len),
+ *            LFRAG_LIT(" sent "), LFRAG(pkt, pkt_len));
+ * @endcode
+ */
+#define LOG_WRITEV(lg, level, ...)                                                   \
+    logger_writev((lg), (level), LOG_SITE(),                                         \
+                  (const LoggerFrag[]){ __VA_ARGS__ },                               \
+                  sizeof((const LoggerFrag[]){ __VA_ARGS__ }) / sizeof(LoggerFrag))
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @def LOG_CAT
+ * @brief Emit a message through a named, hierarchical category.
+ *
+ * Each expansion owns a static LoggerCategorySite, so the category name is
+ * resolved once and later calls cost one cached lookup plus one atomic load.
+ * Arguments are not evaluated when the category filters the message out.
+ * The cache holds one logger: an expansion called with alternating loggers
+ * falls back to a by-name lookup on each switch.
+ *
+ * @param[in] lg   Pointer to the Logger to use.
+ * @param[in] lvl  LogLevel of the message.
+ * @param[in] cat  Dotted category path (string literal recommended).
+ * @param[in] fmt  printf-style format string.
+ * @param[in] ...  Optional arguments corresponding to @p fmt.
+ */
+#define LOG_CAT(lg, lvl, cat, fmt, ...)                                              \
+    do {                                                                             \
+        static LoggerCategorySite logger_cat_site_;                                  \
+        if (logger_category_enabled((lg), &logger_cat_site_, (cat), (lvl)))         \
+            logger_log_cat_impl((lg), &logger_cat_site_, (cat), (lvl),               \
+                                __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__);   \
+        else                                                                         \
+            logger_count_filtered((lg), (lvl));                                      \
+    } while (0)
+
+/** @brief LOG_CAT() at debug level. */
+#define LOG_CAT_DEBUG(lg, cat, fmt, ...)    LOG_CAT((lg), LOG_DEBUG,    (cat), fmt, ##__VA_ARGS__)
+/** @brief LOG_CAT() at info level. */
+#define LOG_CAT_INFO(lg, cat, fmt, ...)     LOG_CAT((lg), LOG_INFO,     (cat), fmt, ##__VA_ARGS__)
+/** @brief LOG_CAT() at warning level. */
+#define LOG_CAT_WARNING(lg, cat, fmt, ...)  LOG_CAT((lg), LOG_WARNING,  (cat), fmt, ##__VA_ARGS__)
+/** @brief LOG_CAT() at error level. */
+#define LOG_CAT_ERROR(lg, cat, fmt, ...)    LOG_CAT((lg), LOG_ERROR,    (cat), fmt, ##__VA_ARGS__)
+/** @brief LOG_CAT() at critical level. */
+#define LOG_CAT_CRITICAL(lg, cat, fmt, ...) LOG_CAT((lg), LOG_CRITICAL, (cat), fmt, ##__VA_ARGS__)
+
+// -------------------------------------------------------------------------------- 
+
+/**
+ * @def LOG_RATELIMITED
+ * @brief Emit a message at most @p per_sec times per second from this call site.
+ *
+ * Each expansion owns a static LoggerRateLimit token bucket that is checked
+ * lock-free before any formatting. Dropped calls are counted, and the next
+ * emitted record carries " (suppressed N similar)".
+ *
+ * @param[in] lg      Pointer to the Logger to use.
+ * @param[in] lvl     LogLevel of the message.
+ * @param[in] per_sec Sustained records per second.
+ * @param[in] burst   Records allowed back-to-back before limiting starts.
+ * @param[in] fmt     printf-style format string.
+ * @param[in] ...     Optional arguments corresponding to @p fmt.
+ */
+#define LOG_RATELIMITED(lg, lvl, per_sec, burst, fmt, ...)                           \
+    do {                                                                             \
+        static LoggerRateLimit logger_rl_;                                           \
+        uint64_t logger_rl_sup_ = 0;                                                 \
+        if (!logger_enabled((lg), (lvl)))                                            \
+            logger_count_filtered((lg), (lvl));                                      \
+        else if (logger_ratelimit_allow(&logger_rl_, (per_sec), (burst), &logger_rl_sup_) && \
+                 !logger_log_suppressed_impl((lg), (lvl), logger_rl_sup_,            \
+                                             __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)) \
+            logger_ratelimit_restore(&logger_rl_, logger_rl_sup_);                   \
+    } while (0)
+
+/**
+ * @def LOG_EVERY_N
+ * @brief Emit the first of every @p n messages from this call site.
+ *
+ * Uses a static modulo counter checked lock-free before formatting; each
+ * emitted record reports how many calls were skipped since the last one.
+ *
+ * @param[in] lg   Pointer to the Logger to use.
+ * @param[in] lvl  LogLevel of the message.
+ * @param[in] n    Emission period.
+ * @param[in] fmt  printf-style format string.
+ * @param[in] ...  Optional arguments corresponding to @p fmt.
+ */
+#define LOG_EVERY_N(lg, lvl, n, fmt, ...)                                            \
+    do {                                                                             \
+        static LoggerRateLimit logger_en_;                                           \
+        uint64_t logger_en_sup_ = 0;                                                 \
+        if (!logger_enabled((lg), (lvl)))                                            \
+            logger_count_filtered((lg), (lvl));                                      \
+        else if (logger_every_n_allow(&logger_en_, (n), &logger_en_sup_) &&          \
+                 !logger_log_suppressed_impl((lg), (lvl), logger_en_sup_,            \
+                                             __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)) \
+            logger_ratelimit_restore(&logger_en_, logger_en_sup_);                   \
+    } while (0)
+
+/**
+ * @def LOG_SAMPLED
+ * @brief Emit a message with probability @p p.
+ *
+ * The level check and the sampling draw happen before any argument is
+ * evaluated or formatted, so unsampled calls cost a thread-local PRNG step.
+ *
+ * @param[in] lg   Pointer to the Logger to use.
+ * @param[in] lvl  LogLevel of the message.
+ * @param[in] p    Sampling probability in [0, 1].
+ * @param[in] fmt  printf-style format string.
+ * @param[in] ...  Optional arguments corresponding to @p fmt.
+ */
+#define LOG_SAMPLED(lg, lvl, p, fmt, ...)                                            \
+    do {                                                                             \
+        if (!logger_enabled((lg), (lvl)))                                            \
+            logger_count_filtered((lg), (lvl));                                      \
+        else if (logger_sample(p))                                                   \
+            logger_log_impl((lg), (lvl), __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__); \
+    } while (0)
+
+/**
+ * @def LOG_SAMPLED_KEYED
+ * @brief Emit a message if request @p key falls in the sampled fraction @p p.
+ *
+ * Every LOG_*_SAMPLED_KEYED call with the same @p key and @p p makes the
+ * same decision, so a sampled request keeps all of its lines.
+ *
+ * @param[in] lg   Pointer to the Logger to use.
+ * @param[in] lvl  LogLevel of the message.
+ * @param[in] p    Sampling probability in [0, 1].
+ * @param[in] key  64-bit request identifier.
+ * @param[in] fmt  printf-style format string.
+ * @param[in] ...  Optional arguments corresponding to @p fmt.
+ */
+#define LOG_SAMPLED_KEYED(lg, lvl, p, key, fmt, ...)                                 \
+    do {                                                                             \
+        if (!logger_enabled((lg), (lvl)))                                            \
+            logger_count_filtered((lg), (lvl));                                      \
+        else if (logger_sample_keyed((p), (key)))                                    \
+            logger_log_impl((lg), (lvl), __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__); \
+    } while (0)
+
+/** @brief LOG_SAMPLED() at debug level. */
+#define LOG_DEBUG_SAMPLED(lg, p, fmt, ...)   LOG_SAMPLED((lg), LOG_DEBUG,   (p), fmt, ##__VA_ARGS__)
+/** @brief LOG_SAMPLED() at info level. */
+#define LOG_INFO_SAMPLED(lg, p, fmt, ...)    LOG_SAMPLED((lg), LOG_INFO,    (p), fmt, ##__VA_ARGS__)
+/** @brief LOG_SAMPLED() at warning level. */
+#define LOG_WARNING_SAMPLED(lg, p, fmt, ...) LOG_SAMPLED((lg), LOG_WARNING, (p), fmt, ##__VA_ARGS__)
+
+/** @brief LOG_SAMPLED_KEYED() at debug level. */
+#define LOG_DEBUG_SAMPLED_KEYED(lg, p, key, fmt, ...)   LOG_SAMPLED_KEYED((lg), LOG_DEBUG,   (p), (key), fmt, ##__VA_ARGS__)
+/** @brief LOG_SAMPLED_KEYED() at info level. */
+#define LOG_INFO_SAMPLED_KEYED(lg, p, key, fmt, ...)    LOG_SAMPLED_KEYED((lg), LOG_INFO,    (p), (key), fmt, ##__VA_ARGS__)
+/** @brief LOG_SAMPLED_KEYED() at warning level. */
+#define LOG_WARNING_SAMPLED_KEYED(lg, p, key, fmt, ...) LOG_SAMPLED_KEYED((lg), LOG_WARNING, (p), (key), fmt, ##__VA_ARGS__)
+
+/** @brief LOG_RATELIMITED() at debug level. */
+#define LOG_DEBUG_RATELIMITED(lg, per_sec, burst, fmt, ...)    LOG_RATELIMITED((lg), LOG_DEBUG,    (per_sec), (burst), fmt, ##__VA_ARGS__)
+/** @brief LOG_RATELIMITED() at info level. */
+#define LOG_INFO_RATELIMITED(lg, per_sec, burst, fmt, ...)     LOG_RATELIMITED((lg), LOG_INFO,     (per_sec), (burst), fmt, ##__VA_ARGS__)
+/** @brief LOG_RATELIMITED() at warning level. */
+#define LOG_WARNING_RATELIMITED(lg, per_sec, burst, fmt, ...)  LOG_RATELIMITED((lg), LOG_WARNING,  (per_sec), (burst), fmt, ##__VA_ARGS__)
+/** @brief LOG_RATELIMITED() at error level. */
+#define LOG_ERROR_RATELIMITED(lg, per_sec, burst, fmt, ...)    LOG_RATELIMITED((lg), LOG_ERROR,    (per_sec), (burst), fmt, ##__VA_ARGS__)
+/** @brief LOG_RATELIMITED() at critical level. */
+#define LOG_CRITICAL_RATELIMITED(lg, per_sec, burst, fmt, ...) LOG_RATELIMITED((lg), LOG_CRITICAL, (per_sec), (burst), fmt, ##__VA_ARGS__)
+
+/** @brief LOG_EVERY_N() at debug level. */
+#define LOG_DEBUG_EVERY_N(lg, n, fmt, ...)    LOG_EVERY_N((lg), LOG_DEBUG,    (n), fmt, ##__VA_ARGS__)
+/** @brief LOG_EVERY_N() at info level. */
+#define LOG_INFO_EVERY_N(lg, n, fmt, ...)     LOG_EVERY_N((lg), LOG_INFO,     (n), fmt, ##__VA_ARGS__)
+/** @brief LOG_EVERY_N() at warning level. */
+#define LOG_WARNING_EVERY_N(lg, n, fmt, ...)  LOG_EVERY_N((lg), LOG_WARNING,  (n), fmt, ##__VA_ARGS__)
+/** @brief LOG_EVERY_N() at error level. */
+#define LOG_ERROR_EVERY_N(lg, n, fmt, ...)    LOG_EVERY_N((lg), LOG_ERROR,    (n), fmt, ##__VA_ARGS__)
+/** @brief LOG_EVERY_N() at critical level. */
+#define LOG_CRITICAL_EVERY_N(lg, n, fmt, ...) LOG_EVERY_N((lg), LOG_CRITICAL, (n), fmt, ##__VA_ARGS__)
+
 #endif /* LOGGER_USE_MACROS */
 // ================================================================================ 
 // ================================================================================ 
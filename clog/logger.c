@@ -15,16 +15,25 @@
 #define _POSIX_C_SOURCE 200809L
 #include "logger.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
 #if defined(_WIN32)
   #include <io.h>
+  #include <windows.h>
   #define LOGGER_ISATTY(h)   _isatty(_fileno(h))
 #else
+  #include <sched.h>
   #include <unistd.h>
   #define LOGGER_ISATTY(h)   (isatty(fileno(h)))
 #endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+  #define LOGGER_THREAD_LOCAL __declspec(thread)
+#else
+  #define LOGGER_THREAD_LOCAL _Thread_local
+#endif
 // ================================================================================ 
 // ================================================================================ 
 
@@ -55,6 +64,8 @@ static const char* level_color(LogLevel lv) {
 
 // -------------------------------------------------------------------------------- 
 
+/* Called at init only; the answer is cached in Logger.stream_tty so the hot
+   path never issues the ioctl behind isatty(). */
 static bool is_tty(FILE* s) {
     return (s != NULL) && LOGGER_ISATTY(s);
 }
@@ -81,12 +92,56 @@ static void now_iso8601(char* buf, size_t n) {
 
 // -------------------------------------------------------------------------------- 
 
+/* Wall clock in nanoseconds since the Unix epoch (OTLP timestamps). */
+static uint64_t wall_ns(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Monotonic clock in nanoseconds for rate decisions (not for display). */
+static uint64_t mono_ns(void) {
+#if defined(_WIN32)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#else
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void repeat_flush_all(Logger* lg);
+static void repeat_flush_due(Logger* lg);
+static void flush_sinks(Logger* lg);
+
+// -------------------------------------------------------------------------------- 
+
+/* Instance ids let static call-site caches detect a different (or
+   re-initialized) Logger. Zero is reserved for "unresolved". */
+static atomic_uint g_logger_next_id = 1;
+
+// -------------------------------------------------------------------------------- 
+
 static bool init_common(Logger* lg, LogLevel level) {
     if (!lg) {
         errno = EINVAL;
         return false;
     }
     memset(lg, 0, sizeof(*lg));
+    atomic_init(&lg->category_gen, 0u);
+    do { lg->id = atomic_fetch_add(&g_logger_next_id, 1u); } while (lg->id == 0);
     lg->level = level;
     lg->timestamps = true;
     lg->colors = true;
@@ -106,9 +161,10 @@ bool logger_init_stream(Logger* lg, FILE* stream, LogLevel level) {
     }
     if (!init_common(lg, level)) return false;
     lg->stream = stream;
+    lg->stream_tty = is_tty(stream);
     /* If this is a TTY, line-buffer for fewer syscalls but prompt output.
        Call setvbuf() before any I/O on the stream. */
-    if (LOGGER_ISATTY(stream)) {
+    if (lg->stream_tty) {
         setvbuf(stream, NULL, _IOLBF, 0);
     }
     return true;
@@ -117,7 +173,17 @@ bool logger_init_stream(Logger* lg, FILE* stream, LogLevel level) {
 // -------------------------------------------------------------------------------- 
 
 bool logger_init_file(Logger* lg, const char* path, LogLevel level) {
-    if (!lg || !path) {
+    /* Files are block-buffered; ask for a larger buffer to cut write calls.
+       Some C libraries (glibc) ignore the size when stdio owns the buffer;
+       logger_init_file_buffered() with caller storage always honors it. */
+    return logger_init_file_buffered(lg, path, level, NULL, 1<<20);  // 1 MiB
+}
+
+// -------------------------------------------------------------------------------- 
+
+bool logger_init_file_buffered(Logger* lg, const char* path, LogLevel level,
+                               char* buf, size_t size) {
+    if (!lg || !path || size == 0) {
         errno = EINVAL;
         return false;
     }
@@ -129,8 +195,7 @@ bool logger_init_file(Logger* lg, const char* path, LogLevel level) {
     }
     lg->file = fp;
     lg->owns_file = true;
-    /* Files are block-buffered; make the buffer larger to cut write calls. */
-    setvbuf(lg->file, NULL, _IOFBF, 1<<20);  // 1 MiB
+    setvbuf(lg->file, buf, _IOFBF, size);
     return true;
 }
 
@@ -143,8 +208,9 @@ bool logger_init_dual(Logger* lg, const char* path, FILE* stream, LogLevel level
     }
     if (!logger_init_file(lg, path, level)) return false;
     lg->stream = stream;
+    lg->stream_tty = is_tty(stream);
     /* Line-buffer terminals for prompt visibility; leave files full-buffered. */
-    if (LOGGER_ISATTY(stream)) setvbuf(stream, NULL, _IOLBF, 0);
+    if (lg->stream_tty) setvbuf(stream, NULL, _IOLBF, 0);
     return true;
 }
 
@@ -152,13 +218,94 @@ bool logger_init_dual(Logger* lg, const char* path, FILE* stream, LogLevel level
 
 void logger_close(Logger* lg) {
     if (!lg) return;
-    if (lg->file) fflush(lg->file);
-    if (lg->stream) fflush(lg->stream);
+    repeat_flush_all(lg);
+    flush_sinks(lg);
     if (lg->owns_file && lg->file) fclose(lg->file);
     lg->file = NULL;
     lg->stream = NULL;
+    lg->stream_tty = false;
     LOGGER_MUTEX_DESTROY(lg->lock); 
     lg->initialized = false;
+    lg->id = 0;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- Category table ----------------------------------------------------------
+   Writers (registration, level changes) serialize on category_gen: an odd value
+   means a writer is active. Every write recomputes all effective levels and
+   publishes them with relaxed atomic stores; the final even increment is the
+   release point. Hot-path readers only load a slot's effective level. */
+
+static void category_write_begin(Logger* lg) {
+    unsigned g = atomic_load_explicit(&lg->category_gen, memory_order_relaxed);
+    for (;;) {
+        if ((g & 1u) == 0u &&
+            atomic_compare_exchange_weak_explicit(&lg->category_gen, &g, g + 1u,
+                                                  memory_order_acquire,
+                                                  memory_order_relaxed)) {
+            return;
+        }
+        g = atomic_load_explicit(&lg->category_gen, memory_order_relaxed);
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void category_write_end(Logger* lg) {
+    atomic_fetch_add_explicit(&lg->category_gen, 1u, memory_order_release);
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* True if 'anc' equals 'name' or is a dotted prefix of it ("net" of "net.http"). */
+static bool category_is_ancestor(const char* anc, const char* name) {
+    size_t n = strlen(anc);
+    return strncmp(anc, name, n) == 0 && (name[n] == '\0' || name[n] == '.');
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Effective level of 'name': the longest configured ancestor wins, else root. */
+static int category_effective(const Logger* lg, const char* name) {
+    int    best = (int)lg->level;
+    size_t best_len = 0;
+    for (size_t i = 0; i < lg->n_categories; ++i) {
+        const LoggerCategory* c = &lg->categories[i];
+        if (c->configured == LOGGER_LEVEL_INHERIT) continue;
+        size_t n = strlen(c->name);
+        if (n >= best_len && category_is_ancestor(c->name, name)) {
+            best = c->configured;
+            best_len = n;
+        }
+    }
+    return best;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Caller holds the writer side of category_gen. */
+static void category_republish(Logger* lg) {
+    for (size_t i = 0; i < lg->n_categories; ++i) {
+        LoggerCategory* c = &lg->categories[i];
+        atomic_store_explicit(&c->level, category_effective(lg, c->name),
+                              memory_order_relaxed);
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Caller holds the writer side of category_gen. Returns slot index or -1. */
+static long category_find_or_add(Logger* lg, const char* name) {
+    for (size_t i = 0; i < lg->n_categories; ++i) {
+        if (strcmp(lg->categories[i].name, name) == 0) return (long)i;
+    }
+    if (lg->n_categories >= LOGGER_MAX_CATEGORIES) return -1;
+    LoggerCategory* c = &lg->categories[lg->n_categories];
+    c->name = name;
+    c->configured = LOGGER_LEVEL_INHERIT;
+    atomic_store_explicit(&c->level, category_effective(lg, name), memory_order_relaxed);
+    return (long)lg->n_categories++;
 }
 
 // -------------------------------------------------------------------------------- 
@@ -169,6 +316,67 @@ void logger_set_level(Logger* lg, LogLevel level) {
         return;
     }
     lg->level = level; 
+    if (lg->n_categories) {
+        category_write_begin(lg);
+        category_republish(lg);
+        category_write_end(lg);
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+bool logger_set_category_level(Logger* lg, const char* category, int level) {
+    if (!lg || !category) {
+        errno = EINVAL;
+        return false;
+    }
+    category_write_begin(lg);
+    long idx = category_find_or_add(lg, category);
+    if (idx >= 0) {
+        lg->categories[idx].configured = level;
+        category_republish(lg);
+    }
+    category_write_end(lg);
+    if (idx < 0) {
+        errno = ENOSPC;
+        return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------- 
+
+int logger_category_level(Logger* lg, const char* category) {
+    if (!lg || !category) {
+        errno = EINVAL;
+        return LOGGER_LEVEL_INHERIT;
+    }
+    /* Seqlock-style read: retry if a writer was active or finished meanwhile. */
+    for (;;) {
+        unsigned g0 = atomic_load_explicit(&lg->category_gen, memory_order_acquire);
+        if (g0 & 1u) continue;
+        int lvl = category_effective(lg, category);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&lg->category_gen, memory_order_relaxed) == g0) return lvl;
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+uint_least64_t logger_category_resolve(Logger* lg,
+                                       LoggerCategorySite* site,
+                                       const char* category) {
+    if (!lg || !site || !category) {
+        errno = EINVAL;
+        return 0;
+    }
+    category_write_begin(lg);
+    long idx = category_find_or_add(lg, category);
+    category_write_end(lg);
+    if (idx < 0) return 0;
+    uint_least64_t s = ((uint_least64_t)lg->id << 16) | (uint_least64_t)(idx + 1);
+    atomic_store_explicit(&site->slot, s, memory_order_release);
+    return s;
 }
 
 // -------------------------------------------------------------------------------- 
@@ -179,6 +387,7 @@ void logger_set_name(Logger* lg, const char* name) {
         return;
     }
     lg->name = name;   
+    lg->layout_gen++;  /* invalidate cached line prefixes */
 }
 
 // -------------------------------------------------------------------------------- 
@@ -213,105 +422,3051 @@ void logger_enable_locking(Logger* lg, bool on) {
 
 // -------------------------------------------------------------------------------- 
 
-static void emit_one(FILE* out, bool colorize, const char* color,
-                     const char* timestamp, const char* name,
-                     LogLevel level, const char* file, int line,
-                     const char* func, const char* msg)
-{
-    if (!out) return;
-
-    if (colorize) fputs(color, out);
-    if (timestamp && *timestamp) fprintf(out, "%s ", timestamp);
-    if (name) fprintf(out, "[%s] ", name);
-    fprintf(out, "%-8s ", level_name(level));
-    fprintf(out, "%s:%d:%s: ", file, line, func);
-    fputs(msg, out);
-    fputc('\n', out);
-    if (colorize) fputs("\033[0m", out);
-    fflush(out);
+void logger_enable_repeat_collapse(Logger* lg, bool on) {
+    if (!lg) {
+        errno = EINVAL;
+        return;
+    }
+    if (lg->locking) LOGGER_MUTEX_LOCK(lg->lock);
+    if (!on) repeat_flush_all(lg);
+    memset(lg->repeat, 0, sizeof(lg->repeat));
+    lg->collapse_repeats = on;
+    if (lg->locking) LOGGER_MUTEX_UNLOCK(lg->lock);
 }
 
 // -------------------------------------------------------------------------------- 
 
-void logger_vlog_impl(Logger* lg,
-                      LogLevel level,
-                      const char* file,
-                      int line,
-                      const char* func,
-                      const char* fmt,
-                      va_list args) {
-    /* Validate inputs for errno discipline */
-    if (!lg || !fmt) {
+void logger_set_repeat_timeout(Logger* lg, uint32_t ms) {
+    if (!lg) {
         errno = EINVAL;
         return;
     }
+    lg->repeat_timeout_ms = ms;
+}
 
-    /* Not an error: filtered-out messages must not modify errno */
-    if (level < lg->level) return;
+// -------------------------------------------------------------------------------- 
 
+bool logger_set_format(Logger* lg, LoggerSinkId sink, LoggerFormat format) {
+    if (!lg || (unsigned)sink >= LOGGER_SINK_COUNT || (unsigned)format >= LOGGER_FORMAT_COUNT) {
+        errno = EINVAL;
+        return false;
+    }
     if (lg->locking) LOGGER_MUTEX_LOCK(lg->lock);
+    lg->format[sink] = format;
+    if (lg->locking) LOGGER_MUTEX_UNLOCK(lg->lock);
+    return true;
+}
 
-    char ts[32] = {0};
-    if (lg->timestamps) now_iso8601(ts, sizeof(ts));
+// -------------------------------------------------------------------------------- 
 
-    char buf[2048];
-    vsnprintf(buf, sizeof(buf), fmt, args);
+bool logger_set_flush_policy(Logger* lg, LoggerFlushPolicy policy) {
+    if (!lg || (unsigned)policy > (unsigned)LOGGER_FLUSH_BUFFERED) {
+        errno = EINVAL;
+        return false;
+    }
+    if (lg->locking) LOGGER_MUTEX_LOCK(lg->lock);
+    lg->flush_policy = policy;
+    if (lg->locking) LOGGER_MUTEX_UNLOCK(lg->lock);
+    return true;
+}
 
-    const char* color = level_color(level);
+// -------------------------------------------------------------------------------- 
 
-    bool stream_color = lg->colors && lg->stream && is_tty(lg->stream);
-    bool file_color   = false;
+void logger_flush(Logger* lg) {
+    if (!lg) return;
+    if (lg->locking) LOGGER_MUTEX_LOCK(lg->lock);
+    repeat_flush_all(lg);
+    flush_sinks(lg);
+    if (lg->locking) LOGGER_MUTEX_UNLOCK(lg->lock);
+}
 
-    if (lg->stream) emit_one(lg->stream, stream_color, color, ts, lg->name, level, file, line, func, buf);
-    if (lg->file)   emit_one(lg->file,   file_color,   "",    ts, lg->name, level, file, line, func, buf);
+// -------------------------------------------------------------------------------- 
 
-    if (lg->locking) LOGGER_MUTEX_UNLOCK(lg->lock);
+void logger_set_budget(Logger* lg, uint32_t records_per_sec, uint64_t msg_bytes_per_sec) {
+    if (!lg) {
+        errno = EINVAL;
+        return;
+    }
+    LoggerBudget* b = &lg->budget;
+    atomic_store_explicit(&b->records_per_sec, records_per_sec, memory_order_relaxed);
+    atomic_store_explicit(&b->msg_bytes_per_sec, msg_bytes_per_sec, memory_order_relaxed);
+    if (records_per_sec == 0 && msg_bytes_per_sec == 0) {
+        for (size_t i = 0; i < LOGGER_BUDGET_SITES; ++i) {
+            atomic_store_explicit(&b->sites[i].sample_shift, 0u, memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&b->window_start_ns, 0u, memory_order_relaxed);
 }
+
 // -------------------------------------------------------------------------------- 
 
-void logger_log_impl(Logger* lg,
-                     LogLevel level,
-                     const char* file,
-                     int line,
-                     const char* func,
-                     const char* fmt, ...) {
-    /* Validate inputs for errno discipline */
-    if (!lg || !fmt) {
+/* ---- Statistics ----------------------------------------------------------------
+   Each thread is assigned a stripe on its first record and only ever updates
+   that stripe, with relaxed atomics; readers sum all stripes. */
+
+static atomic_uint g_stats_next_stripe;
+static LOGGER_THREAD_LOCAL unsigned tl_stats_stripe;  /* stripe index + 1; 0 = unassigned */
+
+static unsigned thread_stripe(void) {
+    if (tl_stats_stripe == 0) {
+        tl_stats_stripe = atomic_fetch_add_explicit(&g_stats_next_stripe, 1u, memory_order_relaxed)
+                        % LOGGER_STATS_STRIPES + 1u;
+    }
+    return tl_stats_stripe - 1u;
+}
+
+static LoggerStatsStripe* stats_stripe(Logger* lg) {
+    return &lg->stats[thread_stripe()];
+}
+
+static size_t level_index(LogLevel level) {
+    int i = (int)level / 10 - 1;
+    if (i < 0) i = 0;
+    if (i >= LOGGER_LEVEL_COUNT) i = LOGGER_LEVEL_COUNT - 1;
+    return (size_t)i;
+}
+
+static void stats_add(atomic_uint_least64_t* c, uint64_t v) {
+    atomic_fetch_add_explicit(c, v, memory_order_relaxed);
+}
+
+// -------------------------------------------------------------------------------- 
+
+bool logger_get_stats(Logger* lg, LoggerStats* out) {
+    if (!lg || !out) {
+        errno = EINVAL;
+        return false;
+    }
+    memset(out, 0, sizeof(*out));
+    for (size_t s = 0; s < LOGGER_STATS_STRIPES; ++s) {
+        LoggerStatsStripe* st = &lg->stats[s];
+        for (size_t i = 0; i < LOGGER_LEVEL_COUNT; ++i) {
+            out->emitted[i]  += atomic_load_explicit(&st->emitted[i], memory_order_relaxed);
+            out->filtered[i] += atomic_load_explicit(&st->filtered[i], memory_order_relaxed);
+        }
+        for (size_t i = 0; i < LOGGER_SINK_COUNT; ++i) {
+            out->bytes[i] += atomic_load_explicit(&st->bytes[i], memory_order_relaxed);
+        }
+        out->flushes      += atomic_load_explicit(&st->flushes, memory_order_relaxed);
+        out->write_errors += atomic_load_explicit(&st->write_errors, memory_order_relaxed);
+        out->lock_wait_ns += atomic_load_explicit(&st->lock_wait_ns, memory_order_relaxed);
+        out->truncated    += atomic_load_explicit(&st->truncated, memory_order_relaxed);
+        out->collapsed    += atomic_load_explicit(&st->collapsed, memory_order_relaxed);
+    }
+    out->dropped = atomic_load_explicit(&lg->budget.dropped, memory_order_relaxed);
+    out->budget_untracked = atomic_load_explicit(&lg->budget.untracked, memory_order_relaxed);
+    return true;
+}
+
+// -------------------------------------------------------------------------------- 
+
+struct log_rec;
+static void trace_call(Logger* lg, LogLevel level, const char* file, int line,
+                       unsigned flags, const struct log_rec* r);
+
+void logger_count_filtered(Logger* lg, LogLevel level) {
+    if (!lg) return;
+    stats_add(&stats_stripe(lg)->filtered[level_index(level)], 1u);
+    trace_call(lg, level, NULL, 0, LOGGER_TRACE_FILTERED, NULL);
+}
+
+// -------------------------------------------------------------------------------- 
+
+void logger_reset_stats(Logger* lg) {
+    if (!lg) {
         errno = EINVAL;
         return;
     }
+    for (size_t s = 0; s < LOGGER_STATS_STRIPES; ++s) {
+        LoggerStatsStripe* st = &lg->stats[s];
+        for (size_t i = 0; i < LOGGER_LEVEL_COUNT; ++i) {
+            atomic_store_explicit(&st->emitted[i], 0u, memory_order_relaxed);
+            atomic_store_explicit(&st->filtered[i], 0u, memory_order_relaxed);
+        }
+        for (size_t i = 0; i < LOGGER_SINK_COUNT; ++i) {
+            atomic_store_explicit(&st->bytes[i], 0u, memory_order_relaxed);
+        }
+        atomic_store_explicit(&st->flushes, 0u, memory_order_relaxed);
+        atomic_store_explicit(&st->write_errors, 0u, memory_order_relaxed);
+        atomic_store_explicit(&st->lock_wait_ns, 0u, memory_order_relaxed);
+        atomic_store_explicit(&st->truncated, 0u, memory_order_relaxed);
+        atomic_store_explicit(&st->collapsed, 0u, memory_order_relaxed);
+    }
+    atomic_store_explicit(&lg->budget.dropped, 0u, memory_order_relaxed);
+    atomic_store_explicit(&lg->budget.untracked, 0u, memory_order_relaxed);
+}
 
-    va_list args;
-    va_start(args, fmt);
-    logger_vlog_impl(lg, level, file, line, func, fmt, args);
-    va_end(args);
+// -------------------------------------------------------------------------------- 
+
+/* ---- Latency histogram ---------------------------------------------------------
+   Log-linear buckets: exact below 8 ns, then 8 sub-buckets per power of two. */
+
+static size_t latency_bucket(uint64_t ns) {
+    if (ns < 8u) return (size_t)ns;
+    unsigned e = 63u;
+    while (!(ns >> e)) --e;                      /* e >= 3: index of the top bit */
+    size_t i = (size_t)(e - 2u) * 8u + (size_t)((ns >> (e - 3u)) & 7u);
+    return i < LOGGER_LATENCY_BUCKETS ? i : LOGGER_LATENCY_BUCKETS - 1u;
+}
+
+/* Largest value that maps to bucket i. */
+static uint64_t latency_bucket_max(size_t i) {
+    if (i < 8u) return (uint64_t)i;
+    unsigned e = (unsigned)(i / 8u) + 2u;
+    uint64_t lo = (uint64_t)(8u + i % 8u) << (e - 3u);
+    return lo + ((uint64_t)1 << (e - 3u)) - 1u;
 }
+
+static void latency_record(LoggerLatencyHistogram* hist, uint64_t ns) {
+    LoggerLatencyStripe* h = &hist->stripes[thread_stripe() % LOGGER_LATENCY_STRIPES];
+    stats_add(&h->count, 1u);
+    stats_add(&h->sum_ns, ns);
+    stats_add(&h->buckets[latency_bucket(ns)], 1u);
+    uint64_t m = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+    while (ns > m && !atomic_compare_exchange_weak_explicit(&h->max_ns, &m, ns,
+                                                            memory_order_relaxed,
+                                                            memory_order_relaxed)) {}
+}
+
 // -------------------------------------------------------------------------------- 
 
-void logger_write(Logger* lg,
-                  LogLevel level,
-                  const char* file,
-                  int line,
-                  const char* func,
-                  const char* msg)
-{
-    if (!lg || !msg) { errno = EINVAL; return; }
-    /* Level filtering and locking identical to logger_vlog_impl */
-    if (level < lg->level) return;
+bool logger_enable_latency_histogram(Logger* lg, LoggerLatencyHistogram* hist) {
+    if (!lg) {
+        errno = EINVAL;
+        return false;
+    }
+    if (hist) memset(hist, 0, sizeof(*hist));
+    /* Release: a producer that sees the pointer sees the zeroed stripes. */
+    atomic_store_explicit(&lg->latency, hist, memory_order_release);
+    return true;
+}
 
-    if (lg->locking) LOGGER_MUTEX_LOCK(lg->lock);
+// -------------------------------------------------------------------------------- 
 
-    char ts[32] = {0};
-    if (lg->timestamps) now_iso8601(ts, sizeof(ts));
+static uint64_t take(atomic_uint_least64_t* c, bool reset) {
+    return reset ? atomic_exchange_explicit(c, 0u, memory_order_relaxed)
+                 : atomic_load_explicit(c, memory_order_relaxed);
+}
+
+bool logger_latency_snapshot(Logger* lg, LoggerLatency* out, bool reset) {
+    if (!lg || !out) {
+        errno = EINVAL;
+        return false;
+    }
+    memset(out, 0, sizeof(*out));
+    LoggerLatencyHistogram* hist = atomic_load_explicit(&lg->latency, memory_order_acquire);
+    for (size_t s = 0; hist && s < LOGGER_LATENCY_STRIPES; ++s) {
+        LoggerLatencyStripe* h = &hist->stripes[s];
+        out->count  += take(&h->count, reset);
+        out->sum_ns += take(&h->sum_ns, reset);
+        uint64_t m = take(&h->max_ns, reset);
+        if (m > out->max_ns) out->max_ns = m;
+        for (size_t i = 0; i < LOGGER_LATENCY_BUCKETS; ++i) {
+            out->buckets[i] += take(&h->buckets[i], reset);
+        }
+    }
+    return true;
+}
 
-    const char* color = level_color(level);
-    bool stream_color = lg->colors && lg->stream && is_tty(lg->stream);
-    bool file_color   = false;
+// -------------------------------------------------------------------------------- 
+
+void logger_latency_add(LoggerLatency* h, uint64_t ns) {
+    if (!h) {
+        errno = EINVAL;
+        return;
+    }
+    h->count++;
+    h->sum_ns += ns;
+    h->buckets[latency_bucket(ns)]++;
+    if (ns > h->max_ns) h->max_ns = ns;
+}
 
-    if (lg->stream) emit_one(lg->stream, stream_color, color, ts, lg->name, level, file, line, func, msg);
-    if (lg->file)   emit_one(lg->file,   file_color,   "",    ts, lg->name, level, file, line, func, msg);
+// -------------------------------------------------------------------------------- 
 
-    if (lg->locking) LOGGER_MUTEX_UNLOCK(lg->lock);
+uint64_t logger_latency_percentile(const LoggerLatency* h, double q) {
+    if (!h) return 0;
+    uint64_t total = 0;
+    for (size_t i = 0; i < LOGGER_LATENCY_BUCKETS; ++i) total += h->buckets[i];
+    if (total == 0) return 0;
+    if (q < 0.0) q = 0.0;
+    if (q > 1.0) q = 1.0;
+    uint64_t rank = (uint64_t)(q * (double)total + 0.999999);  /* ceil, rank >= 1 */
+    if (rank == 0) rank = 1;
+    if (rank > total) rank = total;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LOGGER_LATENCY_BUCKETS; ++i) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t v = latency_bucket_max(i);
+            return (h->max_ns && v > h->max_ns) ? h->max_ns : v;
+        }
+    }
+    return h->max_ns;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- Prometheus textfile export -----------------------------------------------
+   Everything here runs on the caller's (housekeeping) thread or the exporter
+   thread and only reads the producers' relaxed counters. */
+
+static void prom_label(FILE* f, const char* s) {
+    for (; s && *s; ++s) {
+        if (*s == '\\' || *s == '"') { fputc('\\', f); fputc(*s, f); }
+        else if (*s == '\n')         fputs("\\n", f);
+        else                         fputc(*s, f);
+    }
+}
+
+static void prom_header(FILE* f, const char* metric, const char* type, const char* help) {
+    fprintf(f, "# HELP %s %s\n# TYPE %s %s\n", metric, help, metric, type);
+}
+
+static void prom_sample(FILE* f, const char* metric, const char* name,
+                        const char* key, const char* value, uint64_t v) {
+    fprintf(f, "%s{logger=\"", metric);
+    prom_label(f, name);
+    fputc('"', f);
+    if (key) fprintf(f, ",%s=\"%s\"", key, value);
+    fprintf(f, "} %llu\n", (unsigned long long)v);
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void prom_write(FILE* f, Logger* lg) {
+    static const char* levels[LOGGER_LEVEL_COUNT] = { "debug", "info", "warning", "error", "critical" };
+    static const char* sinks[LOGGER_SINK_COUNT] = { "stream", "file" };
+    /* Histogram boundaries in ns, 1-2.5-5 steps from 100 ns to 10 s. */
+    static const uint64_t le_ns[] = {
+        100ull, 250ull, 500ull, 1000ull, 2500ull, 5000ull, 10000ull, 25000ull, 50000ull, 100000ull, 250000ull,
+        500000ull, 1000000ull, 2500000ull, 5000000ull, 10000000ull, 25000000ull,
+        50000000ull, 100000000ull, 250000000ull, 500000000ull, 1000000000ull,
+        2500000000ull, 5000000000ull, 10000000000ull
+    };
+    const char* name = lg->name ? lg->name : "";
+    LoggerStats st;
+    logger_get_stats(lg, &st);
+
+    prom_header(f, "clog_records_total", "counter", "Records written, by level.");
+    for (size_t i = 0; i < LOGGER_LEVEL_COUNT; ++i)
+        prom_sample(f, "clog_records_total", name, "level", levels[i], st.emitted[i]);
+    prom_header(f, "clog_filtered_total", "counter", "Records below the level or category threshold.");
+    for (size_t i = 0; i < LOGGER_LEVEL_COUNT; ++i)
+        prom_sample(f, "clog_filtered_total", name, "level", levels[i], st.filtered[i]);
+    prom_header(f, "clog_dropped_total", "counter", "Records sampled away by the adaptive budget.");
+    prom_sample(f, "clog_dropped_total", name, NULL, NULL, st.dropped);
+    prom_header(f, "clog_collapsed_total", "counter", "Repeated records folded into a summary.");
+    prom_sample(f, "clog_collapsed_total", name, NULL, NULL, st.collapsed);
+    prom_header(f, "clog_bytes_total", "counter", "Bytes handed to each sink.");
+    for (size_t i = 0; i < LOGGER_SINK_COUNT; ++i)
+        prom_sample(f, "clog_bytes_total", name, "sink", sinks[i], st.bytes[i]);
+    prom_header(f, "clog_flushes_total", "counter", "Sink flushes.");
+    prom_sample(f, "clog_flushes_total", name, NULL, NULL, st.flushes);
+    prom_header(f, "clog_write_errors_total", "counter", "Short writes or failed flushes.");
+    prom_sample(f, "clog_write_errors_total", name, NULL, NULL, st.write_errors);
+    prom_header(f, "clog_lock_wait_seconds_total", "counter", "Time spent blocked on the logger lock.");
+    fputs("clog_lock_wait_seconds_total{logger=\"", f);
+    prom_label(f, name);
+    fprintf(f, "\"} %.9f\n", (double)st.lock_wait_ns / 1e9);
+
+    if (!atomic_load_explicit(&lg->latency, memory_order_acquire)) return;
+    LoggerLatency h;
+    logger_latency_snapshot(lg, &h, false);
+    prom_header(f, "clog_call_duration_seconds", "histogram",
+                "Time from taking the logger lock to the last flush.");
+    /* A log bucket is counted under the first boundary its upper edge fits. */
+    uint64_t cum = 0;
+    size_t b = 0;
+    for (size_t i = 0; i < sizeof(le_ns) / sizeof(le_ns[0]); ++i) {
+        while (b < LOGGER_LATENCY_BUCKETS && latency_bucket_max(b) <= le_ns[i]) cum += h.buckets[b++];
+        fputs("clog_call_duration_seconds_bucket{logger=\"", f);
+        prom_label(f, name);
+        fprintf(f, "\",le=\"%g\"} %llu\n", (double)le_ns[i] / 1e9, (unsigned long long)cum);
+    }
+    fputs("clog_call_duration_seconds_bucket{logger=\"", f);
+    prom_label(f, name);
+    fprintf(f, "\",le=\"+Inf\"} %llu\n", (unsigned long long)h.count);
+    fputs("clog_call_duration_seconds_sum{logger=\"", f);
+    prom_label(f, name);
+    fprintf(f, "\"} %.9f\n", (double)h.sum_ns / 1e9);
+    prom_sample(f, "clog_call_duration_seconds_count", name, NULL, NULL, h.count);
+}
+
+// -------------------------------------------------------------------------------- 
+
+bool logger_export_prometheus(Logger* lg, const char* path) {
+    if (!lg || !path || !*path) {
+        errno = EINVAL;
+        return false;
+    }
+    char tmp[1024];
+    int n = snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if (n < 0 || (size_t)n >= sizeof(tmp)) {
+        errno = EINVAL;
+        return false;
+    }
+    FILE* f = fopen(tmp, "w");
+    if (!f) return false;
+    prom_write(f, lg);
+    bool ok = !ferror(f);
+    if (fclose(f) != 0) ok = false;
+#if defined(_WIN32)
+    if (ok && !MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING)) {
+        errno = EIO;
+        ok = false;
+    }
+#else
+    if (ok && rename(tmp, path) != 0) ok = false;
+#endif
+    if (!ok) {
+        int saved = errno;
+        remove(tmp);
+        errno = saved;
+    }
+    return ok;
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void sleep_ms(uint32_t ms) {
+#if defined(_WIN32)
+    Sleep(ms);
+#else
+    struct timespec ts = { (time_t)(ms / 1000u), (long)(ms % 1000u) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+/* Gives up the rest of the time slice while waiting on another thread. */
+static void yield_cpu(void) {
+#if defined(_WIN32)
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+/* Sleeps in short slices so logger_exporter_stop() returns promptly. Each
+   tick also writes repeat summaries whose timeout has passed, so a run that
+   simply stops is still reported; that needs the Logger lock. */
+static void exporter_loop(LoggerExporter* ex) {
+    while (!atomic_load(&ex->stop)) {
+        uint32_t waited = 0;
+        while (waited < ex->interval_ms && !atomic_load(&ex->stop)) {
+            uint32_t slice = ex->interval_ms - waited < 50u ? ex->interval_ms - waited : 50u;
+            sleep_ms(slice);
+            waited += slice;
+        }
+        if (atomic_load(&ex->stop)) break;
+        Logger* lg = ex->lg;
+        if (lg->locking) {
+            LOGGER_MUTEX_LOCK(lg->lock);
+            repeat_flush_due(lg);
+            LOGGER_MUTEX_UNLOCK(lg->lock);
+        }
+        logger_export_prometheus(lg, ex->path);
+    }
+}
+
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+static int exporter_main(void* arg) { exporter_loop((LoggerExporter*)arg); return 0; }
+#elif defined(_WIN32)
+static DWORD WINAPI exporter_main(LPVOID arg) { exporter_loop((LoggerExporter*)arg); return 0; }
+#else
+static void* exporter_main(void* arg) { exporter_loop((LoggerExporter*)arg); return NULL; }
+#endif
+
+// -------------------------------------------------------------------------------- 
+
+bool logger_exporter_start(LoggerExporter* ex, Logger* lg, const char* path,
+                           uint32_t interval_ms) {
+    if (!ex || !lg || !path || !*path || interval_ms == 0) {
+        errno = EINVAL;
+        return false;
+    }
+    ex->lg = lg;
+    ex->path = path;
+    ex->interval_ms = interval_ms;
+    ex->running = false;
+    atomic_init(&ex->stop, false);
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+    ex->running = thrd_create(&ex->thread, exporter_main, ex) == thrd_success;
+#elif defined(_WIN32)
+    ex->thread = CreateThread(NULL, 0, exporter_main, ex, 0, NULL);
+    ex->running = ex->thread != NULL;
+#else
+    ex->running = pthread_create(&ex->thread, NULL, exporter_main, ex) == 0;
+#endif
+    if (!ex->running) errno = EAGAIN;
+    return ex->running;
+}
+
+// -------------------------------------------------------------------------------- 
+
+void logger_exporter_stop(LoggerExporter* ex) {
+    if (!ex || !ex->running) return;
+    atomic_store(&ex->stop, true);
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+    thrd_join(ex->thread, NULL);
+#elif defined(_WIN32)
+    WaitForSingleObject(ex->thread, INFINITE);
+    CloseHandle(ex->thread);
+#else
+    pthread_join(ex->thread, NULL);
+#endif
+    ex->running = false;
+    logger_export_prometheus(ex->lg, ex->path);
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- Records and line rendering ------------------------------------------------
+   Every entry point reduces its input to a log_rec, and every sink renders a
+   log_rec into a line buffer that is handed to stdio with a single fwrite. */
+
+#define LOGGER_LINE_MAX     4096
+#define LOGGER_MSG_INLINE   2048       /* Stack buffer for formatted messages */
+#define LOGGER_RECORD_MAX   (1u << 20) /* Longest message or rendered record */
+#define LOGGER_MSG_MAX      (LOGGER_RECORD_MAX - LOGGER_LINE_MAX) /* Longest message text; a line is left for the layout */
+#define LOGGER_BATCH_BYTES  (64u * 1024u) /* Per-sink buffer of logger_write_batch() */
+#define LOGGER_PREFIX_MAX   192  /* Longest cacheable constant line prefix */
+#define LOGGER_PREFIX_SLOTS 32   /* Per-thread prefix cache entries */
+
+typedef struct log_rec {
+    LogLevel           level;
+    const char*        category; /* NULL for uncategorized records */
+    const char*        file;
+    int                line;
+    const char*        func;
+    const char*        msg;
+    size_t             msg_len;
+    const LoggerField* fields;
+    size_t             n_fields;
+    const LoggerFrag*  frags;    /* When set, the message is these pieces */
+    size_t             n_frags;
+    const unsigned char* data;   /* Binary payload (logger_hexdump) */
+    size_t             data_len;
+    size_t             dropped;  /* Bytes cut to fit LOGGER_RECORD_MAX; shown as a marker */
+} log_rec;
+
+/* What the renderers need from the Logger: its name, and the id and layout
+   generation that key the prefix cache (id 0 = do not cache). */
+typedef struct log_src {
+    const char* name;
+    uint32_t    id;
+    uint32_t    gen;
+} log_src;
+
+// -------------------------------------------------------------------------------- 
+
+#define LOGGER_TRUNC_MARKER_MAX 48
+
+/* The "...[truncated N bytes]" note that ends a cut message. */
+static size_t trunc_marker(char* out, size_t dropped) {
+    int n = snprintf(out, LOGGER_TRUNC_MARKER_MAX, "...[truncated %llu bytes]",
+                     (unsigned long long)dropped);
+    return n > 0 ? (size_t)n : 0;
+}
+
+/* Message length as rendered, marker included. */
+static size_t msg_total(const log_rec* r) {
+    if (!r->dropped) return r->msg_len;
+    char note[LOGGER_TRUNC_MARKER_MAX];
+    return r->msg_len + trunc_marker(note, r->dropped);
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Walks the message as pieces: 'msg' itself, or the caller's fragments.
+   Either way at most msg_len bytes come out, so shortening msg_len shortens
+   a fragmented message too. A cut message ends with the truncation marker,
+   so every format shows it. */
+typedef struct {
+    const log_rec* r;
+    size_t         i;
+    size_t         left;
+    bool           noted;
+    char           note[LOGGER_TRUNC_MARKER_MAX];
+} msg_iter;
+
+#define MSG_ITER(rec) { (rec), 0, (rec)->msg_len, false, { 0 } }
+
+static bool msg_next(msg_iter* it, const char** p, size_t* n) {
+    const log_rec* r = it->r;
+    if (!r->frags) {
+        if (it->i++ == 0) {
+            *p = r->msg;
+            *n = r->msg_len;
+            return true;
+        }
+    } else {
+        while (it->left && it->i < r->n_frags) {
+            const LoggerFrag* f = &r->frags[it->i++];
+            if (!f->n) continue;
+            *p = f->p;
+            *n = f->n < it->left ? f->n : it->left;
+            it->left -= *n;
+            return true;
+        }
+    }
+    if (!r->dropped || it->noted) return false;
+    it->noted = true;
+    *p = it->note;
+    *n = trunc_marker(it->note, r->dropped);
+    return true;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Per-thread growable buffers for messages and records that outgrow the stack
+   buffers. They grow geometrically up to LOGGER_RECORD_MAX and are kept, so a
+   thread that logs large records allocates only while warming up;
+   logger_thread_release() frees them. */
+typedef struct {
+    char*  p;
+    size_t cap;
+} arena;
+
+static LOGGER_THREAD_LOCAL arena tl_msg_arena;
+static LOGGER_THREAD_LOCAL arena tl_line_arena;
+static LOGGER_THREAD_LOCAL arena tl_batch_arena[LOGGER_SINK_COUNT];
+static LOGGER_THREAD_LOCAL arena tl_rec_arena;   /* logger_record_begin() text */
+static LOGGER_THREAD_LOCAL bool  tl_rec_open;
+
+/* At least n bytes (n <= LOGGER_RECORD_MAX), contents preserved; NULL if the
+   request is too large or allocation fails. */
+static char* arena_reserve(arena* a, size_t n) {
+    if (n > LOGGER_RECORD_MAX) return NULL;
+    if (a->cap >= n) return a->p;
+    size_t cap = a->cap ? a->cap : 2 * LOGGER_LINE_MAX;
+    while (cap < n) cap *= 2;
+    if (cap > LOGGER_RECORD_MAX) cap = LOGGER_RECORD_MAX;
+    char* p = realloc(a->p, cap);
+    if (!p) return NULL;
+    a->p = p;
+    a->cap = cap;
+    return p;
+}
+
+// -------------------------------------------------------------------------------- 
+
+void logger_thread_release(void) {
+    free(tl_msg_arena.p);
+    free(tl_line_arena.p);
+    tl_msg_arena = (arena){ NULL, 0 };
+    tl_line_arena = (arena){ NULL, 0 };
+    if (!tl_rec_open) {
+        free(tl_rec_arena.p);
+        tl_rec_arena = (arena){ NULL, 0 };
+    }
+    for (int i = 0; i < LOGGER_SINK_COUNT; ++i) {
+        free(tl_batch_arena[i].p);
+        tl_batch_arena[i] = (arena){ NULL, 0 };
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Bounded append-only buffer; overflow truncates and sets 'truncated'. */
+typedef struct {
+    char*  p;
+    size_t len;
+    size_t cap;
+    bool   truncated;
+} lbuf;
+
+static void lb_put(lbuf* b, const char* s, size_t n) {
+    size_t room = b->cap - b->len;
+    if (n > room) {
+        n = room;
+        b->truncated = true;
+    }
+    memcpy(b->p + b->len, s, n);
+    b->len += n;
+}
+
+static void lb_puts(lbuf* b, const char* s) { lb_put(b, s, strlen(s)); }
+
+static void lb_putc(lbuf* b, char c) {
+    if (b->len < b->cap) b->p[b->len++] = c;
+    else b->truncated = true;
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void lb_u64(lbuf* b, uint64_t v) {
+    char tmp[20];
+    size_t n = 0;
+    do { tmp[sizeof(tmp) - 1 - n++] = (char)('0' + v % 10u); v /= 10u; } while (v);
+    lb_put(b, tmp + sizeof(tmp) - n, n);
+}
+
+static void lb_i64(lbuf* b, int64_t v) {
+    if (v < 0) {
+        lb_putc(b, '-');
+        lb_u64(b, (uint64_t)0 - (uint64_t)v);
+    } else {
+        lb_u64(b, (uint64_t)v);
+    }
+}
+
+/* Shortest of %.15g/%.17g that round-trips; non-finite values as text. */
+static void lb_f64(lbuf* b, double v) {
+    char tmp[32];
+    if (v != v) { lb_puts(b, "NaN"); return; }
+    if (v > 1.7976931348623157e308)  { lb_puts(b, "Infinity"); return; }
+    if (v < -1.7976931348623157e308) { lb_puts(b, "-Infinity"); return; }
+    int n = snprintf(tmp, sizeof(tmp), "%.15g", v);
+    if (strtod(tmp, NULL) != v) n = snprintf(tmp, sizeof(tmp), "%.17g", v);
+    if (n > 0) lb_put(b, tmp, (size_t)n);
+}
+
+// -------------------------------------------------------------------------------- 
+
+static size_t field_str_len(const LoggerField* f) {
+    return f->v.s.n == (size_t)-1 ? (f->v.s.p ? strlen(f->v.s.p) : 0) : f->v.s.n;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- Field keys ----------------------------------------------------------------
+   Every encoder writes a field's key through field_key(): bytes outside
+   [A-Za-z0-9_.-] become '_', so a key can never break a line or need quoting,
+   and a key equal to one the record writes itself gets a "fields." prefix,
+   so a field cannot shadow the level, message or call site. */
+
+#define LOGGER_KEY_MAX 64   /* Longest key written, NUL included */
+
+static const char* const reserved_keys[] = {
+    "ts", "level", "logger", "category", "file", "line", "func", "caller", "msg", "data"
+};
+
+static bool key_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '.' || c == '-';
+}
+
+static bool key_reserved(const char* key) {
+    for (size_t i = 0; i < sizeof(reserved_keys) / sizeof(reserved_keys[0]); ++i) {
+        if (strcmp(key, reserved_keys[i]) == 0) return true;
+    }
+    return false;
+}
+
+/* The key as written: 'key' itself when it is already safe, else a cleaned
+   copy in 'buf' (LOGGER_KEY_MAX bytes). */
+static const char* field_key(const char* key, char* buf) {
+    if (!key || !*key) return "_";
+    bool clean = true;
+    size_t n = 0;
+    for (; key[n] && n < LOGGER_KEY_MAX; ++n) clean = clean && key_char(key[n]);
+    if (key[n]) clean = false;   /* too long */
+    bool reserved = clean && n <= 8 && key_reserved(key);
+    if (clean && !reserved) return key;
+    lbuf b = { buf, 0, LOGGER_KEY_MAX, false };
+    if (reserved) lb_puts(&b, "fields.");
+    for (size_t i = 0; key[i] && b.len < LOGGER_KEY_MAX - 1u; ++i) {
+        lb_putc(&b, key_char(key[i]) ? key[i] : '_');
+    }
+    buf[b.len] = '\0';
+    return buf;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- Binary payloads -----------------------------------------------------------
+   Bytes become hex through a nibble lookup table, a chunk at a time into a
+   small stack buffer, so each lb_put moves many characters. */
+
+static const char hex_digit[16] = { '0','1','2','3','4','5','6','7',
+                                    '8','9','a','b','c','d','e','f' };
+
+/* Plain lowercase hex, two characters per byte. */
+static void lb_hex(lbuf* b, const unsigned char* p, size_t n) {
+    char tmp[128];
+    while (n) {
+        size_t k = n < sizeof(tmp) / 2 ? n : sizeof(tmp) / 2;
+        for (size_t i = 0; i < k; ++i) {
+            tmp[2 * i]     = hex_digit[p[i] >> 4];
+            tmp[2 * i + 1] = hex_digit[p[i] & 15u];
+        }
+        lb_put(b, tmp, 2 * k);
+        p += k;
+        n -= k;
+    }
+}
+
+/* Canonical dump (as hexdump -C): one line per 16 bytes with offset, hex in
+   two groups of eight and the printable ASCII, then the final offset. Each
+   line is preceded by a newline; the caller ends the last one. */
+static void lb_hexdump(lbuf* b, const unsigned char* p, size_t n) {
+    char l[80];
+    size_t off = 0;
+    for (;;) {
+        size_t k = 0;
+        l[k++] = '\n';
+        for (int sh = 28; sh >= 0; sh -= 4) l[k++] = hex_digit[(off >> sh) & 15u];
+        if (off == n) {
+            lb_put(b, l, k);
+            return;
+        }
+        size_t m = n - off < 16u ? n - off : 16u;
+        l[k++] = ' ';
+        for (size_t i = 0; i < 16u; ++i) {
+            if (i == 8u) l[k++] = ' ';
+            l[k++] = ' ';
+            l[k++] = i < m ? hex_digit[p[off + i] >> 4] : ' ';
+            l[k++] = i < m ? hex_digit[p[off + i] & 15u] : ' ';
+        }
+        l[k++] = ' ';
+        l[k++] = ' ';
+        l[k++] = '|';
+        for (size_t i = 0; i < m; ++i) {
+            unsigned char c = p[off + i];
+            l[k++] = (c >= 0x20 && c < 0x7F) ? (char)c : '.';
+        }
+        l[k++] = '|';
+        lb_put(b, l, k);
+        off += m;
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- logfmt quoting ---------------------------------------------------------
+   One table lookup per byte decides whether a value can go out bare, must be
+   quoted (space, '='), or contains bytes that also need escaping. */
+
+enum { LF_BARE = 0, LF_QUOTE = 1, LF_ESCAPE = 2 };
+
+static const unsigned char logfmt_class[256] = {
+    2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2, 2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,
+    1,0,2,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,2,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,2,
+};
+
+// -------------------------------------------------------------------------------- 
+
+static unsigned logfmt_scan(const char* s, size_t n) {
+    unsigned cls = LF_BARE;
+    for (size_t i = 0; i < n; ++i) cls |= logfmt_class[(unsigned char)s[i]];
+    return cls;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* The bytes of a value whose combined class is 'cls', without the quotes. */
+static void lb_logfmt_chars(lbuf* b, const char* s, size_t n, unsigned cls) {
+    if (!(cls & LF_ESCAPE)) {
+        lb_put(b, s, n);
+    } else {
+        static const char hex[] = "0123456789abcdef";
+        for (size_t i = 0; i < n; ++i) {
+            unsigned char c = (unsigned char)s[i];
+            if (logfmt_class[c] != LF_ESCAPE) { lb_putc(b, (char)c); continue; }
+            switch (c) {
+                case '"':  lb_put(b, "\\\"", 2); break;
+                case '\\': lb_put(b, "\\\\", 2); break;
+                case '\n': lb_put(b, "\\n", 2); break;
+                case '\r': lb_put(b, "\\r", 2); break;
+                case '\t': lb_put(b, "\\t", 2); break;
+                default: {
+                    char u[4] = { '\\', 'x', hex[c >> 4], hex[c & 15] };
+                    lb_put(b, u, sizeof(u));
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void lb_logfmt_str(lbuf* b, const char* s, size_t n) {
+    unsigned cls = n ? logfmt_scan(s, n) : LF_QUOTE;   /* empty values are written as "" */
+    if (cls == LF_BARE) { lb_put(b, s, n); return; }
+    lb_putc(b, '"');
+    lb_logfmt_chars(b, s, n, cls);
+    lb_putc(b, '"');
+}
+
+static void lb_logfmt_cstr(lbuf* b, const char* s) {
+    lb_logfmt_str(b, s ? s : "", s ? strlen(s) : 0);
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Text layout for fields: " key=value". String values follow the logfmt
+   rules, so a control byte in a value is escaped and cannot start a new
+   line of its own. */
+static void render_text_field(lbuf* b, const LoggerField* f) {
+    char kb[LOGGER_KEY_MAX];
+    lb_putc(b, ' ');
+    lb_puts(b, field_key(f->key, kb));
+    lb_putc(b, '=');
+    switch (f->type) {
+        case LKV_T_INT:  lb_i64(b, f->v.i); break;
+        case LKV_T_UINT: lb_u64(b, f->v.u); break;
+        case LKV_T_F64:  lb_f64(b, f->v.f); break;
+        case LKV_T_BOOL: lb_puts(b, f->v.b ? "true" : "false"); break;
+        case LKV_T_STR:
+            lb_logfmt_str(b, f->v.s.p ? f->v.s.p : "", field_str_len(f));
+            break;
+        default: lb_putc(b, '?'); break;
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Everything in a text line between the timestamp and the message. */
+static void render_text_prefix(lbuf* b, const log_src* src, const log_rec* r) {
+    if (src->name) { lb_putc(b, '['); lb_puts(b, src->name); lb_put(b, "] ", 2); }
+    /* "%-8s " */
+    const char* lv = level_name(r->level);
+    size_t lvn = strlen(lv);
+    lb_put(b, lv, lvn);
+    for (; lvn < 8; ++lvn) lb_putc(b, ' ');
+    lb_putc(b, ' ');
+    if (r->category) { lb_putc(b, '('); lb_puts(b, r->category); lb_put(b, ") ", 2); }
+    lb_puts(b, r->file ? r->file : "(null)");
+    lb_putc(b, ':');
+    lb_i64(b, r->line);
+    lb_putc(b, ':');
+    lb_puts(b, r->func ? r->func : "(null)");
+    lb_put(b, ": ", 2);
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Everything in a logfmt line between "ts=..." and the message value. */
+static void render_logfmt_prefix(lbuf* b, const log_src* src, const log_rec* r) {
+    lb_puts(b, "level=");
+    lb_puts(b, level_name(r->level));
+    if (src->name) { lb_puts(b, " logger="); lb_logfmt_cstr(b, src->name); }
+    if (r->category) { lb_puts(b, " category="); lb_logfmt_cstr(b, r->category); }
+    /* caller=file:line, quoted as a whole if the path needs it */
+    char caller[LOGGER_PREFIX_MAX];
+    lbuf c = { caller, 0, sizeof(caller), false };
+    lb_puts(&c, r->file ? r->file : "?");
+    lb_putc(&c, ':');
+    lb_i64(&c, r->line);
+    lb_puts(b, " caller=");
+    lb_logfmt_str(b, c.p, c.len);
+    lb_puts(b, " func=");
+    lb_logfmt_cstr(b, r->func);
+    lb_puts(b, " msg=");
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- Per-call-site prefix cache ------------------------------------------------
+   The constant part of a line (name, level, category, file:line:func) only
+   depends on the call site and the Logger's layout configuration, so each
+   thread keeps a small direct-mapped cache of rendered prefixes and memcpy's
+   them. Entries are validated against the Logger id and layout generation,
+   so renames and re-initialization are picked up automatically. */
+
+typedef struct {
+    uint32_t     lg_id;    /* 0 = empty */
+    uint32_t     gen;
+    LoggerFormat fmt;
+    LogLevel     level;
+    int          line;
+    const char*  file;
+    const char*  func;
+    const char*  category;
+    size_t       len;
+    char         text[LOGGER_PREFIX_MAX];
+} prefix_slot;
+
+static LOGGER_THREAD_LOCAL prefix_slot tl_prefix[LOGGER_PREFIX_SLOTS];
+
+static void lb_prefix(lbuf* b, LoggerFormat fmt, const log_src* src, const log_rec* r) {
+    uintptr_t k = (uintptr_t)r->file ^ (uintptr_t)r->category
+                ^ ((uintptr_t)(unsigned)r->line * 31u) ^ ((uintptr_t)r->level << 3) ^ (uintptr_t)fmt;
+    prefix_slot* s = &tl_prefix[(k ^ (k >> 7)) % LOGGER_PREFIX_SLOTS];
+    if (s->lg_id == src->id && s->gen == src->gen && s->fmt == fmt &&
+        s->level == r->level && s->line == r->line && s->file == r->file &&
+        s->func == r->func && s->category == r->category) {
+        lb_put(b, s->text, s->len);
+        return;
+    }
+
+    lbuf p = { s->text, 0, sizeof(s->text), false };
+    if (fmt == LOGGER_FORMAT_LOGFMT) render_logfmt_prefix(&p, src, r);
+    else                             render_text_prefix(&p, src, r);
+    if (p.truncated || src->id == 0) {
+        /* Too long to cache (or no stable identity): render in place. */
+        s->lg_id = 0;
+        if (fmt == LOGGER_FORMAT_LOGFMT) render_logfmt_prefix(b, src, r);
+        else                             render_text_prefix(b, src, r);
+        return;
+    }
+    s->lg_id = src->id;
+    s->gen = src->gen;
+    s->fmt = fmt;
+    s->level = r->level;
+    s->line = r->line;
+    s->file = r->file;
+    s->func = r->func;
+    s->category = r->category;
+    s->len = p.len;
+    lb_put(b, s->text, s->len);
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void render_text(lbuf* b, const log_src* src, const log_rec* r,
+                        const char* ts, bool colorize) {
+    if (colorize) lb_puts(b, level_color(r->level));
+    if (ts && *ts) { lb_puts(b, ts); lb_putc(b, ' '); }
+    lb_prefix(b, LOGGER_FORMAT_TEXT, src, r);
+    const char* p;
+    size_t n;
+    for (msg_iter it = MSG_ITER(r); msg_next(&it, &p, &n);) lb_put(b, p, n);
+    for (size_t i = 0; i < r->n_fields; ++i) render_text_field(b, &r->fields[i]);
+    if (r->data) lb_hexdump(b, r->data, r->data_len);
+    /* Reset before the newline so a line-buffered TTY gets the whole record
+       in one write. */
+    if (colorize) lb_puts(b, "\033[0m");
+    lb_putc(b, '\n');
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- UTF-8 -----------------------------------------------------------------------
+   JSON strings, CBOR text strings and protobuf strings must be valid UTF-8,
+   but a message (a network buffer passed to logger_write_n, say) need not
+   be. Those encoders replace each byte that does not start a well-formed
+   sequence with U+FFFD. ASCII runs are skipped a word at a time. Fragments
+   are checked one by one, so a character split across two fragments is
+   replaced too. */
+
+/* Length of the well-formed sequence at s (1..4), or 0. */
+static size_t utf8_seq(const unsigned char* s, size_t n) {
+    unsigned char c = s[0];
+    if (c < 0x80) return 1;
+    size_t len;
+    unsigned char lo = 0x80, hi = 0xBF;   /* range of the second byte */
+    if (c >= 0xC2 && c <= 0xDF) {
+        len = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        len = 3;
+        if (c == 0xE0) lo = 0xA0;         /* overlong */
+        if (c == 0xED) hi = 0x9F;         /* surrogates */
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        len = 4;
+        if (c == 0xF0) lo = 0x90;         /* overlong */
+        if (c == 0xF4) hi = 0x8F;         /* above U+10FFFF */
+    } else {
+        return 0;
+    }
+    if (n < len || s[1] < lo || s[1] > hi) return 0;
+    for (size_t i = 2; i < len; ++i) {
+        if ((s[i] & 0xC0) != 0x80) return 0;
+    }
+    return len;
+}
+
+static size_t ascii_prefix(const char* s, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, s + i, sizeof(w));
+        if (w & 0x8080808080808080ull) break;
+    }
+    while (i < n && !((unsigned char)s[i] & 0x80)) ++i;
+    return i;
+}
+
+/* Appends s[0..n) with ill-formed bytes replaced when b is set; returns the
+   length of the result either way. */
+static size_t lb_utf8(lbuf* b, const char* s, size_t n) {
+    size_t out = 0, i = 0, start = 0;
+    while (i < n) {
+        i += ascii_prefix(s + i, n - i);
+        if (i == n) break;
+        size_t k = utf8_seq((const unsigned char*)s + i, n - i);
+        if (k) {
+            i += k;
+            continue;
+        }
+        if (b) {
+            lb_put(b, s + start, i - start);
+            lb_put(b, "\xEF\xBF\xBD", 3);
+        }
+        out += i - start + 3u;
+        start = ++i;
+    }
+    if (b) lb_put(b, s + start, n - start);
+    return out + n - start;
+}
+
+/* Message length once made valid UTF-8, marker included. */
+static size_t msg_utf8_len(const log_rec* r) {
+    size_t len = 0;
+    const char* p;
+    size_t n;
+    for (msg_iter it = MSG_ITER(r); msg_next(&it, &p, &n);) len += lb_utf8(NULL, p, n);
+    return len;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- JSON Lines --------------------------------------------------------------
+   Strings are copied in runs: a SIMD scan finds the next byte that needs
+   escaping ('"', '\\' or < 0x20) or UTF-8 checking (>= 0x80) 32 or 16 bytes
+   at a time, the clean run is memcpy'd, and only the offending byte takes the
+   slow path. */
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define LOGGER_JSON_SSE2 1
+#endif
+
+static const unsigned char json_needs_escape[256] = {
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,0,
+};
+
+// -------------------------------------------------------------------------------- 
+
+static unsigned ctz32(uint32_t m) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctz(m);
+#else
+    unsigned n = 0;
+    while (!(m & 1u)) { m >>= 1; ++n; }
+    return n;
+#endif
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Length of the leading run of s[0..n) that can be copied verbatim. */
+static size_t json_clean_prefix(const char* s, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i ctl = _mm256_set1_epi8(0x1F);
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(const void*)(s + i));
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, bslash)),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(v, ctl), ctl));   /* v <= 0x1F unsigned */
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(m, v));  /* | high bit */
+        if (bits) return i + ctz32(bits);
+    }
+#elif defined(LOGGER_JSON_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i ctl = _mm_set1_epi8(0x1F);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(const void*)(s + i));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(v, ctl), ctl));         /* v <= 0x1F unsigned */
+        uint32_t bits = (uint32_t)_mm_movemask_epi8(_mm_or_si128(m, v));        /* | high bit */
+        if (bits) return i + ctz32(bits);
+    }
+#endif
+    for (; i < n; ++i) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x80 || json_needs_escape[c]) return i;
+    }
+    return n;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Append s[0..n) escaped for a JSON string, without the quotes. Well-formed
+   UTF-8 passes through; other bytes >= 0x80 become an escaped U+FFFD. */
+static void lb_json_chars(lbuf* b, const char* s, size_t n) {
+    static const char hex[] = "0123456789abcdef";
+    while (n) {
+        size_t run = json_clean_prefix(s, n);
+        lb_put(b, s, run);
+        s += run;
+        n -= run;
+        if (!n) break;
+        unsigned char c = (unsigned char)*s++;
+        --n;
+        if (c >= 0x80) {
+            size_t k = utf8_seq((const unsigned char*)s - 1, n + 1);
+            if (k) {
+                lb_put(b, s - 1, k);
+                s += k - 1;
+                n -= k - 1;
+            } else {
+                lb_put(b, "\\ufffd", 6);
+            }
+            continue;
+        }
+        switch (c) {
+            case '"':  lb_put(b, "\\\"", 2); break;
+            case '\\': lb_put(b, "\\\\", 2); break;
+            case '\n': lb_put(b, "\\n", 2); break;
+            case '\r': lb_put(b, "\\r", 2); break;
+            case '\t': lb_put(b, "\\t", 2); break;
+            case '\b': lb_put(b, "\\b", 2); break;
+            case '\f': lb_put(b, "\\f", 2); break;
+            default: {
+                char u[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+                lb_put(b, u, sizeof(u));
+                break;
+            }
+        }
+    }
+}
+
+static void lb_json_str(lbuf* b, const char* s, size_t n) {
+    lb_putc(b, '"');
+    lb_json_chars(b, s, n);
+    lb_putc(b, '"');
+}
+
+static void lb_json_cstr(lbuf* b, const char* s) {
+    if (!s) { lb_puts(b, "null"); return; }
+    lb_json_str(b, s, strlen(s));
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Non-finite doubles are not valid JSON numbers; encode them as null. */
+static void lb_json_f64(lbuf* b, double v) {
+    if (v != v || v > 1.7976931348623157e308 || v < -1.7976931348623157e308) {
+        lb_puts(b, "null");
+        return;
+    }
+    lb_f64(b, v);
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void render_json(lbuf* b, const log_src* src, const log_rec* r, const char* ts) {
+    lb_putc(b, '{');
+    if (ts && *ts) {
+        lb_puts(b, "\"ts\":");
+        lb_json_cstr(b, ts);
+        lb_putc(b, ',');
+    }
+    lb_puts(b, "\"level\":\"");
+    lb_puts(b, level_name(r->level));
+    lb_putc(b, '"');
+    if (src->name) {
+        lb_puts(b, ",\"logger\":");
+        lb_json_cstr(b, src->name);
+    }
+    if (r->category) {
+        lb_puts(b, ",\"category\":");
+        lb_json_cstr(b, r->category);
+    }
+    lb_puts(b, ",\"file\":");
+    lb_json_cstr(b, r->file);
+    lb_puts(b, ",\"line\":");
+    lb_i64(b, r->line);
+    lb_puts(b, ",\"func\":");
+    lb_json_cstr(b, r->func);
+    lb_puts(b, ",\"msg\":\"");
+    const char* p;
+    size_t n;
+    for (msg_iter it = MSG_ITER(r); msg_next(&it, &p, &n);) lb_json_chars(b, p, n);
+    lb_putc(b, '"');
+    for (size_t i = 0; i < r->n_fields; ++i) {
+        const LoggerField* f = &r->fields[i];
+        char kb[LOGGER_KEY_MAX];
+        lb_putc(b, ',');
+        lb_json_cstr(b, field_key(f->key, kb));
+        lb_putc(b, ':');
+        switch (f->type) {
+            case LKV_T_INT:  lb_i64(b, f->v.i); break;
+            case LKV_T_UINT: lb_u64(b, f->v.u); break;
+            case LKV_T_F64:  lb_json_f64(b, f->v.f); break;
+            case LKV_T_BOOL: lb_puts(b, f->v.b ? "true" : "false"); break;
+            case LKV_T_STR:  lb_json_str(b, f->v.s.p ? f->v.s.p : "", field_str_len(f)); break;
+            default:         lb_puts(b, "null"); break;
+        }
+    }
+    if (r->data) {
+        lb_puts(b, ",\"data\":\"");
+        lb_hex(b, r->data, r->data_len);
+        lb_putc(b, '"');
+    }
+    lb_put(b, "}\n", 2);
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void render_logfmt(lbuf* b, const log_src* src, const log_rec* r, const char* ts) {
+    if (ts && *ts) {
+        lb_puts(b, "ts=");
+        lb_logfmt_cstr(b, ts);
+        lb_putc(b, ' ');
+    }
+    lb_prefix(b, LOGGER_FORMAT_LOGFMT, src, r);
+    const char* p;
+    size_t n;
+    unsigned cls = msg_total(r) ? LF_BARE : LF_QUOTE;
+    for (msg_iter it = MSG_ITER(r); msg_next(&it, &p, &n);) cls |= logfmt_scan(p, n);
+    if (cls != LF_BARE) lb_putc(b, '"');
+    for (msg_iter it = MSG_ITER(r); msg_next(&it, &p, &n);) lb_logfmt_chars(b, p, n, cls);
+    if (cls != LF_BARE) lb_putc(b, '"');
+    for (size_t i = 0; i < r->n_fields; ++i) {
+        const LoggerField* f = &r->fields[i];
+        char kb[LOGGER_KEY_MAX];
+        lb_putc(b, ' ');
+        lb_puts(b, field_key(f->key, kb));
+        lb_putc(b, '=');
+        switch (f->type) {
+            case LKV_T_INT:  lb_i64(b, f->v.i); break;
+            case LKV_T_UINT: lb_u64(b, f->v.u); break;
+            case LKV_T_F64:  lb_f64(b, f->v.f); break;
+            case LKV_T_BOOL: lb_puts(b, f->v.b ? "true" : "false"); break;
+            case LKV_T_STR:  lb_logfmt_str(b, f->v.s.p ? f->v.s.p : "", field_str_len(f)); break;
+            default:         lb_put(b, "\"\"", 2); break;
+        }
+    }
+    if (r->data) {
+        lb_puts(b, r->data_len ? " data=" : " data=\"\"");
+        lb_hex(b, r->data, r->data_len);
+    }
+    lb_putc(b, '\n');
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- CBOR ----------------------------------------------------------------------
+   Each record is one definite-length CBOR map (RFC 8949), so a sink holds a
+   plain CBOR sequence (RFC 8742) with no extra framing. Built-in keys match
+   the JSON layout; structured fields keep their native CBOR types. */
+
+static void cb_head(lbuf* b, unsigned major, uint64_t v) {
+    unsigned char h[9];
+    size_t n;
+    major <<= 5;
+    if (v < 24u)                { h[0] = (unsigned char)(major | v); n = 1; }
+    else if (v <= 0xFFu)        { h[0] = (unsigned char)(major | 24u); n = 2; }
+    else if (v <= 0xFFFFu)      { h[0] = (unsigned char)(major | 25u); n = 3; }
+    else if (v <= 0xFFFFFFFFu)  { h[0] = (unsigned char)(major | 26u); n = 5; }
+    else                        { h[0] = (unsigned char)(major | 27u); n = 9; }
+    for (size_t i = n - 1; i > 0; --i) { h[i] = (unsigned char)v; v >>= 8; }
+    lb_put(b, (const char*)h, n);
+}
+
+static void cb_text(lbuf* b, const char* s, size_t n) {
+    cb_head(b, 3u, lb_utf8(NULL, s, n));
+    lb_utf8(b, s, n);
+}
+
+static void cb_cstr(lbuf* b, const char* s) {
+    if (!s) { lb_putc(b, (char)0xF6); return; }  /* null */
+    cb_text(b, s, strlen(s));
+}
+
+static void cb_i64(lbuf* b, int64_t v) {
+    if (v < 0) cb_head(b, 1u, (uint64_t)(-(v + 1)));
+    else       cb_head(b, 0u, (uint64_t)v);
+}
+
+static void cb_f64(lbuf* b, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    unsigned char h[9];
+    h[0] = 0xFB;
+    for (size_t i = 8; i > 0; --i) { h[i] = (unsigned char)bits; bits >>= 8; }
+    lb_put(b, (const char*)h, sizeof(h));
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void render_cbor(lbuf* b, const log_src* src, const log_rec* r, const char* ts) {
+    bool has_ts = ts && *ts;
+    uint64_t pairs = 5u + (uint64_t)r->n_fields + (has_ts ? 1u : 0u) +
+                     (src->name ? 1u : 0u) + (r->category ? 1u : 0u) + (r->data ? 1u : 0u);
+    cb_head(b, 5u, pairs);
+    if (has_ts) { cb_cstr(b, "ts"); cb_cstr(b, ts); }
+    cb_cstr(b, "level");
+    cb_cstr(b, level_name(r->level));
+    if (src->name) { cb_cstr(b, "logger"); cb_cstr(b, src->name); }
+    if (r->category) { cb_cstr(b, "category"); cb_cstr(b, r->category); }
+    cb_cstr(b, "file");
+    cb_cstr(b, r->file);
+    cb_cstr(b, "line");
+    cb_i64(b, r->line);
+    cb_cstr(b, "func");
+    cb_cstr(b, r->func);
+    cb_cstr(b, "msg");
+    cb_head(b, 3u, msg_utf8_len(r));
+    const char* p;
+    size_t n;
+    for (msg_iter it = MSG_ITER(r); msg_next(&it, &p, &n);) lb_utf8(b, p, n);
+    for (size_t i = 0; i < r->n_fields; ++i) {
+        const LoggerField* f = &r->fields[i];
+        char kb[LOGGER_KEY_MAX];
+        cb_cstr(b, field_key(f->key, kb));
+        switch (f->type) {
+            case LKV_T_INT:  cb_i64(b, f->v.i); break;
+            case LKV_T_UINT: cb_head(b, 0u, f->v.u); break;
+            case LKV_T_F64:  cb_f64(b, f->v.f); break;
+            case LKV_T_BOOL: lb_putc(b, (char)(f->v.b ? 0xF5 : 0xF4)); break;
+            case LKV_T_STR:  cb_text(b, f->v.s.p ? f->v.s.p : "", field_str_len(f)); break;
+            default:         lb_putc(b, (char)0xF6); break;
+        }
+    }
+    if (r->data) {
+        cb_cstr(b, "data");
+        cb_head(b, 2u, r->data_len);   /* byte string: the payload as-is */
+        lb_put(b, (const char*)r->data, r->data_len);
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- OTLP ----------------------------------------------------------------------
+   Each record becomes one varint-length-delimited LogsData message holding a
+   single ResourceLogs -> ScopeLogs -> LogRecord (opentelemetry/proto/logs/v1).
+   The scope carries the Logger name, so a collector can forward the frames
+   unchanged. Nested lengths are known because the LogRecord is rendered
+   first, in place, and the headers are written in front of it. */
+
+#define OTLP_LEN(field)   (((unsigned)(field) << 3) | 2u)  /* length-delimited */
+#define OTLP_VARINT(field) ((unsigned)(field) << 3)
+#define OTLP_FIXED64(field) (((unsigned)(field) << 3) | 1u)
+
+static size_t pb_varint_size(uint64_t v) {
+    size_t n = 1;
+    while (v >= 0x80u) { v >>= 7; ++n; }
+    return n;
+}
+
+static void pb_varint(lbuf* b, uint64_t v) {
+    char tmp[10];
+    size_t n = 0;
+    while (v >= 0x80u) { tmp[n++] = (char)(v | 0x80u); v >>= 7; }
+    tmp[n++] = (char)v;
+    lb_put(b, tmp, n);
+}
+
+static void pb_fixed64(lbuf* b, unsigned field, uint64_t v) {
+    char tmp[8];
+    for (size_t i = 0; i < 8; ++i) { tmp[i] = (char)(v & 0xFFu); v >>= 8; }
+    pb_varint(b, OTLP_FIXED64(field));
+    lb_put(b, tmp, sizeof(tmp));
+}
+
+static void pb_bytes(lbuf* b, unsigned field, const char* s, size_t n) {
+    pb_varint(b, OTLP_LEN(field));
+    pb_varint(b, n);
+    lb_put(b, s, n);
+}
+
+static size_t pb_bytes_size(unsigned field, size_t n) {
+    return pb_varint_size(OTLP_LEN(field)) + pb_varint_size(n) + n;
+}
+
+/* A protobuf string field: like pb_bytes, made valid UTF-8. */
+static void pb_str(lbuf* b, unsigned field, const char* s, size_t n) {
+    pb_varint(b, OTLP_LEN(field));
+    pb_varint(b, lb_utf8(NULL, s, n));
+    lb_utf8(b, s, n);
+}
+
+// -------------------------------------------------------------------------------- 
+
+static unsigned otlp_severity(LogLevel lv) {
+    switch (lv) {
+        case LOG_DEBUG:    return 5;   /* SEVERITY_NUMBER_DEBUG */
+        case LOG_INFO:     return 9;   /* SEVERITY_NUMBER_INFO */
+        case LOG_WARNING:  return 13;  /* SEVERITY_NUMBER_WARN */
+        case LOG_ERROR:    return 17;  /* SEVERITY_NUMBER_ERROR */
+        case LOG_CRITICAL: return 21;  /* SEVERITY_NUMBER_FATAL */
+        default:           return 0;   /* SEVERITY_NUMBER_UNSPECIFIED */
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* AnyValue fields: 1 string, 2 bool, 3 int, 4 double, 7 bytes. */
+static void pb_any_str(lbuf* b, const char* s, size_t n) {
+    pb_str(b, 1u, s, n);
+}
+
+static void pb_attr_str(lbuf* b, const char* key, const char* s, size_t n) {
+    size_t klen = strlen(key);
+    size_t vlen = pb_bytes_size(1u, lb_utf8(NULL, s, n));
+    pb_varint(b, OTLP_LEN(6));                              /* LogRecord.attributes */
+    pb_varint(b, pb_bytes_size(1u, klen) + pb_bytes_size(2u, vlen));
+    pb_bytes(b, 1u, key, klen);                             /* KeyValue.key */
+    pb_varint(b, OTLP_LEN(2));                              /* KeyValue.value */
+    pb_varint(b, vlen);
+    pb_any_str(b, s, n);
+}
+
+static void pb_attr_bytes(lbuf* b, const char* key, const unsigned char* p, size_t n) {
+    size_t klen = strlen(key);
+    size_t vlen = pb_bytes_size(7u, n);
+    pb_varint(b, OTLP_LEN(6));
+    pb_varint(b, pb_bytes_size(1u, klen) + pb_bytes_size(2u, vlen));
+    pb_bytes(b, 1u, key, klen);
+    pb_varint(b, OTLP_LEN(2));
+    pb_varint(b, vlen);
+    pb_bytes(b, 7u, (const char*)p, n);
+}
+
+static void pb_attr_int(lbuf* b, const char* key, int64_t v) {
+    size_t klen = strlen(key);
+    size_t vlen = 1u + pb_varint_size((uint64_t)v);
+    pb_varint(b, OTLP_LEN(6));
+    pb_varint(b, pb_bytes_size(1u, klen) + pb_bytes_size(2u, vlen));
+    pb_bytes(b, 1u, key, klen);
+    pb_varint(b, OTLP_LEN(2));
+    pb_varint(b, vlen);
+    pb_varint(b, OTLP_VARINT(3));
+    pb_varint(b, (uint64_t)v);
+}
+
+static void pb_attr_bool(lbuf* b, const char* key, bool v) {
+    size_t klen = strlen(key);
+    pb_varint(b, OTLP_LEN(6));
+    pb_varint(b, pb_bytes_size(1u, klen) + pb_bytes_size(2u, 2u));
+    pb_bytes(b, 1u, key, klen);
+    pb_varint(b, OTLP_LEN(2));
+    pb_varint(b, 2u);
+    pb_varint(b, OTLP_VARINT(2));
+    pb_varint(b, v ? 1u : 0u);
+}
+
+static void pb_attr_f64(lbuf* b, const char* key, double v) {
+    size_t klen = strlen(key);
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    pb_varint(b, OTLP_LEN(6));
+    pb_varint(b, pb_bytes_size(1u, klen) + pb_bytes_size(2u, 9u));
+    pb_bytes(b, 1u, key, klen);
+    pb_varint(b, OTLP_LEN(2));
+    pb_varint(b, 9u);
+    pb_fixed64(b, 4u, bits);
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void render_otlp(lbuf* b, const log_src* src, const log_rec* r, const char* ts) {
+    /* The LogRecord is encoded into b's free space past room for the frame
+       header and moved down once its length is known, so a record is bounded
+       only by b. */
+    size_t name_len = src->name ? lb_utf8(NULL, src->name, strlen(src->name)) : 0;
+    size_t reserve  = 64u + name_len;  /* >= 7 tags/varints + scope name */
+    if (b->cap - b->len < reserve) {
+        b->truncated = true;
+        return;
+    }
+    lbuf rec = { b->p + b->len + reserve, 0, b->cap - b->len - reserve, false };
+
+    /* LogRecord */
+    if (ts && *ts) {
+        uint64_t now = wall_ns();
+        pb_fixed64(&rec, 1u, now);    /* time_unix_nano */
+        pb_fixed64(&rec, 11u, now);   /* observed_time_unix_nano */
+    }
+    pb_varint(&rec, OTLP_VARINT(2));  /* severity_number */
+    pb_varint(&rec, otlp_severity(r->level));
+    const char* lv = level_name(r->level);
+    pb_bytes(&rec, 3u, lv, strlen(lv));  /* severity_text */
+    pb_varint(&rec, OTLP_LEN(5));     /* body: AnyValue{string_value} */
+    size_t msg_len = msg_utf8_len(r);
+    pb_varint(&rec, pb_bytes_size(1u, msg_len));
+    pb_varint(&rec, OTLP_LEN(1));     /* string_value */
+    pb_varint(&rec, msg_len);
+    const char* p;
+    size_t n;
+    for (msg_iter it = MSG_ITER(r); msg_next(&it, &p, &n);) lb_utf8(&rec, p, n);
+    if (r->file) pb_attr_str(&rec, "code.file.path", r->file, strlen(r->file));
+    pb_attr_int(&rec, "code.line.number", r->line);
+    if (r->func) pb_attr_str(&rec, "code.function.name", r->func, strlen(r->func));
+    if (r->category) pb_attr_str(&rec, "log.category", r->category, strlen(r->category));
+    for (size_t i = 0; i < r->n_fields; ++i) {
+        const LoggerField* f = &r->fields[i];
+        char kb[LOGGER_KEY_MAX];
+        const char* key = field_key(f->key, kb);
+        switch (f->type) {
+            case LKV_T_INT:  pb_attr_int(&rec, key, f->v.i); break;
+            case LKV_T_UINT:
+                if (f->v.u <= (uint64_t)INT64_MAX) {
+                    pb_attr_int(&rec, key, (int64_t)f->v.u);
+                } else {
+                    /* Beyond int64: keep the exact value as a decimal string. */
+                    char num[24];
+                    lbuf nb = { num, 0, sizeof(num), false };
+                    lb_u64(&nb, f->v.u);
+                    pb_attr_str(&rec, key, nb.p, nb.len);
+                }
+                break;
+            case LKV_T_F64:  pb_attr_f64(&rec, key, f->v.f); break;
+            case LKV_T_BOOL: pb_attr_bool(&rec, key, f->v.b); break;
+            case LKV_T_STR:  pb_attr_str(&rec, key, f->v.s.p ? f->v.s.p : "", field_str_len(f)); break;
+            default: break;
+        }
+    }
+    if (r->data) pb_attr_bytes(&rec, "data", r->data, r->data_len);
+    if (rec.truncated) {
+        b->truncated = true;
+        return;
+    }
+
+    /* ScopeLogs { scope = InstrumentationScope{name}, log_records = [rec] } */
+    size_t scope_len = src->name ? pb_bytes_size(1u, name_len) : 0;
+    size_t sl_len    = (src->name ? pb_bytes_size(1u, scope_len) : 0) + pb_bytes_size(2u, rec.len);
+    size_t rl_len    = pb_bytes_size(2u, sl_len);   /* ResourceLogs.scope_logs */
+    size_t ld_len    = pb_bytes_size(1u, rl_len);   /* LogsData.resource_logs */
+
+    pb_varint(b, ld_len);                           /* frame length */
+    pb_varint(b, OTLP_LEN(1));
+    pb_varint(b, rl_len);
+    pb_varint(b, OTLP_LEN(2));
+    pb_varint(b, sl_len);
+    if (src->name) {
+        pb_varint(b, OTLP_LEN(1));
+        pb_varint(b, scope_len);
+        pb_str(b, 1u, src->name, strlen(src->name));
+    }
+    pb_varint(b, OTLP_LEN(2));
+    pb_varint(b, rec.len);
+    memmove(b->p + b->len, rec.p, rec.len);
+    b->len += rec.len;
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void render(lbuf* b, LoggerFormat fmt, bool colorize, const char* ts,
+                   const log_src* src, const log_rec* r) {
+    switch (fmt) {
+        case LOGGER_FORMAT_JSON:   render_json(b, src, r, ts); break;
+        case LOGGER_FORMAT_LOGFMT: render_logfmt(b, src, r, ts); break;
+        case LOGGER_FORMAT_CBOR:   render_cbor(b, src, r, ts); break;
+        case LOGGER_FORMAT_OTLP:   render_otlp(b, src, r, ts); break;
+        case LOGGER_FORMAT_TEXT:
+        default:                 render_text(b, src, r, ts, colorize); break;
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- CBOR decoding -------------------------------------------------------------
+   The inverse of render_cbor: one map is parsed back into a log_rec and handed
+   to the regular renderers. Only what the encoder produces (plus single-precision
+   floats and null field values) is accepted. */
+
+#define LOGGER_CBOR_MAX_FIELDS 64
+
+typedef struct {
+    const unsigned char* p;
+    const unsigned char* end;
+    lbuf                 arena;  /* NUL-terminated copies of decoded strings */
+} cb_cur;
+
+static bool cb_read_head(cb_cur* c, unsigned* major, unsigned* info, uint64_t* v) {
+    if (c->p >= c->end) return false;
+    unsigned ib = *c->p++;
+    *major = ib >> 5;
+    *info  = ib & 31u;
+    if (*info < 24u) { *v = *info; return true; }
+    if (*info > 27u) return false;  /* reserved or indefinite length */
+    size_t n = (size_t)1 << (*info - 24u);
+    if ((size_t)(c->end - c->p) < n) return false;
+    uint64_t x = 0;
+    for (size_t i = 0; i < n; ++i) x = (x << 8) | *c->p++;
+    *v = x;
+    return true;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Copies a text string (or null) to the arena; *s is NULL for null. */
+static bool cb_read_text(cb_cur* c, const char** s, size_t* n) {
+    unsigned major, info;
+    uint64_t v;
+    if (!cb_read_head(c, &major, &info, &v)) return false;
+    if (major == 7u && info == 22u) { *s = NULL; *n = 0; return true; }
+    if (major != 3u || v > (uint64_t)(c->end - c->p)) return false;
+    *s = c->arena.p + c->arena.len;
+    *n = (size_t)v;
+    lb_put(&c->arena, (const char*)c->p, (size_t)v);
+    lb_putc(&c->arena, '\0');
+    c->p += v;
+    return !c->arena.truncated;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* A text (major 3) or byte (major 2) string left in the input, uncopied:
+   the message and payload are only read by length, so they are not bound
+   by the arena's size. */
+static bool cb_read_span(cb_cur* c, unsigned want, const unsigned char** s, size_t* n) {
+    unsigned major, info;
+    uint64_t v;
+    if (!cb_read_head(c, &major, &info, &v)) return false;
+    if (major != want || v > (uint64_t)(c->end - c->p)) return false;
+    *s = c->p;
+    *n = (size_t)v;
+    c->p += v;
+    return true;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Decodes one field value. Returns false on malformed input; *keep is false
+   for values that have no LoggerField equivalent (null). */
+static bool cb_read_value(cb_cur* c, LoggerField* f, bool* keep) {
+    unsigned major, info;
+    uint64_t v;
+    *keep = true;
+    if (c->p < c->end && (*c->p >> 5) == 3u) {
+        size_t n;
+        f->type = LKV_T_STR;
+        if (!cb_read_text(c, &f->v.s.p, &n)) return false;
+        f->v.s.n = n;
+        return true;
+    }
+    if (!cb_read_head(c, &major, &info, &v)) return false;
+    switch (major) {
+        case 0u:
+            if (v <= (uint64_t)INT64_MAX) { f->type = LKV_T_INT; f->v.i = (int64_t)v; }
+            else                          { f->type = LKV_T_UINT; f->v.u = v; }
+            return true;
+        case 1u:
+            if (v > (uint64_t)INT64_MAX) return false;
+            f->type = LKV_T_INT;
+            f->v.i = -1 - (int64_t)v;
+            return true;
+        case 7u:
+            switch (info) {
+                case 20u: case 21u: f->type = LKV_T_BOOL; f->v.b = info == 21u; return true;
+                case 22u: *keep = false; return true;
+                case 26u: {
+                    uint32_t bits = (uint32_t)v;
+                    float x;
+                    memcpy(&x, &bits, sizeof(x));
+                    f->type = LKV_T_F64;
+                    f->v.f = x;
+                    return true;
+                }
+                case 27u:
+                    f->type = LKV_T_F64;
+                    memcpy(&f->v.f, &v, sizeof(f->v.f));
+                    return true;
+                default: return false;
+            }
+        default:
+            return false;
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+static bool cb_level(const char* s, LogLevel* out) {
+    static const LogLevel levels[] = { LOG_DEBUG, LOG_INFO, LOG_WARNING, LOG_ERROR, LOG_CRITICAL };
+    for (size_t i = 0; s && i < sizeof(levels) / sizeof(levels[0]); ++i) {
+        if (strcmp(s, level_name(levels[i])) == 0) { *out = levels[i]; return true; }
+    }
+    return false;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Parses one record map. Strings point into the cursor's arena. */
+static bool cb_read_record(cb_cur* c, log_rec* r, LoggerField* fields,
+                           const char** ts, const char** name) {
+    enum { SEEN_TS = 1, SEEN_LEVEL = 2, SEEN_LOGGER = 4, SEEN_CAT = 8,
+           SEEN_FILE = 16, SEEN_LINE = 32, SEEN_FUNC = 64, SEEN_MSG = 128,
+           SEEN_DATA = 256 };
+    unsigned seen = 0;
+    unsigned major, info;
+    uint64_t pairs;
+    if (!cb_read_head(c, &major, &info, &pairs) || major != 5u) return false;
+
+    for (uint64_t i = 0; i < pairs; ++i) {
+        const char* key;
+        const char* lv;
+        size_t n;
+        if (!cb_read_text(c, &key, &n) || !key) return false;
+        /* The first occurrence of a built-in key is the record's own; later
+           ones are structured fields that happen to share the name. */
+        bool ok;
+        if (!(seen & SEEN_TS) && strcmp(key, "ts") == 0) {
+            seen |= SEEN_TS;
+            ok = cb_read_text(c, ts, &n);
+        } else if (!(seen & SEEN_LEVEL) && strcmp(key, "level") == 0) {
+            seen |= SEEN_LEVEL;
+            ok = cb_read_text(c, &lv, &n) && cb_level(lv, &r->level);
+        } else if (!(seen & SEEN_LOGGER) && strcmp(key, "logger") == 0) {
+            seen |= SEEN_LOGGER;
+            ok = cb_read_text(c, name, &n);
+        } else if (!(seen & SEEN_CAT) && strcmp(key, "category") == 0) {
+            seen |= SEEN_CAT;
+            ok = cb_read_text(c, &r->category, &n);
+        } else if (!(seen & SEEN_FILE) && strcmp(key, "file") == 0) {
+            seen |= SEEN_FILE;
+            ok = cb_read_text(c, &r->file, &n);
+        } else if (!(seen & SEEN_FUNC) && strcmp(key, "func") == 0) {
+            seen |= SEEN_FUNC;
+            ok = cb_read_text(c, &r->func, &n);
+        } else if (!(seen & SEEN_MSG) && strcmp(key, "msg") == 0) {
+            seen |= SEEN_MSG;
+            const unsigned char* s;
+            ok = cb_read_span(c, 3u, &s, &r->msg_len);
+            r->msg = (const char*)s;
+        } else if (!(seen & SEEN_DATA) && strcmp(key, "data") == 0 &&
+                   c->p < c->end && (*c->p >> 5) == 2u) {
+            seen |= SEEN_DATA;
+            ok = cb_read_span(c, 2u, &r->data, &r->data_len);
+        } else {
+            LoggerField f = {0};
+            bool keep;
+            ok = cb_read_value(c, &f, &keep);
+            if (ok && keep && !(seen & SEEN_LINE) && strcmp(key, "line") == 0 &&
+                f.type == LKV_T_INT && f.v.i == (int)f.v.i) {
+                seen |= SEEN_LINE;
+                r->line = (int)f.v.i;
+            } else if (ok && keep) {
+                if (r->n_fields == LOGGER_CBOR_MAX_FIELDS) return false;
+                f.key = key;
+                fields[r->n_fields++] = f;
+            }
+        }
+        if (!ok) return false;
+    }
+    return (seen & SEEN_LEVEL) && r->msg;
+}
+
+// -------------------------------------------------------------------------------- 
+
+bool logger_cbor_decode(const void* data, size_t len, size_t* consumed,
+                        LoggerFormat format, char* out, size_t out_cap, size_t* out_len) {
+    if (!data || !out || (unsigned)format >= LOGGER_FORMAT_COUNT ||
+        format == LOGGER_FORMAT_CBOR || format == LOGGER_FORMAT_OTLP) {
+        errno = EINVAL;
+        return false;
+    }
+
+    char scratch[LOGGER_LINE_MAX];
+    LoggerField fields[LOGGER_CBOR_MAX_FIELDS];
+    cb_cur c = { (const unsigned char*)data, (const unsigned char*)data + len,
+                 { scratch, 0, sizeof(scratch), false } };
+    log_rec r = { LOG_INFO, NULL, NULL, 0, NULL, NULL, 0, fields, 0, NULL, 0, NULL, 0, 0 };
+    const char* ts = NULL;
+    const char* name = NULL;
+    if (!cb_read_record(&c, &r, fields, &ts, &name)) {
+        errno = EINVAL;
+        return false;
+    }
+
+    log_src src = { name, 0u, 0u };  /* id 0 bypasses the prefix cache */
+    lbuf b = { out, 0, out_cap, false };
+    render(&b, format, false, ts, &src, &r);
+    if (b.truncated) {
+        errno = ERANGE;
+        return false;
+    }
+    if (consumed) *consumed = (size_t)(c.p - (const unsigned char*)data);
+    if (out_len) *out_len = b.len;
+    return true;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Renders and writes one record; returns false on a short write or failed
+   flush. *written receives the bytes handed to stdio and *cut whether the
+   record had to be shortened to fit. The record is only flushed when 'flush'
+   is set, so buffered sinks cost one write(2) per buffer-full rather than per
+   record. */
+static bool emit_one(FILE* out, LoggerFormat fmt, bool colorize, bool flush, const char* ts,
+                     const log_src* src, const log_rec* r, size_t* written, bool* cut_out)
+{
+    *written = 0;
+    *cut_out = false;
+    if (!out) return true;
+
+    char line[LOGGER_LINE_MAX];
+    lbuf b = { line, 0, sizeof(line), false };
+    render(&b, fmt, colorize, ts, src, r);
+    /* A record that does not fit is rendered again into the thread's line
+       arena, doubling it until the record fits, so it is still one write. */
+    size_t want = 2 * sizeof(line);
+    size_t need = r->msg_len + 5u * r->data_len + LOGGER_LINE_MAX;  /* a dump line: 16 bytes in 79 */
+    while (want < need && want < LOGGER_RECORD_MAX) want *= 2;
+    for (; b.truncated && want <= LOGGER_RECORD_MAX; want *= 2) {
+        char* big = arena_reserve(&tl_line_arena, want);
+        if (!big) break;
+        b = (lbuf){ big, 0, want, false };
+        render(&b, fmt, colorize, ts, src, r);
+    }
+    if (b.truncated) {
+        /* Shorten the payload, then the message (then drop fields) until the
+           record fits, so that every format stays well-formed. The message
+           says how much was cut. */
+        log_rec cut = *r;
+        while (b.truncated && (cut.data_len || cut.msg_len || cut.n_fields)) {
+            if (cut.data_len) cut.data_len /= 2;
+            else if (cut.msg_len) cut.msg_len /= 2;
+            else cut.n_fields = 0;
+            cut.dropped = r->dropped + (r->msg_len - cut.msg_len) + (r->data_len - cut.data_len);
+            *cut_out = true;
+            b.len = 0;
+            b.truncated = false;
+            render(&b, fmt, colorize, ts, src, &cut);
+        }
+    }
+    *written = fwrite(b.p, 1, b.len, out);
+    bool flushed = !flush || fflush(out) == 0;
+    return *written == b.len && flushed;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- Call trace ----------------------------------------------------------------
+   A traced call claims a slot with one fetch-add and fills it in place. The
+   'writers' count lets logger_trace_stop() wait until every claimed slot is
+   complete before the caller reads the buffer. */
+
+static atomic_uint g_trace_next_thread;
+static LOGGER_THREAD_LOCAL uint32_t tl_trace_thread;  /* 0 = unassigned */
+
+static void trace_call(Logger* lg, LogLevel level, const char* file, int line,
+                       unsigned flags, const log_rec* r) {
+    LoggerTrace* t = &lg->trace;
+    if (!atomic_load_explicit(&t->on, memory_order_relaxed)) return;
+    atomic_fetch_add(&t->writers, 1u);
+    if (!atomic_load(&t->on)) {
+        atomic_fetch_sub(&t->writers, 1u);
+        return;
+    }
+    size_t i = atomic_fetch_add_explicit(&t->next, 1u, memory_order_relaxed);
+    if (i < t->cap) {
+        if (tl_trace_thread == 0) {
+            do { tl_trace_thread = atomic_fetch_add(&g_trace_next_thread, 1u) + 1u; }
+            while (tl_trace_thread == 0);
+        }
+        LoggerTraceEvent* e = &t->events[i];
+        memset(e, 0, sizeof(*e));
+        e->t_ns = mono_ns() - t->start_ns;
+        e->thread = tl_trace_thread;
+        e->site = file ? (uint32_t)(((uintptr_t)file * 0x9E3779B97F4A7C15ull) >> 32) : 0u;
+        e->line = line > 0 ? (uint32_t)line : 0u;
+        size_t fl = file ? strlen(file) : 0;
+        e->file_len = fl > UINT16_MAX ? UINT16_MAX : (uint16_t)fl;
+        e->level = (uint8_t)level;
+        e->flags = (uint8_t)flags;
+        if (r) {
+            e->msg_len = (uint32_t)r->msg_len;
+            e->n_fields = r->n_fields > UINT8_MAX ? UINT8_MAX : (uint8_t)r->n_fields;
+            size_t fb = 0;
+            for (size_t k = 0; k < r->n_fields; ++k) {
+                const LoggerField* f = &r->fields[k];
+                fb += f->key ? strlen(f->key) : 0;
+                if (f->type == LKV_T_STR) fb += field_str_len(f);
+            }
+            e->fields_len = (uint32_t)fb;
+        }
+    }
+    atomic_fetch_sub(&t->writers, 1u);
+}
+
+// -------------------------------------------------------------------------------- 
+
+bool logger_trace_start(Logger* lg, LoggerTraceEvent* events, size_t cap) {
+    if (!lg || !events || cap == 0) {
+        errno = EINVAL;
+        return false;
+    }
+    logger_trace_stop(lg, NULL);
+    LoggerTrace* t = &lg->trace;
+    t->events = events;
+    t->cap = cap;
+    t->start_ns = mono_ns();
+    atomic_store(&t->next, 0u);
+    atomic_store(&t->on, true);
+    return true;
+}
+
+// -------------------------------------------------------------------------------- 
+
+size_t logger_trace_stop(Logger* lg, uint64_t* dropped) {
+    if (dropped) *dropped = 0;
+    if (!lg) {
+        errno = EINVAL;
+        return 0;
+    }
+    LoggerTrace* t = &lg->trace;
+    atomic_store(&t->on, false);
+    while (atomic_load(&t->writers) != 0) yield_cpu();  /* a writer may be preempted */
+    size_t n = atomic_load(&t->next);
+    if (dropped && n > t->cap) *dropped = n - t->cap;
+    return n < t->cap ? n : t->cap;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Version 2 stores each event field by field, little-endian, so a trace
+   moves between hosts and compilers; version 1 was a raw struct dump. */
+#define LOGGER_TRACE_MAGIC "CLOGTRC2"
+#define LOGGER_TRACE_EVENT_BYTES 33u  /* 8 + 5 * 4 + 2 + 3 * 1 */
+#define LOGGER_TRACE_CHUNK 128u       /* Events per fread/fwrite */
+
+static void put_le(unsigned char* p, uint64_t v, unsigned bytes) {
+    for (unsigned i = 0; i < bytes; ++i) p[i] = (unsigned char)(v >> (8u * i));
+}
+
+static uint64_t get_le(const unsigned char* p, unsigned bytes) {
+    uint64_t v = 0;
+    for (unsigned i = bytes; i-- > 0;) v = (v << 8) | p[i];
+    return v;
+}
+
+static void put_le32(unsigned char* p, uint32_t v) { put_le(p, v, 4u); }
+static uint32_t get_le32(const unsigned char* p) { return (uint32_t)get_le(p, 4u); }
+
+static void trace_encode(unsigned char* p, const LoggerTraceEvent* e) {
+    put_le(p, e->t_ns, 8u);
+    put_le32(p + 8, e->thread);
+    put_le32(p + 12, e->site);
+    put_le32(p + 16, e->line);
+    put_le32(p + 20, e->msg_len);
+    put_le32(p + 24, e->fields_len);
+    put_le(p + 28, e->file_len, 2u);
+    p[30] = e->n_fields;
+    p[31] = e->level;
+    p[32] = e->flags;
+}
+
+static void trace_decode(const unsigned char* p, LoggerTraceEvent* e) {
+    memset(e, 0, sizeof(*e));
+    e->t_ns       = get_le(p, 8u);
+    e->thread     = get_le32(p + 8);
+    e->site       = get_le32(p + 12);
+    e->line       = get_le32(p + 16);
+    e->msg_len    = get_le32(p + 20);
+    e->fields_len = get_le32(p + 24);
+    e->file_len   = (uint16_t)get_le(p + 28, 2u);
+    e->n_fields   = p[30];
+    e->level      = p[31];
+    e->flags      = p[32];
+}
+
+// -------------------------------------------------------------------------------- 
+
+bool logger_trace_save(const char* path, const LoggerTraceEvent* events, size_t n) {
+    if (!path || (!events && n) || n > UINT32_MAX) {
+        errno = EINVAL;
+        return false;
+    }
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    unsigned char hdr[16];
+    memcpy(hdr, LOGGER_TRACE_MAGIC, 8);
+    put_le32(hdr + 8, LOGGER_TRACE_EVENT_BYTES);
+    put_le32(hdr + 12, (uint32_t)n);
+    bool ok = fwrite(hdr, 1, sizeof(hdr), f) == sizeof(hdr);
+    unsigned char chunk[LOGGER_TRACE_CHUNK * LOGGER_TRACE_EVENT_BYTES];
+    for (size_t i = 0; ok && i < n; i += LOGGER_TRACE_CHUNK) {
+        size_t k = n - i < LOGGER_TRACE_CHUNK ? n - i : LOGGER_TRACE_CHUNK;
+        for (size_t j = 0; j < k; ++j) trace_encode(chunk + j * LOGGER_TRACE_EVENT_BYTES, &events[i + j]);
+        ok = fwrite(chunk, LOGGER_TRACE_EVENT_BYTES, k, f) == k;
+    }
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+}
+
+// -------------------------------------------------------------------------------- 
+
+bool logger_trace_load(const char* path, LoggerTraceEvent* out, size_t cap, size_t* n) {
+    if (!path || !n) {
+        errno = EINVAL;
+        return false;
+    }
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    unsigned char hdr[16];
+    bool ok = fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr) &&
+              memcmp(hdr, LOGGER_TRACE_MAGIC, 8) == 0 &&
+              get_le32(hdr + 8) == LOGGER_TRACE_EVENT_BYTES;
+    if (!ok) {
+        fclose(f);
+        errno = EINVAL;
+        return false;
+    }
+    size_t count = get_le32(hdr + 12);
+    *n = count;
+    if (out && count > cap) {
+        fclose(f);
+        errno = ERANGE;
+        return false;
+    }
+    unsigned char chunk[LOGGER_TRACE_CHUNK * LOGGER_TRACE_EVENT_BYTES];
+    for (size_t i = 0; out && i < count; i += LOGGER_TRACE_CHUNK) {
+        size_t k = count - i < LOGGER_TRACE_CHUNK ? count - i : LOGGER_TRACE_CHUNK;
+        if (fread(chunk, LOGGER_TRACE_EVENT_BYTES, k, f) != k) {
+            fclose(f);
+            errno = EINVAL;  /* truncated */
+            return false;
+        }
+        for (size_t j = 0; j < k; ++j) trace_decode(chunk + j * LOGGER_TRACE_EVENT_BYTES, &out[i + j]);
+    }
+    fclose(f);
+    return true;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* ---- Adaptive budget -----------------------------------------------------------
+   Sites are found by open addressing on a hash of file/line. Admission runs
+   before formatting and only touches the site's own atomics; the thread that
+   closes a window rebalances the sample rates. Counts are approximate under
+   concurrency, which is fine for a throttle. */
+
+#define LOGGER_BUDGET_MAX_SHIFT 10u  /* 1/1024 */
+#define LOGGER_BUDGET_PROBES    4
+
+static bool budget_enabled(const Logger* lg) {
+    return atomic_load_explicit(&lg->budget.records_per_sec, memory_order_relaxed) != 0 ||
+           atomic_load_explicit(&lg->budget.msg_bytes_per_sec, memory_order_relaxed) != 0;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Slots are freed by budget_rebalance, so a free slot can sit in front of
+   the key's own: look at every probe for the key before claiming one. */
+static LoggerBudgetSite* budget_site(Logger* lg, const char* file, int line) {
+    uintptr_t key = (uintptr_t)file ^ ((uintptr_t)(unsigned)line * (uintptr_t)0x9E3779B97F4A7C15ull);
+    if (key == 0) key = 1;
+    size_t start = (size_t)(key ^ (key >> 17)) % LOGGER_BUDGET_SITES;
+    LoggerBudgetSite* free_slot = NULL;
+    for (size_t i = 0; i < LOGGER_BUDGET_PROBES; ++i) {
+        LoggerBudgetSite* s = &lg->budget.sites[(start + i) % LOGGER_BUDGET_SITES];
+        uintptr_t k = atomic_load_explicit(&s->key, memory_order_relaxed);
+        if (k == key) return s;
+        if (k == 0 && !free_slot) free_slot = s;
+    }
+    if (free_slot) {
+        uintptr_t k = 0;
+        if (atomic_compare_exchange_strong_explicit(&free_slot->key, &k, key,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed)) {
+            return free_slot;
+        }
+        if (k == key) return free_slot;
+    }
+    return NULL;  /* table crowded: leave this site untracked */
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Pre-format admission. ERROR and above always pass. */
+static bool budget_admit(Logger* lg, LogLevel level, const char* file, int line) {
+    if (level >= LOG_ERROR || !budget_enabled(lg)) return true;
+    LoggerBudgetSite* s = budget_site(lg, file, line);
+    if (!s) {
+        atomic_fetch_add_explicit(&lg->budget.untracked, 1u, memory_order_relaxed);
+        return true;
+    }
+    unsigned shift = atomic_load_explicit(&s->sample_shift, memory_order_relaxed);
+    if (shift) {
+        uint64_t t = atomic_fetch_add_explicit(&s->tick, 1u, memory_order_relaxed);
+        if (t & ((1ull << shift) - 1u)) {
+            atomic_fetch_add_explicit(&lg->budget.dropped, 1u, memory_order_relaxed);
+            return false;
+        }
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Close the window: demote sites above their fair share if over budget,
+   restore one step if comfortably under, and free the slots of sites that
+   were idle all window at full rate. */
+static void budget_rebalance(Logger* lg, uint64_t elapsed_ns) {
+    LoggerBudget* b = &lg->budget;
+    double secs    = (double)elapsed_ns / 1e9;
+    double records = (double)atomic_exchange_explicit(&b->window_records, 0u, memory_order_relaxed);
+    double bytes   = (double)atomic_exchange_explicit(&b->window_bytes, 0u, memory_order_relaxed);
+    uint32_t rec_limit  = atomic_load_explicit(&b->records_per_sec, memory_order_relaxed);
+    uint64_t byte_limit = atomic_load_explicit(&b->msg_bytes_per_sec, memory_order_relaxed);
+    double ratio = 0.0;
+    if (rec_limit) ratio = records / secs / (double)rec_limit;
+    if (byte_limit) {
+        double r = bytes / secs / (double)byte_limit;
+        if (r > ratio) ratio = r;
+    }
+
+    size_t active = 0;
+    for (size_t i = 0; i < LOGGER_BUDGET_SITES; ++i) {
+        if (atomic_load_explicit(&b->sites[i].records, memory_order_relaxed)) ++active;
+    }
+
+    unsigned step = 0;
+    while (step < LOGGER_BUDGET_MAX_SHIFT && (double)(1u << step) < ratio) ++step;
+
+    for (size_t i = 0; i < LOGGER_BUDGET_SITES; ++i) {
+        LoggerBudgetSite* s = &b->sites[i];
+        uint64_t r  = atomic_exchange_explicit(&s->records, 0u, memory_order_relaxed);
+        uint64_t by = atomic_exchange_explicit(&s->bytes, 0u, memory_order_relaxed);
+        unsigned shift = atomic_load_explicit(&s->sample_shift, memory_order_relaxed);
+        if (ratio > 1.0 && active) {
+            bool heavy = (double)r * (double)active > records ||
+                         (double)by * (double)active > bytes;
+            if (heavy && r) {
+                shift += step;
+                if (shift > LOGGER_BUDGET_MAX_SHIFT) shift = LOGGER_BUDGET_MAX_SHIFT;
+            }
+        } else if (ratio < 0.5 && shift) {
+            --shift;
+        }
+        atomic_store_explicit(&s->sample_shift, shift, memory_order_relaxed);
+        if (r == 0 && shift == 0) {
+            uintptr_t k = atomic_load_explicit(&s->key, memory_order_relaxed);
+            if (k) {
+                atomic_compare_exchange_strong_explicit(&s->key, &k, 0u,
+                                                        memory_order_relaxed,
+                                                        memory_order_relaxed);
+            }
+        }
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Post-format accounting of an emitted record. */
+static void budget_account(Logger* lg, LogLevel level, const char* file, int line,
+                           size_t bytes) {
+    LoggerBudget* b = &lg->budget;
+    atomic_fetch_add_explicit(&b->window_records, 1u, memory_order_relaxed);
+    atomic_fetch_add_explicit(&b->window_bytes, bytes, memory_order_relaxed);
+    if (level < LOG_ERROR) {
+        LoggerBudgetSite* s = budget_site(lg, file, line);
+        if (s) {
+            atomic_fetch_add_explicit(&s->records, 1u, memory_order_relaxed);
+            atomic_fetch_add_explicit(&s->bytes, bytes, memory_order_relaxed);
+        }
+    }
+
+    uint64_t now   = mono_ns();
+    uint64_t start = atomic_load_explicit(&b->window_start_ns, memory_order_relaxed);
+    uint64_t win   = (uint64_t)LOGGER_BUDGET_WINDOW_MS * 1000000u;
+    if (start == 0) {
+        atomic_compare_exchange_strong_explicit(&b->window_start_ns, &start, now,
+                                                memory_order_relaxed, memory_order_relaxed);
+    } else if (now - start >= win &&
+               atomic_compare_exchange_strong_explicit(&b->window_start_ns, &start, now,
+                                                       memory_order_relaxed,
+                                                       memory_order_relaxed)) {
+        budget_rebalance(lg, now - start);
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+static FILE* sink_stream(const Logger* lg, LoggerSinkId id) {
+    return id == LOGGER_SINK_STREAM ? lg->stream : lg->file;
+}
+
+// -------------------------------------------------------------------------------- 
+
+static bool flush_wanted(const Logger* lg, LogLevel level) {
+    switch (lg->flush_policy) {
+        case LOGGER_FLUSH_ALWAYS:   return true;
+        case LOGGER_FLUSH_BUFFERED: return false;
+        default:                    return level >= LOG_ERROR;
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Records of one logger_write_batch() call bound for one sink, rendered
+   back to back and written with a single fwrite. */
+typedef struct {
+    lbuf out;
+    bool flush;   /* Some record in the batch asked for a flush */
+} sink_batch;
+
+// -------------------------------------------------------------------------------- 
+
+/* Writes out what the batch holds so far; the flush is left to the caller. */
+static void batch_write(Logger* lg, LoggerSinkId id, sink_batch* sb) {
+    if (!sb->out.len) return;
+    FILE* out = sink_stream(lg, id);
+    size_t written = fwrite(sb->out.p, 1, sb->out.len, out);
+    LoggerStatsStripe* st = stats_stripe(lg);
+    stats_add(&st->bytes[id], written);
+    if (written != sb->out.len) stats_add(&st->write_errors, 1u);
+    sb->out.len = 0;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Renders r at the end of the batch, writing the batch out first if it is
+   full. False if r alone does not fit, so it must be written on its own. */
+static bool batch_add(Logger* lg, LoggerSinkId id, sink_batch* sb, LoggerFormat fmt,
+                      bool colorize, const char* ts, const log_rec* r) {
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        size_t mark = sb->out.len;
+        log_src src = { lg->name, lg->id, lg->layout_gen };
+        render(&sb->out, fmt, colorize, ts, &src, r);
+        if (!sb->out.truncated) return true;
+        sb->out.len = mark;
+        sb->out.truncated = false;
+        if (!mark) break;
+        batch_write(lg, id, sb);
+    }
+    return false;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* sb, when set, collects the record instead of writing it immediately. */
+static void emit_to_sink(Logger* lg, LoggerSinkId id, const char* ts, const log_rec* r,
+                         sink_batch* sb) {
+    LoggerFormat fmt = lg->format[id];
+    bool flush = flush_wanted(lg, r->level);
+    bool colorize = id == LOGGER_SINK_STREAM && fmt == LOGGER_FORMAT_TEXT &&
+                    lg->colors && lg->stream_tty;
+    if (sb) {
+        sb->flush |= flush;
+        flush = false;
+        if (batch_add(lg, id, sb, fmt, colorize, ts, r)) return;
+    }
+    size_t written;
+    bool cut;
+    log_src src = { lg->name, lg->id, lg->layout_gen };
+    bool ok = emit_one(sink_stream(lg, id), fmt, colorize, flush, ts, &src, r, &written, &cut);
+    LoggerStatsStripe* st = stats_stripe(lg);
+    stats_add(&st->bytes[id], written);
+    if (cut && !r->dropped) stats_add(&st->truncated, 1u);  /* else counted once already */
+    if (flush && sink_stream(lg, id)) stats_add(&st->flushes, 1u);
+    if (!ok) stats_add(&st->write_errors, 1u);
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Explicit flush of every open sink (logger_flush, logger_close), counted
+   like the policy-driven ones. */
+static void flush_sinks(Logger* lg) {
+    for (int i = 0; i < LOGGER_SINK_COUNT; ++i) {
+        FILE* f = sink_stream(lg, (LoggerSinkId)i);
+        if (!f) continue;
+        LoggerStatsStripe* st = stats_stripe(lg);
+        stats_add(&st->flushes, 1u);
+        if (fflush(f) != 0) stats_add(&st->write_errors, 1u);
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+static uint64_t fnv1a(uint64_t h, const void* data, size_t n) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < n; ++i) h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* FNV-1a over the call site, formatted text and fields; never returns 0. */
+static uint64_t record_hash(const log_rec* r) {
+    uint64_t h = 1469598103934665603ull;
+    uintptr_t site[4] = { (uintptr_t)r->file, (uintptr_t)r->line,
+                          (uintptr_t)r->level, (uintptr_t)r->category };
+    h = fnv1a(h, site, sizeof(site));
+    const char* p;
+    size_t n;
+    for (msg_iter it = MSG_ITER(r); msg_next(&it, &p, &n);) h = fnv1a(h, p, n);
+    if (r->data) h = fnv1a(h, r->data, r->data_len);
+    for (size_t i = 0; i < r->n_fields; ++i) {
+        const LoggerField* f = &r->fields[i];
+        h = fnv1a(h, &f->key, sizeof(f->key));
+        if (f->type == LKV_T_STR) h = fnv1a(h, f->v.s.p ? f->v.s.p : "", field_str_len(f));
+        else                      h = fnv1a(h, &f->v, sizeof(f->v));
+    }
+    return h ? h : 1u;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Write the pending "repeated" summary for one sink, if any. */
+static void repeat_flush(Logger* lg, LoggerSinkId id, char* ts, size_t ts_len,
+                         sink_batch* sb) {
+    LoggerRepeatState* st = &lg->repeat[id];
+    if (st->repeats == 0 || !sink_stream(lg, id)) return;
+    if (lg->timestamps && !ts[0]) now_iso8601(ts, ts_len);
+    char msg[64];
+    int n = snprintf(msg, sizeof(msg), "last message repeated %llu times",
+                     (unsigned long long)st->repeats);
+    log_rec r = { st->level, st->category, st->file, st->line, st->func,
+                  msg, (size_t)n, NULL, 0, NULL, 0, NULL, 0, 0 };
+    emit_to_sink(lg, id, ts, &r, sb);
+    st->repeats = 0;
+}
+
+// -------------------------------------------------------------------------------- 
+
+static void repeat_flush_all(Logger* lg) {
+    char ts[32] = {0};
+    for (int id = 0; id < LOGGER_SINK_COUNT; ++id) {
+        repeat_flush(lg, (LoggerSinkId)id, ts, sizeof(ts), NULL);
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Summaries whose repeat timeout has passed without another repeat arriving
+   to trigger them. Caller holds the Logger lock. */
+static void repeat_flush_due(Logger* lg) {
+    if (!lg->collapse_repeats || !lg->repeat_timeout_ms) return;
+    uint64_t now = mono_ns();
+    uint64_t timeout_ns = (uint64_t)lg->repeat_timeout_ms * 1000000u;
+    char ts[32] = {0};
+    for (int id = 0; id < LOGGER_SINK_COUNT; ++id) {
+        LoggerRepeatState* st = &lg->repeat[id];
+        if (st->repeats == 0 || now - st->since_ns < timeout_ns) continue;
+        repeat_flush(lg, (LoggerSinkId)id, ts, sizeof(ts), NULL);
+        st->since_ns = now;
+    }
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Takes the Logger lock; only a contended acquisition is timed, so the
+   uncontended path costs one trylock. */
+static void lock_counted(Logger* lg) {
+    if (LOGGER_MUTEX_TRYLOCK(lg->lock)) return;
+    uint64_t t0 = mono_ns();
+    LOGGER_MUTEX_LOCK(lg->lock);
+    stats_add(&stats_stripe(lg)->lock_wait_ns, mono_ns() - t0);
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Pre-format admission shared by every entry point: the level or category
+   verdict first, then the adaptive budget (which counts its own drops). */
+static bool admit(Logger* lg, bool enabled, LogLevel level, const char* file, int line) {
+    if (!enabled) {
+        stats_add(&stats_stripe(lg)->filtered[level_index(level)], 1u);
+        trace_call(lg, level, file, line, LOGGER_TRACE_FILTERED, NULL);
+        return false;
+    }
+    if (!budget_admit(lg, level, file, line)) {
+        trace_call(lg, level, file, line, LOGGER_TRACE_DROPPED, NULL);
+        return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Bookkeeping for a record that passed filtering. A record every sink
+   folded into a repeat run is counted as collapsed instead: it is not
+   emitted, carries its own trace flag and is not charged to the budget. */
+static void note_emitted(Logger* lg, const log_rec* r, bool collapsed) {
+    if (collapsed) {
+        stats_add(&stats_stripe(lg)->collapsed, 1u);
+        trace_call(lg, r->level, r->file, r->line, LOGGER_TRACE_COLLAPSED, r);
+        return;
+    }
+    trace_call(lg, r->level, r->file, r->line, 0u, r);
+    if (budget_enabled(lg)) budget_account(lg, r->level, r->file, r->line, r->msg_len + r->data_len);
+    LoggerStatsStripe* st = stats_stripe(lg);
+    stats_add(&st->emitted[level_index(r->level)], 1u);
+    if (r->dropped) stats_add(&st->truncated, 1u);
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Hands r to every open sink under the Logger lock. With repeat collapsing
+   on, an identical record costs one hash compare per sink and never reaches
+   emit_one. 'ts' is filled on first use and shared by the caller's records;
+   'batch', when set, holds one sink_batch per sink. Returns true when every
+   open sink swallowed r as a repeat. */
+static bool route_record(Logger* lg, const log_rec* r, char ts[32], sink_batch* batch) {
+    uint64_t h   = lg->collapse_repeats ? record_hash(r) : 0;
+    uint64_t now = (h && lg->repeat_timeout_ms) ? mono_ns() : 0;
+    uint64_t timeout_ns = (uint64_t)lg->repeat_timeout_ms * 1000000u;
+    bool collapsed = h != 0;
+
+    for (int i = 0; i < LOGGER_SINK_COUNT; ++i) {
+        LoggerSinkId id = (LoggerSinkId)i;
+        if (!sink_stream(lg, id)) continue;
+        sink_batch* sb = batch ? &batch[id] : NULL;
+        if (h) {
+            LoggerRepeatState* st = &lg->repeat[id];
+            if (st->hash == h) {
+                st->repeats++;
+                if (timeout_ns && now - st->since_ns >= timeout_ns) {
+                    repeat_flush(lg, id, ts, 32, sb);
+                    st->since_ns = now;
+                }
+                continue;
+            }
+            collapsed = false;
+            repeat_flush(lg, id, ts, 32, sb);
+            st->hash = h;
+            st->since_ns = now;
+            st->level = r->level;
+            st->category = r->category;
+            st->file = r->file;
+            st->line = r->line;
+            st->func = r->func;
+        }
+        if (lg->timestamps && !ts[0]) now_iso8601(ts, 32);
+        emit_to_sink(lg, id, ts, r, sb);
+    }
+    return collapsed;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Common emission path once filtering has passed. */
+static void emit_record(Logger* lg, const log_rec* r) {
+    LoggerLatencyHistogram* hist = atomic_load_explicit(&lg->latency, memory_order_acquire);
+    uint64_t t0 = hist ? mono_ns() : 0;
+
+    if (lg->locking) lock_counted(lg);
+    char ts[32] = {0};
+    bool collapsed = route_record(lg, r, ts, NULL);
+    if (lg->locking) LOGGER_MUTEX_UNLOCK(lg->lock);
+
+    if (t0) latency_record(hist, mono_ns() - t0);
+    note_emitted(lg, r, collapsed);
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Emit a plain formatted message (no structured fields). 'dropped' bytes
+   were already cut from it; text past LOGGER_MSG_MAX is cut here. */
+static void emit_msg(Logger* lg, LogLevel level, const char* category,
+                     const char* file, int line, const char* func,
+                     const char* msg, size_t len, size_t dropped) {
+    if (len > LOGGER_MSG_MAX) {
+        dropped += len - LOGGER_MSG_MAX;
+        len = LOGGER_MSG_MAX;
+    }
+    log_rec r = { level, category, file, line, func, msg, len, NULL, 0, NULL, 0, NULL, 0, dropped };
+    emit_record(lg, &r);
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* vsnprintf result clamped to what actually landed in a buffer of size n. */
+static size_t formatted_len(int rc, size_t n) {
+    if (rc < 0) return 0;
+    return (size_t)rc < n ? (size_t)rc : n - 1;
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Formats into 'stack' (LOGGER_MSG_INLINE bytes). A longer message is
+   formatted again into the thread's message arena, using vsnprintf's
+   return value as the size. Returns the buffer that holds the message;
+   *dropped receives the bytes past LOGGER_MSG_MAX (or a failed allocation)
+   that were cut. */
+static char* format_msg(char* stack, const char* fmt, va_list args, size_t* len,
+                        size_t* dropped) {
+    va_list again;
+    va_copy(again, args);
+    int n = vsnprintf(stack, LOGGER_MSG_INLINE, fmt, args);
+    char* out = stack;
+    size_t cap = LOGGER_MSG_INLINE;
+    if (n >= LOGGER_MSG_INLINE) {
+        size_t want = (size_t)n + 1u;
+        if (want > LOGGER_MSG_MAX + 1u) want = LOGGER_MSG_MAX + 1u;
+        char* big = arena_reserve(&tl_msg_arena, want);
+        if (big) {
+            vsnprintf(big, want, fmt, again);
+            out = big;
+            cap = want;
+        }
+    }
+    va_end(again);
+    *len = formatted_len(n, cap);
+    *dropped = n > 0 && (size_t)n > *len ? (size_t)n - *len : 0;
+    return out;
+}
+
+// -------------------------------------------------------------------------------- 
+
+void logger_vlog_impl(Logger* lg,
+                      LogLevel level,
+                      const char* file,
+                      int line,
+                      const char* func,
+                      const char* fmt,
+                      va_list args) {
+    /* Validate inputs for errno discipline */
+    if (!lg || !fmt) {
+        errno = EINVAL;
+        return;
+    }
+
+    /* Not an error: filtered-out messages must not modify errno */
+    if (!admit(lg, level >= lg->level, level, file, line)) return;
+
+    char buf[LOGGER_MSG_INLINE];
+    size_t len, dropped;
+    const char* msg = format_msg(buf, fmt, args, &len, &dropped);
+
+    emit_msg(lg, level, NULL, file, line, func, msg, len, dropped);
+}
+// -------------------------------------------------------------------------------- 
+
+void logger_log_impl(Logger* lg,
+                     LogLevel level,
+                     const char* file,
+                     int line,
+                     const char* func,
+                     const char* fmt, ...) {
+    /* Validate inputs for errno discipline */
+    if (!lg || !fmt) {
+        errno = EINVAL;
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    logger_vlog_impl(lg, level, file, line, func, fmt, args);
+    va_end(args);
+}
+// -------------------------------------------------------------------------------- 
+
+void logger_write(Logger* lg,
+                  LogLevel level,
+                  const char* file,
+                  int line,
+                  const char* func,
+                  const char* msg)
+{
+    if (!lg || !msg) { errno = EINVAL; return; }
+    /* Level filtering identical to logger_vlog_impl */
+    if (!admit(lg, level >= lg->level, level, file, line)) return;
+
+    emit_msg(lg, level, NULL, file, line, func, msg, strlen(msg), 0);
+}
+// -------------------------------------------------------------------------------- 
+
+void logger_write_n(Logger* lg,
+                    LogLevel level,
+                    const char* file,
+                    int line,
+                    const char* func,
+                    const char* msg,
+                    size_t len)
+{
+    if (!lg || (!msg && len)) { errno = EINVAL; return; }
+    if (!admit(lg, level >= lg->level, level, file, line)) return;
+
+    emit_msg(lg, level, NULL, file, line, func, msg ? msg : "", len, 0);
+}
+// -------------------------------------------------------------------------------- 
+
+void logger_log_cat_impl(Logger* lg,
+                         LoggerCategorySite* site,
+                         const char* category,
+                         LogLevel level,
+                         const char* file,
+                         int line,
+                         const char* func,
+                         const char* fmt, ...) {
+    if (!lg || !category || !fmt) {
+        errno = EINVAL;
+        return;
+    }
+
+    LoggerCategorySite once = {0};
+    if (!site) site = &once;
+    if (!admit(lg, logger_category_enabled(lg, site, category, level), level, file, line)) return;
+
+    char buf[LOGGER_MSG_INLINE];
+    size_t len, dropped;
+    va_list args;
+    va_start(args, fmt);
+    const char* msg = format_msg(buf, fmt, args, &len, &dropped);
+    va_end(args);
+
+    emit_msg(lg, level, category, file, line, func, msg, len, dropped);
+}
+// -------------------------------------------------------------------------------- 
+
+void logger_kv_impl(Logger* lg,
+                    LogLevel level,
+                    const LogSite* site,
+                    const char* msg,
+                    const LoggerField* fields,
+                    size_t n_fields) {
+    if (!lg || !msg || (!fields && n_fields)) {
+        errno = EINVAL;
+        return;
+    }
+    static const LogSite unknown = { "?", 0, "?" };
+    if (!site) site = &unknown;
+    if (!admit(lg, level >= lg->level, level, site->file, site->line)) return;
+
+    log_rec r = { level, NULL, site->file, site->line, site->func,
+                  msg, strlen(msg), fields, n_fields, NULL, 0, NULL, 0, 0 };
+    emit_record(lg, &r);
+}
+// -------------------------------------------------------------------------------- 
+
+void logger_writev(Logger* lg,
+                   LogLevel level,
+                   const LogSite* site,
+                   const LoggerFrag* frags,
+                   size_t n_frags) {
+    if (!lg || (!frags && n_frags)) {
+        errno = EINVAL;
+        return;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < n_frags; ++i) {
+        if (!frags[i].p && frags[i].n) {
+            errno = EINVAL;
+            return;
+        }
+        total += frags[i].n;
+    }
+    static const LogSite unknown = { "?", 0, "?" };
+    if (!site) site = &unknown;
+    if (!admit(lg, level >= lg->level, level, site->file, site->line)) return;
+
+    size_t dropped = total > LOGGER_MSG_MAX ? total - LOGGER_MSG_MAX : 0;
+    log_rec r = { level, NULL, site->file, site->line, site->func,
+                  "", total - dropped, NULL, 0, frags, n_frags, NULL, 0, dropped };
+    emit_record(lg, &r);
+}
+// -------------------------------------------------------------------------------- 
+
+void logger_hexdump(Logger* lg, LogLevel level, const LogSite* site, const void* p, size_t n) {
+    if (!lg || (!p && n)) {
+        errno = EINVAL;
+        return;
+    }
+    static const LogSite unknown = { "?", 0, "?" };
+    if (!site) site = &unknown;
+    if (!admit(lg, level >= lg->level, level, site->file, site->line)) return;
+
+    char msg[48];
+    int len = snprintf(msg, sizeof(msg), "hexdump %llu bytes", (unsigned long long)n);
+    log_rec r = { level, NULL, site->file, site->line, site->func,
+                  msg, formatted_len(len, sizeof(msg)), NULL, 0, NULL, 0,
+                  p ? (const unsigned char*)p : (const unsigned char*)"", n, 0 };
+    emit_record(lg, &r);
+}
+// -------------------------------------------------------------------------------- 
+
+void logger_write_batch(Logger* lg, const LogRecord* recs, size_t n) {
+    if (!lg || (!recs && n)) {
+        errno = EINVAL;
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if ((!recs[i].msg && recs[i].len) || (!recs[i].fields && recs[i].n_fields)) {
+            errno = EINVAL;
+            return;
+        }
+    }
+    static const LogSite unknown = { "?", 0, "?" };
+    LoggerLatencyHistogram* hist = atomic_load_explicit(&lg->latency, memory_order_acquire);
+    uint64_t t0 = hist ? mono_ns() : 0;
+
+    /* Without the per-thread buffers the records are still written under
+       one lock, just one fwrite each. */
+    sink_batch batch[LOGGER_SINK_COUNT];
+    sink_batch* sb = batch;
+    for (int i = 0; i < LOGGER_SINK_COUNT; ++i) {
+        char* p = arena_reserve(&tl_batch_arena[i], LOGGER_BATCH_BYTES);
+        if (!p) sb = NULL;
+        batch[i] = (sink_batch){ { p, 0, LOGGER_BATCH_BYTES, false }, false };
+    }
+
+    if (lg->locking) lock_counted(lg);
+    char ts[32] = {0};
+    for (size_t i = 0; i < n; ++i) {
+        const LogRecord* in = &recs[i];
+        const LogSite* site = in->site ? in->site : &unknown;
+        if (!admit(lg, in->level >= lg->level, in->level, site->file, site->line)) continue;
+        const char* msg = in->msg ? in->msg : "";
+        log_rec r = { in->level, NULL, site->file, site->line, site->func,
+                      msg, in->len == (size_t)-1 ? strlen(msg) : in->len,
+                      in->fields, in->n_fields, NULL, 0, NULL, 0, 0 };
+        note_emitted(lg, &r, route_record(lg, &r, ts, sb));
+    }
+    for (int i = 0; sb && i < LOGGER_SINK_COUNT; ++i) {
+        LoggerSinkId id = (LoggerSinkId)i;
+        if (!sink_stream(lg, id)) continue;
+        batch_write(lg, id, &batch[i]);
+        if (!batch[i].flush) continue;
+        LoggerStatsStripe* st = stats_stripe(lg);
+        stats_add(&st->flushes, 1u);
+        if (fflush(sink_stream(lg, id)) != 0) stats_add(&st->write_errors, 1u);
+    }
+    if (lg->locking) LOGGER_MUTEX_UNLOCK(lg->lock);
+
+    if (t0) latency_record(hist, mono_ns() - t0);
+}
+// -------------------------------------------------------------------------------- 
+
+/* The text lives in the opening thread's arena, whose address identifies
+   that thread while the record is open. */
+static bool rec_owned(const LoggerRecord* rec) {
+    return rec->owner == (const void*)&tl_rec_arena;
+}
+// -------------------------------------------------------------------------------- 
+
+bool logger_record_begin(Logger* lg, LoggerRecord* rec, LogLevel level, const LogSite* site) {
+    if (!lg || !rec) {
+        errno = EINVAL;
+        return false;
+    }
+    if (tl_rec_open) {
+        errno = EBUSY;
+        return false;
+    }
+    static const LogSite unknown = { "?", 0, "?" };
+    *rec = (LoggerRecord){ lg, level, site ? *site : unknown, 0, 0, &tl_rec_arena, false, false };
+    if (!admit(lg, level >= lg->level, level, rec->site.file, rec->site.line)) return false;
+    if (!arena_reserve(&tl_rec_arena, LOGGER_LINE_MAX)) {
+        errno = ENOMEM;
+        return false;
+    }
+    rec->open = true;
+    tl_rec_open = true;
+    return true;
+}
+// -------------------------------------------------------------------------------- 
+
+bool logger_record_append(LoggerRecord* rec, const char* fmt, ...) {
+    if (!rec || !fmt) {
+        errno = EINVAL;
+        return false;
+    }
+    if (!rec->open) return false;
+    if (!rec_owned(rec)) {
+        errno = EINVAL;
+        return false;
+    }
+    va_list args, again;
+    va_start(args, fmt);
+    if (rec->truncated) {
+        /* Full: only count what the marker will report. */
+        int n = vsnprintf(NULL, 0, fmt, args);
+        va_end(args);
+        if (n > 0) rec->dropped += (size_t)n;
+        return false;
+    }
+
+    /* The text stops a line short of the record limit so the rendered
+       record, prefix included, still fits. */
+    const size_t limit = LOGGER_MSG_MAX;
+    va_copy(again, args);
+    size_t room = (tl_rec_arena.cap < limit ? tl_rec_arena.cap : limit) - rec->len;
+    int n = vsnprintf(tl_rec_arena.p + rec->len, room, fmt, args);
+    if (n >= 0 && (size_t)n >= room && tl_rec_arena.cap < limit) {
+        /* Grow to fit and format again; the buffer keeps what is there. */
+        size_t want = rec->len + (size_t)n + 1u;
+        if (want > limit) want = limit;
+        if (arena_reserve(&tl_rec_arena, want)) {
+            room = want - rec->len;
+            vsnprintf(tl_rec_arena.p + rec->len, room, fmt, again);
+        }
+    }
+    va_end(again);
+    va_end(args);
+
+    size_t got = formatted_len(n, room);
+    rec->len += got;
+    if (n < 0 || got < (size_t)n) {
+        rec->truncated = true;
+        if (n > 0) rec->dropped += (size_t)n - got;
+    }
+    return !rec->truncated;
+}
+// -------------------------------------------------------------------------------- 
+
+void logger_record_commit(LoggerRecord* rec) {
+    if (!rec) {
+        errno = EINVAL;
+        return;
+    }
+    if (!rec->open) return;
+    if (!rec_owned(rec)) {
+        errno = EINVAL;
+        return;
+    }
+    rec->open = false;
+    log_rec r = { rec->level, NULL, rec->site.file, rec->site.line, rec->site.func,
+                  tl_rec_arena.p, rec->len, NULL, 0, NULL, 0, NULL, 0, rec->dropped };
+    emit_record(rec->lg, &r);
+    tl_rec_open = false;
+}
+// -------------------------------------------------------------------------------- 
+
+void logger_record_abort(LoggerRecord* rec) {
+    if (!rec) {
+        errno = EINVAL;
+        return;
+    }
+    if (!rec->open) return;
+    if (!rec_owned(rec)) {
+        errno = EINVAL;
+        return;
+    }
+    rec->open = false;
+    tl_rec_open = false;
+}
+// -------------------------------------------------------------------------------- 
+
+bool logger_ratelimit_allow(LoggerRateLimit* rl, double per_sec, unsigned burst,
+                            uint64_t* suppressed) {
+    if (!rl || !(per_sec > 0.0)) {
+        errno = EINVAL;
+        return false;
+    }
+    if (burst == 0) burst = 1;
+    /* Clamp absurdly slow rates so that the bucket arithmetic cannot overflow. */
+    double iv = 1e9 / per_sec;
+    if (iv * (double)burst > 9e18) iv = 9e18 / (double)burst;
+    uint64_t interval  = (uint64_t)iv;
+    uint64_t tolerance = interval * (uint64_t)(burst - 1u);
+    uint64_t now = mono_ns();
+    uint64_t tat = atomic_load_explicit(&rl->tat, memory_order_relaxed);
+    for (;;) {
+        uint64_t base = tat > now ? tat : now;
+        if (base - now > tolerance) {
+            atomic_fetch_add_explicit(&rl->suppressed, 1u, memory_order_relaxed);
+            return false;
+        }
+        if (atomic_compare_exchange_weak_explicit(&rl->tat, &tat, base + interval,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            break;
+        }
+    }
+    uint64_t sup = atomic_exchange_explicit(&rl->suppressed, 0u, memory_order_relaxed);
+    if (suppressed) *suppressed = sup;
+    return true;
+}
+// -------------------------------------------------------------------------------- 
+
+bool logger_every_n_allow(LoggerRateLimit* rl, uint64_t n, uint64_t* suppressed) {
+    if (!rl) {
+        errno = EINVAL;
+        return false;
+    }
+    uint64_t c = atomic_fetch_add_explicit(&rl->count, 1u, memory_order_relaxed);
+    if (n > 1 && c % n != 0) {
+        atomic_fetch_add_explicit(&rl->suppressed, 1u, memory_order_relaxed);
+        return false;
+    }
+    uint64_t sup = atomic_exchange_explicit(&rl->suppressed, 0u, memory_order_relaxed);
+    if (suppressed) *suppressed = sup;
+    return true;
+}
+// -------------------------------------------------------------------------------- 
+
+void logger_ratelimit_restore(LoggerRateLimit* rl, uint64_t suppressed) {
+    if (!rl) {
+        errno = EINVAL;
+        return;
+    }
+    if (suppressed) atomic_fetch_add_explicit(&rl->suppressed, suppressed, memory_order_relaxed);
+}
+// -------------------------------------------------------------------------------- 
+
+/* ---- Sampling -------------------------------------------------------------------- */
+
+static LOGGER_THREAD_LOCAL uint64_t tl_rng_state;
+static atomic_uint_least64_t g_rng_seed_counter;
+
+/* SplitMix64: seeds the per-thread generator and mixes caller keys. */
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// -------------------------------------------------------------------------------- 
+
+/* Map the top 53 bits of a 64-bit draw to [0, 1) and compare. */
+static bool sample_hit(double p, uint64_t draw) {
+    if (!(p > 0.0)) return false;
+    if (p >= 1.0) return true;
+    return (double)(draw >> 11) * (1.0 / 9007199254740992.0) < p;
+}
+
+// -------------------------------------------------------------------------------- 
+
+bool logger_sample(double p) {
+    uint64_t x = tl_rng_state;
+    if (x == 0) {
+        uint64_t c = atomic_fetch_add_explicit(&g_rng_seed_counter, 1u, memory_order_relaxed);
+        x = splitmix64(mono_ns() ^ (uint64_t)(uintptr_t)&tl_rng_state ^ (c << 32));
+        if (x == 0) x = 1;
+    }
+    /* xorshift64* */
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    tl_rng_state = x;
+    return sample_hit(p, x * 0x2545F4914F6CDD1Dull);
+}
+
+// -------------------------------------------------------------------------------- 
+
+bool logger_sample_keyed(double p, uint64_t key) {
+    return sample_hit(p, splitmix64(key));
+}
+// -------------------------------------------------------------------------------- 
+
+bool logger_log_suppressed_impl(Logger* lg,
+                                LogLevel level,
+                                uint64_t suppressed,
+                                const char* file,
+                                int line,
+                                const char* func,
+                                const char* fmt, ...) {
+    if (!lg || !fmt) {
+        errno = EINVAL;
+        return false;
+    }
+    if (!admit(lg, level >= lg->level, level, file, line)) return false;
+
+    char buf[LOGGER_MSG_INLINE];
+    size_t used, dropped;
+    va_list args;
+    va_start(args, fmt);
+    char* msg = format_msg(buf, fmt, args, &used, &dropped);
+    va_end(args);
+
+    if (suppressed) {
+        char tail[48];
+        int m = snprintf(tail, sizeof(tail), " (suppressed %llu similar)",
+                         (unsigned long long)suppressed);
+        size_t tlen = formatted_len(m, sizeof(tail));
+        size_t cap = msg == buf ? sizeof(buf) : tl_msg_arena.cap;
+        if (used + tlen >= cap) {
+            char* grown = arena_reserve(&tl_msg_arena, used + tlen + 1u);
+            if (grown) {
+                if (msg == buf) memcpy(grown, buf, used);
+                msg = grown;
+                cap = tl_msg_arena.cap;
+            }
+        }
+        if (tlen > cap - 1u - used) tlen = cap - 1u - used;
+        memcpy(msg + used, tail, tlen);
+        used += tlen;
+    }
+
+    emit_msg(lg, level, NULL, file, line, func, msg, used, dropped);
+    return true;
 }
 // ================================================================================
 // ================================================================================
@@ -0,0 +1,308 @@
+// ================================================================================
+// ================================================================================
+// - File:    test_alloc.c
+// - Purpose: Verify the logging hot path never touches the heap. This program
+//            replaces malloc/calloc/realloc/free, so it is built as its own
+//            test executable rather than linked into unit_tests.
+//
+// Source Metadata
+// - Author:  Jonathan A. Webb
+// - Date:    August 31, 2022
+// - Version: 1.0
+// - Copyright: Copyright 2022, Jon Webb Inc.
+// ================================================================================
+// ================================================================================
+// Include modules here
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <cmocka.h>
+
+#include "logger.h"
+// ================================================================================
+// ================================================================================
+
+/* Calls per logging mode. */
+#define ALLOC_TEST_CALLS 1000000u
+
+/* glibc exports its allocator under these names; forwarding to them avoids
+   the dlsym() bootstrap problem of a classic RTLD_NEXT interposer. */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* p, size_t size);
+extern void  __libc_free(void* p);
+
+static atomic_bool     g_armed;
+static atomic_ulong    g_allocs;
+static atomic_ulong    g_alloc_bytes;
+
+// --------------------------------------------------------------------------------
+
+static void note_alloc(size_t size) {
+    if (atomic_load_explicit(&g_armed, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&g_allocs, 1u, memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_alloc_bytes, size, memory_order_relaxed);
+    }
+}
+
+// --------------------------------------------------------------------------------
+
+void* malloc(size_t size) {
+    note_alloc(size);
+    return __libc_malloc(size);
+}
+
+// --------------------------------------------------------------------------------
+
+void* calloc(size_t n, size_t size) {
+    note_alloc(n * size);
+    return __libc_calloc(n, size);
+}
+
+// --------------------------------------------------------------------------------
+
+void* realloc(void* p, size_t size) {
+    note_alloc(size);
+    return __libc_realloc(p, size);
+}
+
+// --------------------------------------------------------------------------------
+
+void free(void* p) {
+    __libc_free(p);
+}
+
+// --------------------------------------------------------------------------------
+
+static void arm(void) {
+    atomic_store(&g_allocs, 0u);
+    atomic_store(&g_alloc_bytes, 0u);
+    atomic_store(&g_armed, true);
+}
+
+// --------------------------------------------------------------------------------
+
+static unsigned long disarm(void) {
+    atomic_store(&g_armed, false);
+    return atomic_load(&g_allocs);
+}
+// ================================================================================
+// ================================================================================
+// TEST HEAP-FREE LOGGING
+
+static char g_file_buf[1 << 16];
+static char g_stream_buf[1 << 12];
+
+/* Logger writing to the null device through caller-owned buffers. The first
+   record is written before counting starts so one-time lazy setup (timezone
+   data, per-thread caches) is excluded. */
+static void open_null_logger(Logger* lg) {
+    assert_true(logger_init_file_buffered(lg, "/dev/null", LOG_DEBUG,
+                                          g_file_buf, sizeof(g_file_buf)));
+    logger_enable_colors(lg, false);
+    LOG_INFO(lg, "warm up %d", 0);
+}
+
+// --------------------------------------------------------------------------------
+
+/* Entry points exercised by run_calls(). */
+enum {
+    CALL_PRINTF, CALL_KV, CALL_CAT, CALL_WRITE, CALL_FILTERED, CALL_WRITE_N, CALL_WRITEV,
+    CALL_BATCH, CALL_RECORD, CALL_HEXDUMP, CALL_RATELIMITED, CALL_EVERY_N, CALL_SAMPLED,
+    CALL_KINDS
+};
+
+static void one_call(Logger* lg, int variant, unsigned i) {
+    static const char* const words[] = { "alpha", "beta gamma", "quote\"d", "tab\there" };
+    static const LogSite site = { __FILE__, __LINE__, "one_call" };
+    switch (variant) {
+    case CALL_PRINTF:
+        LOG_INFO(lg, "request %u done in %.3f ms (%s)", i, (double)i * 0.001, words[i & 3u]);
+        break;
+    case CALL_KV:
+        LOG_KV(lg, LOG_WARNING, "request done", LKV_UINT("n", i), LKV_STR("w", words[i & 3u]),
+               LKV_F64("ms", (double)i * 0.001), LKV_BOOL("ok", (i & 1u) != 0));
+        break;
+    case CALL_CAT:
+        LOG_CAT_INFO(lg, "net.http", "cat %u", i);
+        break;
+    case CALL_WRITE:
+        logger_write(lg, LOG_ERROR, __FILE__, __LINE__, __func__, words[i & 3u]);
+        break;
+    case CALL_WRITE_N:
+        logger_write_n(lg, LOG_INFO, __FILE__, __LINE__, __func__, words[i & 3u], 4u);
+        break;
+    case CALL_WRITEV: {
+        LoggerFrag frags[3] = { LFRAG_LIT("req "), LFRAG(words[i & 3u], strlen(words[i & 3u])),
+                                LFRAG_LIT(" done") };
+        logger_writev(lg, LOG_INFO, &site, frags, 3u);
+        break;
+    }
+    case CALL_BATCH: {
+        LoggerField f = LKV_UINT("n", i);
+        LogRecord recs[4] = {
+            { LOG_INFO, &site, words[0], (size_t)-1, NULL, 0 },
+            { LOG_DEBUG, &site, words[1], (size_t)-1, NULL, 0 },
+            { LOG_WARNING, &site, words[2], 3u, &f, 1 },
+            { LOG_ERROR, NULL, words[3], (size_t)-1, NULL, 0 },
+        };
+        logger_write_batch(lg, recs, 4u);
+        break;
+    }
+    case CALL_RECORD: {
+        LoggerRecord rec;
+        if (logger_record_begin(lg, &rec, LOG_INFO, &site)) {
+            logger_record_append(&rec, "step %u", i);
+            logger_record_append(&rec, " %s", words[i & 3u]);
+            logger_record_commit(&rec);
+        }
+        break;
+    }
+    case CALL_HEXDUMP: {
+        unsigned char payload[40];
+        memset(payload, (int)(i & 0xFFu), sizeof(payload));
+        logger_hexdump(lg, LOG_INFO, &site, payload, sizeof(payload));
+        break;
+    }
+    case CALL_RATELIMITED:
+        LOG_RATELIMITED(lg, LOG_WARNING, 1000.0, 10u, "limited %u", i);
+        break;
+    case CALL_EVERY_N:
+        LOG_EVERY_N(lg, LOG_INFO, 16u, "every %u", i);
+        break;
+    case CALL_SAMPLED:
+        LOG_SAMPLED(lg, LOG_INFO, 0.5, "sampled %u", i);
+        break;
+    default:
+        LOG_DEBUG(lg, "filtered %u", i);  /* below level once raised */
+        break;
+    }
+}
+
+/* One call first, uncounted: a thread's message, line, batch and record
+   buffers are reserved on first use and reused afterwards, so the check is
+   for the steady state. */
+static void run_calls(Logger* lg, int variant) {
+    one_call(lg, variant, 0u);
+    arm();
+    for (unsigned i = 0; i < ALLOC_TEST_CALLS; ++i) one_call(lg, variant, i);
+    assert_int_equal(disarm(), 0);
+}
+
+// --------------------------------------------------------------------------------
+
+void alloc_free_every_format(void **state) {
+    (void)state;
+    for (int f = 0; f < LOGGER_FORMAT_COUNT; ++f) {
+        Logger lg;
+        open_null_logger(&lg);
+        assert_true(logger_set_format(&lg, LOGGER_SINK_FILE, (LoggerFormat)f));
+        run_calls(&lg, f % 4);  /* CALL_PRINTF .. CALL_WRITE */
+        logger_close(&lg);
+    }
+}
+
+// --------------------------------------------------------------------------------
+
+void alloc_free_features(void **state) {
+    (void)state;
+    Logger lg;
+    open_null_logger(&lg);
+    logger_enable_timestamps(&lg, false);
+    run_calls(&lg, CALL_PRINTF);
+
+    logger_enable_timestamps(&lg, true);
+    static LoggerLatencyHistogram hist;
+    logger_enable_latency_histogram(&lg, &hist);
+    logger_set_budget(&lg, 1000u, 0u);
+    run_calls(&lg, CALL_KV);
+
+    logger_enable_repeat_collapse(&lg, true);
+    run_calls(&lg, CALL_WRITE);
+
+    logger_set_level(&lg, LOG_INFO);
+    run_calls(&lg, CALL_FILTERED);
+    logger_close(&lg);
+}
+
+// --------------------------------------------------------------------------------
+
+/* The remaining entry points, each in a different format. */
+void alloc_free_entry_points(void **state) {
+    (void)state;
+    for (int v = CALL_WRITE_N; v < CALL_KINDS; ++v) {
+        Logger lg;
+        open_null_logger(&lg);
+        assert_true(logger_set_format(&lg, LOGGER_SINK_FILE, (LoggerFormat)(v % LOGGER_FORMAT_COUNT)));
+        run_calls(&lg, v);
+        logger_close(&lg);
+    }
+}
+
+// --------------------------------------------------------------------------------
+
+void alloc_free_dual_sink(void **state) {
+    (void)state;
+    FILE* tmp = tmpfile();
+    assert_non_null(tmp);
+    assert_int_equal(setvbuf(tmp, g_stream_buf, _IOFBF, sizeof(g_stream_buf)), 0);
+    Logger lg;
+    assert_true(logger_init_dual(&lg, "/dev/null", tmp, LOG_DEBUG));
+    /* Caller storage for the file's stdio buffer too (before any I/O on it). */
+    assert_int_equal(setvbuf(lg.file, g_file_buf, _IOFBF, sizeof(g_file_buf)), 0);
+    logger_enable_colors(&lg, false);
+    run_calls(&lg, CALL_CAT);
+    logger_close(&lg);
+    fclose(tmp);
+}
+
+// --------------------------------------------------------------------------------
+
+void alloc_init_uses_caller_buffer(void **state) {
+    (void)state;
+    Logger lg;
+
+    arm();
+    assert_true(logger_init_file(&lg, "/dev/null", LOG_INFO));
+    LOG_INFO(&lg, "x %d", 1);
+    logger_close(&lg);
+    unsigned long plain = disarm();
+
+    arm();
+    assert_true(logger_init_file_buffered(&lg, "/dev/null", LOG_INFO,
+                                          g_file_buf, sizeof(g_file_buf)));
+    LOG_INFO(&lg, "x %d", 1);
+    logger_close(&lg);
+    unsigned long buffered = disarm();
+    /* stdio's buffer is gone; only the FILE object from fopen() remains. */
+    assert_int_equal(buffered + 1u, plain);
+}
+// ================================================================================
+// ================================================================================
+
+const struct CMUnitTest test_alloc[] = {
+    cmocka_unit_test(alloc_free_every_format),
+    cmocka_unit_test(alloc_free_features),
+    cmocka_unit_test(alloc_free_entry_points),
+    cmocka_unit_test(alloc_free_dual_sink),
+    cmocka_unit_test(alloc_init_uses_caller_buffer),
+};
+// ================================================================================
+// ================================================================================
+
+int main(void) {
+    tzset();
+    return cmocka_run_group_tests(test_alloc, NULL, NULL);
+}
+// ================================================================================
+// ================================================================================
+// eof
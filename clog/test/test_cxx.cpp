@@ -0,0 +1,78 @@
+// ================================================================================
+// ================================================================================
+// - File:    test_cxx.cpp
+// - Purpose: Compile logger.h as C++ and drive the common entry points, so the
+//            public header stays usable from C++ translation units.
+//
+// Source Metadata
+// - Author:  Jonathan A. Webb
+// - Date:    August 31, 2022
+// - Version: 1.0
+// - Copyright: Copyright 2022, Jon Webb Inc.
+// ================================================================================
+// ================================================================================
+// Include modules here
+
+#include <cstdio>
+#include <cstring>
+
+#include "logger.h"
+// ================================================================================
+// ================================================================================
+
+static int failures = 0;
+
+#define CHECK(cond)                                                       \
+    do {                                                                  \
+        if (!(cond)) {                                                    \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n",             \
+                         __FILE__, __LINE__, #cond);                      \
+            ++failures;                                                   \
+        }                                                                 \
+    } while (0)
+
+// --------------------------------------------------------------------------------
+
+int main() {
+    std::FILE* f = std::tmpfile();
+    CHECK(f != nullptr);
+    if (!f) return 1;
+
+    static Logger lg;
+    CHECK(logger_init_stream(&lg, f, LOG_DEBUG));
+
+    LOG_INFO(&lg, "plain %d", 1);
+    LOG_CAT_WARNING(&lg, "net.http", "category %s", "ok");
+    LOG_EVERY_N(&lg, LOG_INFO, 1, "every %d", 2);
+
+    const LogSite site = { __FILE__, __LINE__, __func__ };
+    const unsigned char bytes[4] = { 0xde, 0xad, 0xbe, 0xef };
+    logger_hexdump(&lg, LOG_DEBUG, &site, bytes, sizeof bytes);
+
+    LoggerRecord rec;
+    CHECK(logger_record_begin(&lg, &rec, LOG_INFO, &site));
+    logger_record_append(&rec, "streamed %s", "record");
+    logger_record_commit(&rec);
+
+    LoggerStats st;
+    logger_get_stats(&lg, &st);
+    logger_close(&lg);
+
+    char buf[1024];
+    std::rewind(f);
+    const size_t n = std::fread(buf, 1, sizeof buf - 1, f);
+    buf[n] = '\0';
+    std::fclose(f);
+
+    CHECK(std::strstr(buf, "plain 1") != nullptr);
+    CHECK(std::strstr(buf, "category ok") != nullptr);
+    CHECK(std::strstr(buf, "every 2") != nullptr);
+    CHECK(std::strstr(buf, "de ad be ef") != nullptr);
+    CHECK(std::strstr(buf, "streamed record") != nullptr);
+
+    if (failures == 0) std::puts("logger.h C++ check passed");
+    return failures == 0 ? 0 : 1;
+}
+// ================================================================================
+// ================================================================================
+// eof
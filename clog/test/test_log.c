@@ -27,6 +27,7 @@
   #include <unistd.h>
   #include <sys/types.h>
   #include <sys/select.h>
+  #include <pthread.h>
   #if defined(__APPLE__)
     #include <util.h>   /* openpty on macOS/BSD */
   #else
@@ -127,6 +128,22 @@ void init_file_open_fail_bad_parent(void **state) {
 }
 // -------------------------------------------------------------------------------- 
 
+void init_file_buffered_bad_args(void **state) {
+    (void)state;
+    Logger lg;
+    static char buf[256];
+    set_errno_sentinel();
+    assert_false(logger_init_file_buffered(NULL, "app.log", LOG_INFO, buf, sizeof(buf)));
+    assert_int_equal(errno, EINVAL);
+    set_errno_sentinel();
+    assert_false(logger_init_file_buffered(&lg, NULL, LOG_INFO, buf, sizeof(buf)));
+    assert_int_equal(errno, EINVAL);
+    set_errno_sentinel();
+    assert_false(logger_init_file_buffered(&lg, "app.log", LOG_INFO, buf, 0));
+    assert_int_equal(errno, EINVAL);
+}
+// -------------------------------------------------------------------------------- 
+
 void init_dual_null_logger(void **state) {
     (void)state;
     set_errno_sentinel();
@@ -900,6 +917,2559 @@ void write_name_toggle(void **state) {
     logger_close(&lg);
     fclose(sink);
 }
+// -------------------------------------------------------------------------------- 
+
+void write_n_uses_exact_length(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    /* A slice with no terminator after it: only the first 5 bytes count. */
+    const char packet[] = { 'h', 'e', 'l', 'l', 'o', 'X', 'Y', 'Z' };
+    logger_write_n(&lg, LOG_INFO, "n.c", 7, "f", packet, 5);
+    logger_write_n(&lg, LOG_INFO, "n.c", 8, "f", NULL, 0);
+
+    logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_JSON);
+    const char nul[] = { 'a', '\0', 'b' };
+    logger_write_n(&lg, LOG_INFO, "n.c", 9, "f", nul, sizeof(nul));
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 3);
+    assert_non_null(strstr(buf, "n.c:7:f: hello\n"));
+    assert_null(strstr(buf, "helloX"));
+    assert_non_null(strstr(buf, "n.c:8:f: \n"));
+    assert_non_null(strstr(buf, "\"msg\":\"a\\u0000b\""));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void write_n_errno_null_args(void **state) {
+    (void)state;
+    Logger lg;
+    FILE* sink = make_temp_stream();
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+
+    errno = 0;
+    logger_write_n(NULL, LOG_INFO, "f.c", 1, "fn", "x", 1);
+    assert_int_equal(errno, EINVAL);
+    errno = 0;
+    logger_write_n(&lg, LOG_INFO, "f.c", 1, "fn", NULL, 3);
+    assert_int_equal(errno, EINVAL);
+
+    logger_close(&lg);
+    fclose(sink);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST CATEGORIES 
+
+void category_inherits_from_ancestor(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_WARNING));
+
+    /* Unconfigured categories follow the root level */
+    assert_int_equal(logger_category_level(&lg, "net.http.client"), LOG_WARNING);
+
+    assert_true(logger_set_category_level(&lg, "net", LOG_ERROR));
+    assert_true(logger_set_category_level(&lg, "net.http", LOG_DEBUG));
+    assert_int_equal(logger_category_level(&lg, "net.http.client"), LOG_DEBUG);
+    assert_int_equal(logger_category_level(&lg, "net.dns"), LOG_ERROR);
+    /* "net.httpd" is not a child of "net.http" */
+    assert_int_equal(logger_category_level(&lg, "net.httpd"), LOG_ERROR);
+    assert_int_equal(logger_category_level(&lg, "db"), LOG_WARNING);
+
+    /* Dropping the explicit level falls back to the next ancestor */
+    assert_true(logger_set_category_level(&lg, "net.http", LOGGER_LEVEL_INHERIT));
+    assert_int_equal(logger_category_level(&lg, "net.http.client"), LOG_ERROR);
+
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+static void category_probe(Logger* lg, LogLevel level, const char* msg) {
+    LOG_CAT(lg, level, "net.http.client", "%s", msg);
+}
+
+void category_macro_filters_and_tags(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_WARNING));
+    logger_enable_timestamps(&lg, false);
+
+    category_probe(&lg, LOG_DEBUG, "cat-hidden");      /* resolves site; filtered */
+    assert_true(logger_set_category_level(&lg, "net.http", LOG_DEBUG));
+    category_probe(&lg, LOG_DEBUG, "cat-visible");     /* cached site sees change */
+    assert_true(logger_set_category_level(&lg, "net", LOG_CRITICAL));
+    category_probe(&lg, LOG_INFO, "cat-still-visible"); /* closer ancestor wins */
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 2);
+    assert_null(strstr(buf, "cat-hidden"));
+    assert_non_null(strstr(buf, "cat-visible"));
+    assert_non_null(strstr(buf, "cat-still-visible"));
+    assert_non_null(strstr(buf, "(net.http.client)"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void category_follows_root_level(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_ERROR));
+    logger_enable_timestamps(&lg, false);
+
+    category_probe(&lg, LOG_INFO, "root-hidden");
+    logger_set_level(&lg, LOG_INFO);  /* republishes inherited slots */
+    category_probe(&lg, LOG_INFO, "root-visible");
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 1);
+    assert_non_null(strstr(buf, "root-visible"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void category_errno_null_args(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+
+    errno = 0;
+    assert_false(logger_set_category_level(NULL, "a", LOG_INFO));
+    assert_int_equal(errno, EINVAL);
+
+    errno = 0;
+    assert_false(logger_set_category_level(&lg, NULL, LOG_INFO));
+    assert_int_equal(errno, EINVAL);
+
+    errno = 0;
+    logger_log_cat_impl(&lg, NULL, NULL, LOG_INFO, "c.c", 1, "f", "msg");
+    assert_int_equal(errno, EINVAL);
+
+    /* Table exhaustion reports ENOSPC */
+    static char names[LOGGER_MAX_CATEGORIES + 1][16];
+    for (int i = 0; i < LOGGER_MAX_CATEGORIES; ++i) {
+        snprintf(names[i], sizeof(names[i]), "c%d", i);
+        assert_true(logger_set_category_level(&lg, names[i], LOG_INFO));
+    }
+    snprintf(names[LOGGER_MAX_CATEGORIES], sizeof(names[0]), "overflow");
+    errno = 0;
+    assert_false(logger_set_category_level(&lg, names[LOGGER_MAX_CATEGORIES], LOG_INFO));
+    assert_int_equal(errno, ENOSPC);
+
+    logger_close(&lg);
+    fclose(sink);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST RATE LIMITING 
+
+static void every_n_probe(Logger* lg, int i) {
+    LOG_WARNING_EVERY_N(lg, 3, "every-n %d", i);
+}
+
+void every_n_emits_period_and_count(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    for (int i = 0; i < 7; ++i) every_n_probe(&lg, i);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 3);   /* calls 0, 3, 6 */
+    assert_non_null(strstr(buf, "every-n 0\n"));
+    assert_non_null(strstr(buf, "every-n 3 (suppressed 2 similar)"));
+    assert_non_null(strstr(buf, "every-n 6 (suppressed 2 similar)"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+static void ratelimit_probe(Logger* lg, LogLevel level, int i) {
+    /* One token per ~11 days: only the initial burst gets through. */
+    LOG_RATELIMITED(lg, level, 1e-6, 2, "rl %d", i);
+}
+
+void ratelimit_allows_burst_then_drops(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_INFO));
+    logger_enable_timestamps(&lg, false);
+
+    /* Filtered calls must not consume tokens */
+    for (int i = 0; i < 5; ++i) ratelimit_probe(&lg, LOG_DEBUG, i);
+    for (int i = 0; i < 5; ++i) ratelimit_probe(&lg, LOG_ERROR, i);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 2);
+    assert_non_null(strstr(buf, "rl 0"));
+    assert_non_null(strstr(buf, "rl 1"));
+    assert_null(strstr(buf, "rl 2"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void ratelimit_reports_suppressed(void **state) {
+    (void)state;
+    LoggerRateLimit rl = {0};
+    uint64_t sup = 99;
+
+    assert_true(logger_ratelimit_allow(&rl, 1e-6, 1, &sup));
+    assert_int_equal(sup, 0);
+    for (int i = 0; i < 10; ++i) assert_false(logger_ratelimit_allow(&rl, 1e-6, 1, NULL));
+    assert_int_equal(atomic_load(&rl.suppressed), 10);
+
+    /* Refill by rewinding the bucket; the next emission carries the count */
+    atomic_store(&rl.tat, 0);
+    assert_true(logger_ratelimit_allow(&rl, 1e-6, 1, &sup));
+    assert_int_equal(sup, 10);
+    assert_int_equal(atomic_load(&rl.suppressed), 0);
+
+    errno = 0;
+    assert_false(logger_ratelimit_allow(NULL, 1.0, 1, NULL));
+    assert_int_equal(errno, EINVAL);
+    errno = 0;
+    assert_false(logger_ratelimit_allow(&rl, 0.0, 1, NULL));
+    assert_int_equal(errno, EINVAL);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST REPEAT COLLAPSING 
+
+static void repeat_probe(Logger* lg, const char* msg) {
+    LOG_WARNING(lg, "%s", msg);
+}
+
+void repeat_collapse_summarizes_run(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_enable_repeat_collapse(&lg, true);
+
+    for (int i = 0; i < 5; ++i) repeat_probe(&lg, "storm");
+    repeat_probe(&lg, "calm");
+    for (int i = 0; i < 3; ++i) repeat_probe(&lg, "tail");
+
+    logger_close(&lg);  /* flushes the pending "tail" summary */
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 5);
+    assert_non_null(strstr(buf, "storm\n"));
+    assert_non_null(strstr(buf, "last message repeated 4 times"));
+    assert_non_null(strstr(buf, "calm\n"));
+    assert_non_null(strstr(buf, "last message repeated 2 times"));
+    /* The summary precedes the record that ended the run */
+    assert_true(strstr(buf, "repeated 4 times") < strstr(buf, "calm"));
+
+    free(buf);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void repeat_collapse_counts_and_flushes(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_enable_repeat_collapse(&lg, true);
+
+    for (int i = 0; i < 5; ++i) repeat_probe(&lg, "storm");
+    LoggerStats st;
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.emitted[2], 1);  /* WARNING */
+    assert_int_equal(st.collapsed, 4);
+
+    /* logger_flush() reports the run without waiting for another record. */
+    logger_flush(&lg);
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_non_null(strstr(buf, "last message repeated 4 times"));
+    free(buf);
+
+    /* With a timeout, the exporter tick reports a run that simply stopped. */
+    logger_set_repeat_timeout(&lg, 20);
+    for (int i = 0; i < 3; ++i) repeat_probe(&lg, "quiet");
+    assert_true(logger_get_stats(&lg, &st));
+    uint64_t before = st.bytes[LOGGER_SINK_STREAM];
+    const char* path = "clog_test_repeat.prom";
+    LoggerExporter ex;
+    assert_true(logger_exporter_start(&ex, &lg, path, 10));
+    for (int i = 0; i < 200 && st.bytes[LOGGER_SINK_STREAM] == before; ++i) {
+        struct timespec nap = { 0, 5 * 1000 * 1000 };
+        nanosleep(&nap, NULL);
+        logger_get_stats(&lg, &st);
+    }
+    logger_exporter_stop(&ex);
+    remove(path);
+    buf = slurp_stream(sink, &len);
+    assert_non_null(strstr(buf, "last message repeated 2 times"));
+    free(buf);
+
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void repeat_collapse_distinguishes_sites(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_enable_repeat_collapse(&lg, true);
+
+    /* Same text from two different call sites is not a repeat */
+    LOG_INFO(&lg, "same");
+    LOG_INFO(&lg, "same");
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 2);
+    assert_null(strstr(buf, "repeated"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void repeat_collapse_disabled_by_default(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    for (int i = 0; i < 3; ++i) repeat_probe(&lg, "again");
+
+    /* Turning it on and off again must not invent a summary */
+    logger_enable_repeat_collapse(&lg, true);
+    repeat_probe(&lg, "again");
+    repeat_probe(&lg, "again");
+    logger_enable_repeat_collapse(&lg, false);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 5);
+    assert_non_null(strstr(buf, "last message repeated 1 times"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+
+    errno = 0;
+    logger_enable_repeat_collapse(NULL, true);
+    assert_int_equal(errno, EINVAL);
+    errno = 0;
+    logger_set_repeat_timeout(NULL, 10);
+    assert_int_equal(errno, EINVAL);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST ADAPTIVE BUDGET 
+
+static void budget_noisy(Logger* lg, int i) { LOG_INFO(lg, "noisy %d", i); }
+static void budget_quiet(Logger* lg, int i) { LOG_INFO(lg, "quiet %d", i); }
+static void budget_error(Logger* lg, int i) { LOG_ERROR(lg, "error %d", i); }
+
+/* Pretend the current budget window started one full window ago. */
+static void budget_expire_window(Logger* lg) {
+    uint64_t win = (uint64_t)LOGGER_BUDGET_WINDOW_MS * 1000000u;
+    atomic_fetch_sub(&lg->budget.window_start_ns, win);
+}
+
+void budget_throttles_noisy_site(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_set_budget(&lg, 10, 0);
+
+    for (int i = 0; i < 200; ++i) budget_noisy(&lg, i);
+    budget_quiet(&lg, 0);
+    budget_expire_window(&lg);
+    budget_quiet(&lg, 1);            /* closes the window and rebalances */
+
+    fflush(sink);
+    long before = ftell(sink);
+    for (int i = 0; i < 1024; ++i) budget_noisy(&lg, i);
+    for (int i = 0; i < 4; ++i) budget_quiet(&lg, 100 + i);
+    for (int i = 0; i < 4; ++i) budget_error(&lg, i);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    const char* tail = buf + before;
+    size_t noisy = 0, quiet = 0, errors = 0;
+    for (const char* p = tail; (p = strstr(p, "noisy ")); ++p) ++noisy;
+    for (const char* p = tail; (p = strstr(p, "quiet ")); ++p) ++quiet;
+    for (const char* p = tail; (p = strstr(p, "error ")); ++p) ++errors;
+
+    assert_true(noisy > 0 && noisy <= 32);   /* sampled at 1/32 or harsher */
+    assert_int_equal(quiet, 4);              /* below fair share: untouched */
+    assert_int_equal(errors, 4);             /* never throttled */
+    assert_true(atomic_load(&lg.budget.dropped) >= 1024 - 32);
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+static void budget_every_n(Logger* lg, int i) { LOG_INFO_EVERY_N(lg, 2, "en %d", i); }
+
+void budget_drop_keeps_suppressed_count(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_set_budget(&lg, 10, 0);
+
+    /* Every other call is suppressed by EVERY_N; the budget then drops most
+       of the records that would have reported those counts. */
+    int calls = 0;
+    for (; calls < 400; ++calls) budget_every_n(&lg, calls);
+    budget_quiet(&lg, 0);
+    budget_expire_window(&lg);
+    budget_quiet(&lg, 1);
+    for (; calls < 2400; ++calls) budget_every_n(&lg, calls);
+    assert_true(atomic_load(&lg.budget.dropped) > 0);
+
+    /* With the budget off, the next emission carries whatever is left. */
+    logger_set_budget(&lg, 0, 0);
+    budget_every_n(&lg, calls);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    unsigned long reported = 0;
+    for (const char* p = buf; (p = strstr(p, "(suppressed ")); ++p) {
+        reported += strtoul(p + strlen("(suppressed "), NULL, 10);
+    }
+    assert_int_equal(reported, calls / 2);
+
+    /* The impl reports rejection so the macros can give the count back. */
+    assert_false(logger_log_suppressed_impl(&lg, LOG_DEBUG - 1, 3u, "b.c", 1, "f", "x"));
+    LoggerRateLimit rl = {0};
+    logger_ratelimit_restore(&rl, 3u);
+    assert_int_equal(atomic_load(&rl.suppressed), 3);
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void budget_restores_when_quiet(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_set_budget(&lg, 10, 0);
+
+    for (int i = 0; i < 100; ++i) budget_noisy(&lg, i);
+    budget_quiet(&lg, 0);
+    budget_expire_window(&lg);
+    budget_quiet(&lg, 1);
+
+    unsigned max_shift = 0;
+    for (size_t i = 0; i < LOGGER_BUDGET_SITES; ++i) {
+        unsigned s = atomic_load(&lg.budget.sites[i].sample_shift);
+        if (s > max_shift) max_shift = s;
+    }
+    assert_true(max_shift > 0);
+
+    /* Quiet windows restore one step each */
+    for (unsigned w = 0; w < max_shift; ++w) {
+        budget_expire_window(&lg);
+        budget_quiet(&lg, 2);
+    }
+    for (size_t i = 0; i < LOGGER_BUDGET_SITES; ++i) {
+        assert_int_equal(atomic_load(&lg.budget.sites[i].sample_shift), 0);
+    }
+
+    /* Disabling clears everything immediately */
+    logger_set_budget(&lg, 0, 0);
+    errno = 0;
+    logger_set_budget(NULL, 1, 1);
+    assert_int_equal(errno, EINVAL);
+
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void budget_evicts_idle_sites(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_set_budget(&lg, 1000000, 0);     /* never over budget: no sampling */
+
+    /* More distinct sites than the table holds. */
+    for (int line = 1; line <= 4 * LOGGER_BUDGET_SITES; ++line) {
+        logger_log_impl(&lg, LOG_INFO, "budget_site.c", line, "f", "site %d", line);
+    }
+    LoggerStats st;
+    assert_true(logger_get_stats(&lg, &st));
+    assert_true(st.budget_untracked > 0);
+
+    /* One window with the sites active, one with them idle. */
+    budget_expire_window(&lg);
+    budget_quiet(&lg, 0);
+    budget_expire_window(&lg);
+    budget_quiet(&lg, 1);
+    size_t used = 0;
+    for (size_t i = 0; i < LOGGER_BUDGET_SITES; ++i) {
+        if (atomic_load(&lg.budget.sites[i].key)) ++used;
+    }
+    assert_true(used <= 1);
+
+    /* The freed slots take new sites. */
+    logger_reset_stats(&lg);
+    for (int line = 1; line <= 8; ++line) {
+        logger_log_impl(&lg, LOG_INFO, "budget_other.c", line, "f", "site %d", line);
+    }
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.budget_untracked, 0);
+
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void budget_charges_message_bytes(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_set_budget(&lg, 0, 1u << 30);
+
+    /* Message bytes: the text, plus a hexdump's payload; not the layout. */
+    static unsigned char payload[4096];
+    LOG_INFO(&lg, "%s", "12345");
+    assert_int_equal(atomic_load(&lg.budget.window_bytes), 5);
+    LOG_HEXDUMP(&lg, LOG_INFO, payload, sizeof(payload));
+    assert_true(atomic_load(&lg.budget.window_bytes) >= 5 + sizeof(payload));
+    assert_true(atomic_load(&lg.budget.window_bytes) < 5 + sizeof(payload) + 64);
+
+    logger_close(&lg);
+    fclose(sink);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST SAMPLING 
+
+void sample_probability_bounds(void **state) {
+    (void)state;
+    for (int i = 0; i < 1000; ++i) {
+        assert_false(logger_sample(0.0));
+        assert_false(logger_sample(-1.0));
+        assert_true(logger_sample(1.0));
+    }
+
+    /* Rough frequency check: 10% of 100k draws, generous tolerance */
+    int hits = 0;
+    for (int i = 0; i < 100000; ++i) hits += logger_sample(0.1) ? 1 : 0;
+    assert_in_range(hits, 9000, 11000);
+}
+// -------------------------------------------------------------------------------- 
+
+void sample_keyed_is_deterministic(void **state) {
+    (void)state;
+    int kept = 0;
+    for (uint64_t key = 1; key <= 10000; ++key) {
+        bool first = logger_sample_keyed(0.25, key);
+        for (int r = 0; r < 3; ++r) assert_true(logger_sample_keyed(0.25, key) == first);
+        /* A sampled key stays sampled at any higher probability */
+        if (first) assert_true(logger_sample_keyed(0.5, key));
+        kept += first ? 1 : 0;
+    }
+    assert_in_range(kept, 2200, 2800);
+}
+// -------------------------------------------------------------------------------- 
+
+static int sample_side_effects;
+static int sample_arg(void) { return ++sample_side_effects; }
+
+void sample_macro_skips_arguments(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    sample_side_effects = 0;
+    for (int i = 0; i < 100; ++i) LOG_INFO_SAMPLED(&lg, 0.0, "never %d", sample_arg());
+    assert_int_equal(sample_side_effects, 0);
+
+    LOG_INFO_SAMPLED(&lg, 1.0, "always %d", sample_arg());
+    LOG_DEBUG_SAMPLED_KEYED(&lg, 1.0, 42u, "keyed %d", 7);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 2);
+    assert_non_null(strstr(buf, "always 1"));
+    assert_non_null(strstr(buf, "keyed 7"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST STRUCTURED FIELDS 
+
+void kv_text_renders_fields(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    const char path[] = "/index.html?x";
+    logger_kv(&lg, LOG_INFO, LOG_SITE(), "request done",
+              LKV_INT("status", -404), LKV_UINT("bytes", 18446744073709551615ull),
+              LKV_F64("ms", 1.5), LKV_BOOL("cached", 0),
+              LKV_STR("path", path), LKV_STR("agent", "curl 8.0"),
+              LKV_STRN("slice", "abcdef", 3));
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 1);
+    assert_non_null(strstr(buf, "kv_text_renders_fields: request done status=-404 "
+                                "bytes=18446744073709551615 ms=1.5 cached=false "
+                                "path=/index.html?x agent=\"curl 8.0\" slice=abc\n"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void kv_text_escapes_control_bytes(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    /* A value must not be able to forge a second record. */
+    logger_kv(&lg, LOG_INFO, LOG_SITE(), "login",
+              LKV_STR("user", "bob\nCRITICAL forged: admin ok"),
+              LKV_STR("raw", "a\rb\tc\x01\"d\\"), LKV_STR("empty", ""));
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 1);
+    assert_non_null(strstr(buf, "login user=\"bob\\nCRITICAL forged: admin ok\" "
+                                "raw=\"a\\rb\\tc\\x01\\\"d\\\\\" empty=\"\"\n"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void kv_keys_are_sanitized(void **state) {
+    (void)state;
+    static const LoggerFormat formats[] = { LOGGER_FORMAT_TEXT, LOGGER_FORMAT_LOGFMT };
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+        FILE* sink = make_temp_stream();
+        Logger lg;
+        assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+        logger_enable_timestamps(&lg, false);
+        logger_set_format(&lg, LOGGER_SINK_STREAM, formats[f]);
+
+        /* A key must not be able to forge a second record either. */
+        logger_kv(&lg, LOG_INFO, LOG_SITE(), "k",
+                  LKV_STR("a b=c\nFORGED level=ERROR", "v"), LKV_INT(NULL, 1));
+
+        size_t len = 0;
+        char* buf = slurp_stream(sink, &len);
+        assert_int_equal(count_newlines(buf), 1);
+        assert_non_null(strstr(buf, " a_b_c_FORGED_level_ERROR=v _=1\n"));
+        free(buf);
+        logger_close(&lg);
+        fclose(sink);
+    }
+}
+// -------------------------------------------------------------------------------- 
+
+void kv_reserved_keys_prefixed(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_JSON);
+
+    char long_key[100];
+    memset(long_key, 'k', sizeof(long_key) - 1);
+    long_key[sizeof(long_key) - 1] = '\0';
+    logger_kv(&lg, LOG_INFO, LOG_SITE(), "k",
+              LKV_INT("msg", 5), LKV_STR("level", "x"), LKV_BOOL("msgs", 1),
+              LKV_INT(long_key, 2));
+    logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_LOGFMT);
+    logger_kv(&lg, LOG_INFO, LOG_SITE(), "k", LKV_STR("ts", "0"), LKV_STR("caller", "x.c:1"));
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 2);
+    assert_non_null(strstr(buf, "\"level\":\"INFO\""));
+    assert_non_null(strstr(buf, ",\"msg\":\"k\",\"fields.msg\":5,\"fields.level\":\"x\","
+                                "\"msgs\":true,"));
+    char expect[80];
+    snprintf(expect, sizeof(expect), ",\"%.63s\":2}", long_key);
+    assert_non_null(strstr(buf, expect));
+    assert_non_null(strstr(buf, " msg=k fields.ts=0 fields.caller=x.c:1\n"));
+    assert_null(strstr(buf, " ts="));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void kv_filters_and_validates(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_WARNING));
+
+    LOG_KV(&lg, LOG_INFO, "filtered", LKV_INT("n", 1));
+
+    errno = 0;
+    logger_kv_impl(NULL, LOG_ERROR, NULL, "m", NULL, 0);
+    assert_int_equal(errno, EINVAL);
+    errno = 0;
+    logger_kv_impl(&lg, LOG_ERROR, NULL, NULL, NULL, 0);
+    assert_int_equal(errno, EINVAL);
+    errno = 0;
+    logger_kv_impl(&lg, LOG_ERROR, NULL, "m", NULL, 2);
+    assert_int_equal(errno, EINVAL);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(len, 0);
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST JSON FORMAT 
+
+/* Reference escaper for the JSON tests (scalar, obviously correct). */
+static size_t json_ref_escape(const char* s, size_t n, char* out) {
+    size_t o = 0;
+    out[o++] = '"';
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') { out[o++] = '\\'; out[o++] = (char)c; }
+        else if (c == '\n') { out[o++] = '\\'; out[o++] = 'n'; }
+        else if (c == '\r') { out[o++] = '\\'; out[o++] = 'r'; }
+        else if (c == '\t') { out[o++] = '\\'; out[o++] = 't'; }
+        else if (c == '\b') { out[o++] = '\\'; out[o++] = 'b'; }
+        else if (c == '\f') { out[o++] = '\\'; out[o++] = 'f'; }
+        else if (c < 0x20) { o += (size_t)sprintf(out + o, "\\u%04x", c); }
+        else out[o++] = (char)c;
+    }
+    out[o++] = '"';
+    out[o] = '\0';
+    return o;
+}
+// -------------------------------------------------------------------------------- 
+
+void json_format_fields(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_set_name(&lg, "svc");
+    assert_true(logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_JSON));
+
+    logger_write(&lg, LOG_WARNING, "j.c", 7, "fn", "hello");
+    logger_kv(&lg, LOG_INFO, LOG_SITE(), "kv",
+              LKV_INT("status", 200), LKV_STR("path", "/a b"),
+              LKV_F64("ms", 0.25), LKV_BOOL("ok", 1));
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 2);
+    assert_non_null(strstr(buf, "{\"level\":\"WARNING\",\"logger\":\"svc\",\"file\":\"j.c\","
+                                "\"line\":7,\"func\":\"fn\",\"msg\":\"hello\"}\n"));
+    assert_non_null(strstr(buf, "\"msg\":\"kv\",\"status\":200,\"path\":\"/a b\","
+                                "\"ms\":0.25,\"ok\":true}\n"));
+    assert_null(strstr(buf, "\x1b["));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void json_escaping_matches_reference(void **state) {
+    (void)state;
+    static const char specials[] = { '"', '\\', '\n', '\t', 0x01, 0x1f, '\r' };
+    char msg[200];
+    char expect[1400];
+    char needle[1500];
+
+    for (size_t len = 1; len < 100; len += 7) {
+        for (size_t pos = 0; pos < len; pos += 3) {
+            for (size_t k = 0; k < sizeof(specials); ++k) {
+                for (size_t i = 0; i < len; ++i) msg[i] = (char)('a' + (i % 26));
+                msg[pos] = specials[k];
+                if (pos + 2 < len) {        /* well-formed UTF-8 passes through */
+                    msg[len - 2] = (char)0xC3;
+                    msg[len - 1] = (char)0xA9;
+                }
+                msg[len] = '\0';
+
+                FILE* sink = make_temp_stream();
+                Logger lg;
+                assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+                logger_enable_timestamps(&lg, false);
+                logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_JSON);
+                logger_kv_impl(&lg, LOG_INFO, NULL, "m", &LKV_STRN("s", msg, len), 1);
+
+                json_ref_escape(msg, len, expect);
+                snprintf(needle, sizeof(needle), "\"s\":%s}\n", expect);
+                size_t n = 0;
+                char* buf = slurp_stream(sink, &n);
+                assert_non_null(strstr(buf, needle));
+                free(buf);
+                logger_close(&lg);
+                fclose(sink);
+            }
+        }
+    }
+}
+// -------------------------------------------------------------------------------- 
+
+static const void* find_bytes(const void* hay, size_t n, const void* needle, size_t m);
+
+/* Reference check: every byte sequence is well-formed UTF-8 (RFC 3629). */
+static bool utf8_ref_valid(const unsigned char* s, size_t n) {
+    for (size_t i = 0; i < n;) {
+        unsigned c = s[i];
+        size_t len = c < 0x80 ? 1 : c < 0xC2 ? 0 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : c < 0xF5 ? 4 : 0;
+        if (!len || i + len > n) return false;
+        uint32_t cp = len == 1 ? c : c & (0x7Fu >> len);
+        for (size_t k = 1; k < len; ++k) {
+            if ((s[i + k] & 0xC0) != 0x80) return false;
+            cp = (cp << 6) | (s[i + k] & 0x3Fu);
+        }
+        if ((len == 3 && cp < 0x800) || (len == 4 && (cp < 0x10000 || cp > 0x10FFFF)) ||
+            (cp >= 0xD800 && cp <= 0xDFFF)) return false;
+        i += len;
+    }
+    return true;
+}
+
+void utf8_invalid_bytes_replaced(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_JSON);
+
+    static const char* const in[] = {
+        "a\xC3(b", "\xED\xA0\x80", "\xF0\x9F\x98\x80", "\xC0\xAF", "\xE2\x82", "caf\xC3\xA9"
+    };
+    static const char* const out[] = {
+        "a\\ufffd(b", "\\ufffd\\ufffd\\ufffd", "\xF0\x9F\x98\x80", "\\ufffd\\ufffd",
+        "\\ufffd\\ufffd", "caf\xC3\xA9"
+    };
+    for (size_t i = 0; i < sizeof(in) / sizeof(in[0]); ++i) {
+        logger_write_n(&lg, LOG_INFO, "u.c", 1, "f", in[i], strlen(in[i]));
+    }
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    for (size_t i = 0; i < sizeof(out) / sizeof(out[0]); ++i) {
+        char needle[64];
+        snprintf(needle, sizeof(needle), "\"msg\":\"%s\"}\n", out[i]);
+        assert_non_null(strstr(buf, needle));
+    }
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+
+    /* Random slices of binary data, as from a network buffer. */
+    FILE* rnd = make_temp_stream();
+    assert_true(logger_init_stream(&lg, rnd, LOG_DEBUG));
+    logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_JSON);
+    unsigned char noise[4096];
+    uint32_t x = 12345u;
+    for (size_t i = 0; i < sizeof(noise); ++i) {
+        x = x * 1103515245u + 12345u;
+        noise[i] = (unsigned char)(x >> 16);
+    }
+    for (int i = 0; i < 500; ++i) {
+        x = x * 1103515245u + 12345u;
+        size_t off = (x >> 8) % 4000u;
+        logger_write_n(&lg, LOG_INFO, "u.c", 1, "f", (const char*)noise + off, (x >> 20) % 96u);
+    }
+    buf = slurp_stream(rnd, &len);
+    assert_int_equal(count_newlines(buf), 500);
+    assert_true(utf8_ref_valid((const unsigned char*)buf, len));
+    free(buf);
+    logger_close(&lg);
+    fclose(rnd);
+
+    /* CBOR text strings and OTLP strings get the same replacement. */
+    static const LoggerFormat binary[] = { LOGGER_FORMAT_CBOR, LOGGER_FORMAT_OTLP };
+    for (size_t f = 0; f < 2; ++f) {
+        FILE* bin = make_temp_stream();
+        assert_true(logger_init_stream(&lg, bin, LOG_DEBUG));
+        logger_set_format(&lg, LOGGER_SINK_STREAM, binary[f]);
+        logger_write_n(&lg, LOG_INFO, "u.c", 1, "f", "a\xFF" "b", 3);
+        logger_kv(&lg, LOG_INFO, LOG_SITE(), "m", LKV_STRN("v", "\xC3", 1));
+        buf = slurp_stream(bin, &len);
+        /* CBOR major type 3 head vs. protobuf varint length. */
+        const char head = binary[f] == LOGGER_FORMAT_CBOR ? 0x60 : 0;
+        const char want[] = { (char)(head | 5), 'a', (char)0xEF, (char)0xBF, (char)0xBD, 'b' };
+        const char field[] = { (char)(head | 3), (char)0xEF, (char)0xBF, (char)0xBD };
+        assert_non_null(find_bytes(buf, len, want, sizeof(want)));
+        assert_non_null(find_bytes(buf, len, field, sizeof(field)));
+        assert_null(find_bytes(buf, len, "a\xFF" "b", 3));
+        free(buf);
+        logger_close(&lg);
+        fclose(bin);
+    }
+}
+// -------------------------------------------------------------------------------- 
+
+void json_oversized_record_stays_valid(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_JSON);
+
+    char big[2040];
+    memset(big, '\x02', sizeof(big) - 1);   /* each byte expands to \u0002 */
+    big[sizeof(big) - 1] = '\0';
+    logger_write(&lg, LOG_INFO, "b.c", 1, "f", big);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_true(len > 0);
+    assert_int_equal(count_newlines(buf), 1);
+    assert_int_equal(buf[0], '{');
+    assert_string_equal(buf + len - 3, "\"}\n");
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+
+    errno = 0;
+    assert_false(logger_set_format(NULL, LOGGER_SINK_FILE, LOGGER_FORMAT_JSON));
+    assert_int_equal(errno, EINVAL);
+    errno = 0;
+    assert_false(logger_set_format(&lg, LOGGER_SINK_COUNT, LOGGER_FORMAT_JSON));
+    assert_int_equal(errno, EINVAL);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST LOGFMT FORMAT 
+
+void logfmt_format_and_quoting(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_set_name(&lg, "svc");
+    assert_true(logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_LOGFMT));
+
+    logger_write(&lg, LOG_WARNING, "l.c", 9, "fn", "ready");
+    logger_write(&lg, LOG_INFO, "l.c", 10, "fn", "a=b \"q\"\n");
+    logger_write(&lg, LOG_INFO, "l.c", 11, "fn", "");
+    logger_kv(&lg, LOG_INFO, LOG_SITE(), "kv",
+              LKV_INT("status", 200), LKV_STR("path", "/a b"),
+              LKV_BOOL("ok", 1), LKV_STR("tag", "x\x01"));
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 4);
+    assert_non_null(strstr(buf, "level=WARNING logger=svc caller=l.c:9 func=fn msg=ready\n"));
+    assert_non_null(strstr(buf, "msg=\"a=b \\\"q\\\"\\n\"\n"));
+    assert_non_null(strstr(buf, "caller=l.c:11 func=fn msg=\"\"\n"));
+    assert_non_null(strstr(buf, "msg=kv status=200 path=\"/a b\" ok=true tag=\"x\\x01\"\n"));
+    assert_null(strstr(buf, "\x1b["));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void prefix_cache_tracks_layout_changes(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_enable_colors(&lg, false);
+
+    static const char* msgs[] = { "m0", "m1", "m2" };
+    for (int pass = 0; pass < 3; ++pass) {
+        if (pass == 1) logger_set_name(&lg, "first");
+        if (pass == 2) logger_set_name(&lg, "second");
+        for (int i = 0; i < 2; ++i)
+            logger_write(&lg, LOG_INFO, "p.c", 3, "fn", msgs[pass]);
+    }
+    assert_true(logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_LOGFMT));
+    logger_write(&lg, LOG_INFO, "p.c", 3, "fn", "m3");
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 7);
+    assert_non_null(strstr(buf, "INFO     p.c:3:fn: m0\nINFO     p.c:3:fn: m0\n"));
+    assert_non_null(strstr(buf, "[first] INFO     p.c:3:fn: m1\n[first] INFO     p.c:3:fn: m1\n"));
+    assert_non_null(strstr(buf, "[second] INFO     p.c:3:fn: m2\n[second] INFO     p.c:3:fn: m2\n"));
+    assert_non_null(strstr(buf, "level=INFO logger=second caller=p.c:3 func=fn msg=m3\n"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST CBOR FORMAT 
+
+static void write_sample_records(Logger* lg) {
+    logger_write(lg, LOG_WARNING, "c.c", 7, "fn", "plain \"quoted\"\n");
+    logger_kv(lg, LOG_ERROR, LOG_SITE(), "kv",
+              LKV_INT("neg", -1234567890123LL), LKV_UINT("big", 18446744073709551615ULL),
+              LKV_INT("small", 5), LKV_F64("ms", 0.25), LKV_BOOL("ok", 0),
+              LKV_STR("path", "/a b"), LKV_INT("line", 99));
+}
+// -------------------------------------------------------------------------------- 
+
+void cbor_round_trips_to_json(void **state) {
+    (void)state;
+    FILE* bin = make_temp_stream();
+    FILE* ref = make_temp_stream();
+    Logger a, b;
+    assert_true(logger_init_stream(&a, bin, LOG_DEBUG));
+    assert_true(logger_init_stream(&b, ref, LOG_DEBUG));
+    logger_enable_timestamps(&a, false);
+    logger_enable_timestamps(&b, false);
+    logger_set_name(&a, "svc");
+    logger_set_name(&b, "svc");
+    assert_true(logger_set_format(&a, LOGGER_SINK_STREAM, LOGGER_FORMAT_CBOR));
+    assert_true(logger_set_format(&b, LOGGER_SINK_STREAM, LOGGER_FORMAT_JSON));
+    write_sample_records(&a);
+    write_sample_records(&b);
+
+    size_t bin_len = 0, ref_len = 0;
+    char* enc = slurp_stream(bin, &bin_len);
+    char* expect = slurp_stream(ref, &ref_len);
+
+    char decoded[2048];
+    size_t used = 0, off = 0;
+    for (size_t pos = 0; pos < bin_len; ) {
+        size_t consumed = 0, n = 0;
+        assert_true(logger_cbor_decode(enc + pos, bin_len - pos, &consumed,
+                                       LOGGER_FORMAT_JSON, decoded + used,
+                                       sizeof(decoded) - used, &n));
+        pos += consumed;
+        used += n;
+        ++off;
+    }
+    assert_int_equal(off, 2);
+    assert_int_equal(used, ref_len);
+    assert_memory_equal(decoded, expect, ref_len);
+
+    free(enc);
+    free(expect);
+    logger_close(&a);
+    logger_close(&b);
+    fclose(bin);
+    fclose(ref);
+}
+// -------------------------------------------------------------------------------- 
+
+void cbor_encoding_is_exact(void **state) {
+    (void)state;
+    static const unsigned char expect[] = {
+        0xA5,
+        0x65, 'l', 'e', 'v', 'e', 'l', 0x64, 'I', 'N', 'F', 'O',
+        0x64, 'f', 'i', 'l', 'e',      0x63, 'a', '.', 'c',
+        0x64, 'l', 'i', 'n', 'e',      0x18, 0x2A,
+        0x64, 'f', 'u', 'n', 'c',      0x61, 'f',
+        0x63, 'm', 's', 'g',           0x62, 'h', 'i',
+    };
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    assert_true(logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_CBOR));
+    logger_write(&lg, LOG_INFO, "a.c", 42, "f", "hi");
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(len, sizeof(expect));
+    assert_memory_equal(buf, expect, sizeof(expect));
+
+    char text[256];
+    size_t n = 0;
+    assert_true(logger_cbor_decode(buf, len, NULL, LOGGER_FORMAT_TEXT, text, sizeof(text), &n));
+    text[n] = '\0';
+    assert_string_equal(text, "INFO     a.c:42:f: hi\n");
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void cbor_decode_rejects_bad_input(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    assert_true(logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_CBOR));
+    write_sample_records(&lg);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    char out[1024];
+    size_t first = 0;
+    assert_true(logger_cbor_decode(buf, len, &first, LOGGER_FORMAT_LOGFMT, out, sizeof(out), NULL));
+
+    /* Every strict prefix of a record is incomplete. */
+    for (size_t cut = 0; cut < first; ++cut) {
+        set_errno_sentinel();
+        assert_false(logger_cbor_decode(buf, cut, NULL, LOGGER_FORMAT_JSON, out, sizeof(out), NULL));
+        assert_int_equal(errno, EINVAL);
+    }
+
+    set_errno_sentinel();
+    assert_false(logger_cbor_decode(buf, len, NULL, LOGGER_FORMAT_JSON, out, 8, NULL));
+    assert_int_equal(errno, ERANGE);
+
+    set_errno_sentinel();
+    assert_false(logger_cbor_decode(buf, len, NULL, LOGGER_FORMAT_CBOR, out, sizeof(out), NULL));
+    assert_int_equal(errno, EINVAL);
+
+    static const unsigned char not_a_map[] = { 0x82, 0x01, 0x02 };
+    set_errno_sentinel();
+    assert_false(logger_cbor_decode(not_a_map, sizeof(not_a_map), NULL, LOGGER_FORMAT_TEXT,
+                                    out, sizeof(out), NULL));
+    assert_int_equal(errno, EINVAL);
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void cbor_decode_null_line(void **state) {
+    (void)state;
+    /* {"level": "INFO", "line": null, "msg": "m"} */
+    static const unsigned char rec[] = {
+        0xA3,
+        0x65, 'l', 'e', 'v', 'e', 'l', 0x64, 'I', 'N', 'F', 'O',
+        0x64, 'l', 'i', 'n', 'e', 0xF6,
+        0x63, 'm', 's', 'g', 0x61, 'm',
+    };
+    char out[256];
+    size_t used = 0, n = 0;
+    assert_true(logger_cbor_decode(rec, sizeof(rec), &used, LOGGER_FORMAT_JSON,
+                                   out, sizeof(out), &n));
+    assert_int_equal(used, sizeof(rec));
+    out[n] = '\0';
+    assert_non_null(strstr(out, "\"line\":0,"));     /* null line: not taken, not a field */
+    assert_null(strstr(out, "\"line\":null"));
+    assert_non_null(strstr(out, "\"msg\":\"m\"}"));
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST OTLP FORMAT 
+
+void otlp_frame_is_exact(void **state) {
+    (void)state;
+    static const unsigned char expect[] = {
+        0x67,                                   /* frame length */
+        0x0A, 0x65,                             /* LogsData.resource_logs */
+        0x12, 0x63,                             /* ResourceLogs.scope_logs */
+        0x0A, 0x05, 0x0A, 0x03, 's', 'v', 'c',  /* scope { name: "svc" } */
+        0x12, 0x5A,                             /* log_records */
+        0x10, 0x09,                             /* severity_number: INFO */
+        0x1A, 0x04, 'I', 'N', 'F', 'O',         /* severity_text */
+        0x2A, 0x04, 0x0A, 0x02, 'h', 'i',       /* body { string_value } */
+        0x32, 0x17, 0x0A, 0x0E, 'c', 'o', 'd', 'e', '.', 'f', 'i', 'l', 'e', '.',
+        'p', 'a', 't', 'h', 0x12, 0x05, 0x0A, 0x03, 'a', '.', 'c',
+        0x32, 0x16, 0x0A, 0x10, 'c', 'o', 'd', 'e', '.', 'l', 'i', 'n', 'e', '.',
+        'n', 'u', 'm', 'b', 'e', 'r', 0x12, 0x02, 0x18, 0x2A,
+        0x32, 0x19, 0x0A, 0x12, 'c', 'o', 'd', 'e', '.', 'f', 'u', 'n', 'c', 't',
+        'i', 'o', 'n', '.', 'n', 'a', 'm', 'e', 0x12, 0x03, 0x0A, 0x01, 'f',
+    };
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_set_name(&lg, "svc");
+    assert_true(logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_OTLP));
+    logger_write(&lg, LOG_INFO, "a.c", 42, "f", "hi");
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(len, sizeof(expect));
+    assert_memory_equal(buf, expect, sizeof(expect));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+static size_t read_varint(const unsigned char* p, uint64_t* v) {
+    size_t n = 0;
+    unsigned shift = 0;
+    *v = 0;
+    do {
+        *v |= (uint64_t)(p[n] & 0x7Fu) << shift;
+        shift += 7;
+    } while (p[n++] & 0x80u);
+    return n;
+}
+// -------------------------------------------------------------------------------- 
+
+static const void* find_bytes(const void* hay, size_t n, const void* needle, size_t m) {
+    const unsigned char* h = (const unsigned char*)hay;
+    for (size_t i = 0; m <= n && i <= n - m; ++i) {
+        if (memcmp(h + i, needle, m) == 0) return h + i;
+    }
+    return NULL;
+}
+// -------------------------------------------------------------------------------- 
+
+void otlp_frames_and_attributes(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    assert_true(logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_OTLP));
+    logger_write(&lg, LOG_CRITICAL, "a.c", 1, "f", "first");
+    logger_kv(&lg, LOG_DEBUG, LOG_SITE(), "second",
+              LKV_INT("neg", -2), LKV_BOOL("ok", 1), LKV_F64("ms", 1.5),
+              LKV_UINT("big", 18446744073709551615ULL));
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    const unsigned char* p = (const unsigned char*)buf;
+
+    /* Frames tile the stream exactly. */
+    size_t pos = 0, frames = 0;
+    while (pos < len) {
+        uint64_t n;
+        pos += read_varint(p + pos, &n);
+        pos += (size_t)n;
+        ++frames;
+    }
+    assert_int_equal(pos, len);
+    assert_int_equal(frames, 2);
+
+    /* Unnamed logger: no scope. With timestamps on, the LogRecord starts
+       with time_unix_nano (field 1, fixed64). */
+    uint64_t n;
+    size_t hdr = read_varint(p, &n);
+    assert_int_equal(p[hdr], 0x0A);
+    assert_int_equal(p[hdr + 2], 0x12);
+    assert_int_equal(p[hdr + 4], 0x12);
+    assert_int_equal(p[hdr + 6], 0x09);
+    assert_int_equal(p[hdr + 6 + 9], 0x59);        /* observed_time_unix_nano */
+    assert_memory_equal(p + hdr + 6 + 18, "\x10\x15", 2);  /* FATAL */
+
+    /* int64 -2 as a ten-byte varint, bool, double and oversized uint. */
+    static const unsigned char neg[] = { 0x0A, 0x03, 'n', 'e', 'g', 0x12, 0x0B, 0x18,
+        0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+    static const unsigned char ok[] = { 0x0A, 0x02, 'o', 'k', 0x12, 0x02, 0x10, 0x01 };
+    static const unsigned char ms[] = { 0x0A, 0x02, 'm', 's', 0x12, 0x09, 0x21,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF8, 0x3F };
+    static const char big[] = "\x12\x16\x0A\x14" "18446744073709551615";
+    assert_non_null(find_bytes(buf, len, neg, sizeof(neg)));
+    assert_non_null(find_bytes(buf, len, ok, sizeof(ok)));
+    assert_non_null(find_bytes(buf, len, ms, sizeof(ms)));
+    assert_non_null(find_bytes(buf, len, big, sizeof(big) - 1));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST STATISTICS 
+
+void stats_count_records_and_bytes(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_INFO));
+    logger_enable_timestamps(&lg, false);
+    assert_true(logger_set_category_level(&lg, "net", LOG_ERROR));
+
+    logger_write(&lg, LOG_DEBUG, "s.c", 1, "f", "filtered");
+    logger_write(&lg, LOG_INFO, "s.c", 2, "f", "one");
+    logger_write(&lg, LOG_ERROR, "s.c", 3, "f", "two");
+    logger_kv(&lg, LOG_WARNING, LOG_SITE(), "three", LKV_INT("k", 1));
+    LOG_CAT_WARNING(&lg, "net.http", "filtered by category");
+    LOG_CAT_CRITICAL(&lg, "net.http", "four");
+    /* Level checks inlined by the rate and sampling macros are counted too. */
+    LOG_RATELIMITED(&lg, LOG_DEBUG, 10.0, 1u, "filtered");
+    LOG_EVERY_N(&lg, LOG_DEBUG, 2, "filtered");
+    LOG_SAMPLED(&lg, LOG_DEBUG, 1.0, "filtered");
+    LOG_SAMPLED_KEYED(&lg, LOG_DEBUG, 1.0, 42u, "filtered");
+
+    LoggerStats st;
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.filtered[0], 5);  /* DEBUG */
+    assert_int_equal(st.filtered[2], 1);  /* WARNING via category */
+    assert_int_equal(st.emitted[0], 0);
+    assert_int_equal(st.emitted[1], 1);
+    assert_int_equal(st.emitted[2], 1);
+    assert_int_equal(st.emitted[3], 1);
+    assert_int_equal(st.emitted[4], 1);
+    assert_int_equal(st.flushes, 2);  /* ERROR and CRITICAL only (default policy) */
+    assert_int_equal(st.write_errors, 0);
+    assert_int_equal(st.bytes[LOGGER_SINK_FILE], 0);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(st.bytes[LOGGER_SINK_STREAM], len);
+
+    logger_reset_stats(&lg);
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.emitted[1], 0);
+    assert_int_equal(st.bytes[LOGGER_SINK_STREAM], 0);
+    assert_int_equal(st.flushes, 0);
+
+    /* Explicit flushes count once per open sink. */
+    logger_flush(&lg);
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.flushes, 1);
+
+    set_errno_sentinel();
+    assert_false(logger_get_stats(&lg, NULL));
+    assert_int_equal(errno, EINVAL);
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void stats_count_write_errors(void **state) {
+    (void)state;
+    /* A stream opened read-only rejects writes. */
+    FILE* sink = fopen("/dev/null", "r");
+    if (!sink) skip();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_write(&lg, LOG_INFO, "s.c", 1, "f", "cannot land");
+
+    LoggerStats st;
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.emitted[1], 1);
+    assert_int_equal(st.write_errors, 1);
+    assert_int_equal(st.bytes[LOGGER_SINK_STREAM], 0);
+
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+#ifndef _WIN32
+static void* stats_contender(void* arg) {
+    logger_write((Logger*)arg, LOG_INFO, "s.c", 1, "f", "waited");
+    return NULL;
+}
+#endif
+
+void stats_measure_lock_wait(void **state) {
+    (void)state;
+#ifdef _WIN32
+    skip();
+#else
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+
+    logger_write(&lg, LOG_INFO, "s.c", 1, "f", "uncontended");
+    LoggerStats st;
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.lock_wait_ns, 0);
+
+    pthread_t th;
+    LOGGER_MUTEX_LOCK(lg.lock);
+    assert_int_equal(pthread_create(&th, NULL, stats_contender, &lg), 0);
+    struct timespec nap = { 0, 20 * 1000 * 1000 };
+    nanosleep(&nap, NULL);
+    LOGGER_MUTEX_UNLOCK(lg.lock);
+    pthread_join(th, NULL);
+
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.emitted[1], 2);
+    assert_true(st.lock_wait_ns >= 5u * 1000u * 1000u);
+
+    logger_close(&lg);
+    fclose(sink);
+#endif
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST LATENCY HISTOGRAM 
+
+void latency_histogram_records_calls(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_INFO));
+
+    logger_write(&lg, LOG_INFO, "h.c", 1, "f", "not recorded");
+    LoggerLatency h;
+    assert_true(logger_latency_snapshot(&lg, &h, false));
+    assert_int_equal(h.count, 0);
+
+    static LoggerLatencyHistogram hist;
+    assert_true(logger_enable_latency_histogram(&lg, &hist));
+    for (int i = 0; i < 100; ++i) logger_write(&lg, LOG_INFO, "h.c", 2, "f", "recorded");
+    logger_write(&lg, LOG_DEBUG, "h.c", 3, "f", "filtered, not recorded");
+
+    assert_true(logger_latency_snapshot(&lg, &h, true));
+    assert_int_equal(h.count, 100);
+    uint64_t total = 0;
+    for (size_t i = 0; i < LOGGER_LATENCY_BUCKETS; ++i) total += h.buckets[i];
+    assert_int_equal(total, 100);
+    assert_true(h.sum_ns > 0);
+    uint64_t p50 = logger_latency_percentile(&h, 0.5);
+    uint64_t p99 = logger_latency_percentile(&h, 0.99);
+    uint64_t p999 = logger_latency_percentile(&h, 0.999);
+    assert_true(p50 > 0);
+    assert_true(p50 <= p99 && p99 <= p999 && p999 <= h.max_ns);
+
+    /* The reset snapshot left nothing behind. */
+    assert_true(logger_latency_snapshot(&lg, &h, false));
+    assert_int_equal(h.count, 0);
+    assert_int_equal(h.max_ns, 0);
+    assert_int_equal(logger_latency_percentile(&h, 0.99), 0);
+
+    /* Detaching stops recording; the storage keeps what it had. */
+    logger_write(&lg, LOG_INFO, "h.c", 4, "f", "recorded");
+    assert_true(logger_enable_latency_histogram(&lg, NULL));
+    logger_write(&lg, LOG_INFO, "h.c", 5, "f", "not recorded");
+    assert_true(logger_latency_snapshot(&lg, &h, false));
+    assert_int_equal(h.count, 0);
+    assert_int_equal(atomic_load(&hist.stripes[0].count) + atomic_load(&hist.stripes[1].count) +
+                     atomic_load(&hist.stripes[2].count) + atomic_load(&hist.stripes[3].count), 1);
+    set_errno_sentinel();
+    assert_false(logger_enable_latency_histogram(NULL, &hist));
+    assert_int_equal(errno, EINVAL);
+
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void latency_percentile_bucket_edges(void **state) {
+    (void)state;
+    LoggerLatency h;
+    memset(&h, 0, sizeof(h));
+    h.buckets[3] = 50;     /* exactly 3 ns */
+    h.buckets[16] = 40;    /* 16..17 ns */
+    h.buckets[20] = 9;     /* 24..25 ns */
+    h.buckets[LOGGER_LATENCY_BUCKETS - 1] = 1;
+    h.count = 100;
+    h.max_ns = 5000000000ull;
+
+    assert_int_equal(logger_latency_percentile(&h, 0.0), 3);
+    assert_int_equal(logger_latency_percentile(&h, 0.5), 3);
+    assert_int_equal(logger_latency_percentile(&h, 0.51), 17);
+    assert_int_equal(logger_latency_percentile(&h, 0.99), 25);
+    assert_int_equal(logger_latency_percentile(&h, 1.0), 5000000000ull);  /* capped at max */
+    assert_int_equal(logger_latency_percentile(NULL, 0.5), 0);
+
+    set_errno_sentinel();
+    assert_false(logger_latency_snapshot(NULL, &h, false));
+    assert_int_equal(errno, EINVAL);
+}
+
+// -------------------------------------------------------------------------------- 
+
+void latency_add_matches_recorder(void **state) {
+    (void)state;
+    LoggerLatency h;
+    memset(&h, 0, sizeof(h));
+    logger_latency_add(&h, 3);
+    logger_latency_add(&h, 17);
+    logger_latency_add(&h, 1000);
+    assert_int_equal(h.count, 3);
+    assert_int_equal(h.sum_ns, 1020);
+    assert_int_equal(h.max_ns, 1000);
+    assert_int_equal(h.buckets[3], 1);
+    assert_int_equal(h.buckets[16], 1);
+    assert_int_equal(logger_latency_percentile(&h, 0.5), 17);
+    assert_true(logger_latency_percentile(&h, 1.0) == 1000);
+
+    set_errno_sentinel();
+    logger_latency_add(NULL, 5);
+    assert_int_equal(errno, EINVAL);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST PROMETHEUS EXPORT 
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    char* buf = slurp_stream(f, NULL);
+    fclose(f);
+    return buf;
+}
+// -------------------------------------------------------------------------------- 
+
+void prometheus_export_writes_textfile(void **state) {
+    (void)state;
+    const char* path = "clog_test_metrics.prom";
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_INFO));
+    logger_set_name(&lg, "api \"v1\"");
+    static LoggerLatencyHistogram hist;
+    logger_enable_latency_histogram(&lg, &hist);
+    logger_write(&lg, LOG_INFO, "p.c", 1, "f", "one");
+    logger_write(&lg, LOG_ERROR, "p.c", 2, "f", "two");
+    logger_write(&lg, LOG_DEBUG, "p.c", 3, "f", "filtered");
+
+    assert_true(logger_export_prometheus(&lg, path));
+    char* text = read_file(path);
+    assert_non_null(text);
+    assert_non_null(strstr(text, "# TYPE clog_records_total counter\n"));
+    assert_non_null(strstr(text, "clog_records_total{logger=\"api \\\"v1\\\"\",level=\"info\"} 1\n"));
+    assert_non_null(strstr(text, "clog_records_total{logger=\"api \\\"v1\\\"\",level=\"error\"} 1\n"));
+    assert_non_null(strstr(text, "clog_filtered_total{logger=\"api \\\"v1\\\"\",level=\"debug\"} 1\n"));
+    assert_non_null(strstr(text, "clog_flushes_total{logger=\"api \\\"v1\\\"\"} 1\n"));  /* ERROR only */
+    assert_non_null(strstr(text, "# TYPE clog_call_duration_seconds histogram\n"));
+    assert_non_null(strstr(text, ",le=\"+Inf\"} 2\n"));
+    assert_non_null(strstr(text, "clog_call_duration_seconds_count{logger=\"api \\\"v1\\\"\"} 2\n"));
+    free(text);
+
+    /* The temporary file is renamed away. */
+    FILE* tmp = fopen("clog_test_metrics.prom.tmp", "r");
+    assert_null(tmp);
+
+    set_errno_sentinel();
+    assert_false(logger_export_prometheus(&lg, NULL));
+    assert_int_equal(errno, EINVAL);
+    assert_false(logger_export_prometheus(&lg, bad_log_path()));
+
+    remove(path);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void prometheus_exporter_thread_publishes(void **state) {
+    (void)state;
+    const char* path = "clog_test_exporter.prom";
+    remove(path);
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_INFO));
+    logger_write(&lg, LOG_WARNING, "p.c", 1, "f", "before");
+
+    LoggerExporter ex;
+    set_errno_sentinel();
+    assert_false(logger_exporter_start(&ex, &lg, path, 0));
+    assert_int_equal(errno, EINVAL);
+
+    assert_true(logger_exporter_start(&ex, &lg, path, 10));
+    char* text = NULL;
+    for (int i = 0; i < 200 && !text; ++i) {
+        struct timespec nap = { 0, 5 * 1000 * 1000 };
+        nanosleep(&nap, NULL);
+        text = read_file(path);
+    }
+    assert_non_null(text);
+    assert_non_null(strstr(text, "clog_records_total{logger=\"\",level=\"warning\"} 1\n"));
+    assert_null(strstr(text, "clog_call_duration_seconds"));
+    free(text);
+
+    /* stop() writes a final snapshot with everything logged so far. */
+    logger_write(&lg, LOG_WARNING, "p.c", 2, "f", "after");
+    logger_exporter_stop(&ex);
+    logger_exporter_stop(&ex);
+    text = read_file(path);
+    assert_non_null(text);
+    assert_non_null(strstr(text, "clog_records_total{logger=\"\",level=\"warning\"} 2\n"));
+    free(text);
+
+    remove(path);
+    logger_close(&lg);
+    fclose(sink);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST CALL TRACE 
+
+void trace_records_call_shapes(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_INFO));
+    LoggerTraceEvent ev[8];
+    assert_true(logger_trace_start(&lg, ev, 8));
+
+    logger_write(&lg, LOG_DEBUG, "t.c", 10, "f", "filtered");
+    logger_write(&lg, LOG_INFO, "t.c", 11, "f", "hello");
+    const LogSite site = { "tt.c", 12, "f" };
+    logger_kv(&lg, LOG_ERROR, &site, "kv", LKV_STR("key", "value"), LKV_INT("n", 42));
+
+    uint64_t dropped = 1;
+    assert_int_equal(logger_trace_stop(&lg, &dropped), 3);
+    assert_int_equal(dropped, 0);
+
+    assert_int_equal(ev[0].flags, LOGGER_TRACE_FILTERED);
+    assert_int_equal(ev[0].level, LOG_DEBUG);
+    assert_int_equal(ev[0].msg_len, 0);
+    assert_int_equal(ev[1].flags, 0);
+    assert_int_equal(ev[1].level, LOG_INFO);
+    assert_int_equal(ev[1].line, 11);
+    assert_int_equal(ev[1].file_len, 3);
+    assert_int_equal(ev[1].msg_len, 5);
+    assert_int_equal(ev[1].n_fields, 0);
+    assert_int_equal(ev[2].level, LOG_ERROR);
+    assert_int_equal(ev[2].file_len, 4);
+    assert_int_equal(ev[2].msg_len, 2);
+    assert_int_equal(ev[2].n_fields, 2);
+    assert_int_equal(ev[2].fields_len, 3 + 5 + 1);  /* "key" "value" "n" */
+    assert_int_equal(ev[0].site, ev[1].site);       /* same file pointer */
+    assert_int_not_equal(ev[1].site, ev[2].site);
+    assert_int_equal(ev[0].thread, ev[2].thread);
+    assert_true(ev[0].thread != 0);
+    assert_true(ev[1].t_ns >= ev[0].t_ns && ev[2].t_ns >= ev[1].t_ns);
+
+    logger_close(&lg);
+    fclose(sink);
+}
+
+// -------------------------------------------------------------------------------- 
+
+void trace_overflow_counts_dropped(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_INFO));
+    LoggerTraceEvent ev[2];
+    assert_true(logger_trace_start(&lg, ev, 2));
+    for (int i = 0; i < 5; ++i) logger_write(&lg, LOG_INFO, "t.c", i, "f", "x");
+    uint64_t dropped = 0;
+    assert_int_equal(logger_trace_stop(&lg, &dropped), 2);
+    assert_int_equal(dropped, 3);
+    assert_int_equal(ev[1].line, 1);
+
+    /* Stopped: calls are no longer recorded. */
+    logger_write(&lg, LOG_INFO, "t.c", 9, "f", "x");
+    assert_int_equal(logger_trace_stop(&lg, &dropped), 2);
+
+    set_errno_sentinel();
+    assert_false(logger_trace_start(&lg, NULL, 4));
+    assert_int_equal(errno, EINVAL);
+    set_errno_sentinel();
+    assert_false(logger_trace_start(&lg, ev, 0));
+    assert_int_equal(errno, EINVAL);
+
+    logger_close(&lg);
+    fclose(sink);
+}
+
+// -------------------------------------------------------------------------------- 
+
+void trace_save_load_roundtrip(void **state) {
+    (void)state;
+    const char* path = "clog_test_trace.bin";
+    LoggerTraceEvent ev[3];
+    memset(ev, 0, sizeof(ev));
+    for (int i = 0; i < 3; ++i) {
+        ev[i].t_ns = 1000u * (uint64_t)i;
+        ev[i].thread = 1u + (uint32_t)i;
+        ev[i].line = 7u;
+        ev[i].msg_len = 40u + (uint32_t)i;
+        ev[i].level = LOG_WARNING;
+        ev[i].site = 0xA1B2C3D4u;
+        ev[i].file_len = 0x0102u;
+        ev[i].flags = LOGGER_TRACE_COLLAPSED;
+    }
+    assert_true(logger_trace_save(path, ev, 3));
+
+    /* Fields are stored little-endian and unpadded: 16-byte header, 33 per event. */
+    unsigned char raw[16 + 3 * 33 + 1];
+    FILE* in = fopen(path, "rb");
+    assert_non_null(in);
+    assert_int_equal(fread(raw, 1, sizeof(raw), in), 16 + 3 * 33);
+    fclose(in);
+    assert_memory_equal(raw, "CLOGTRC2", 8);
+    const unsigned char* e1 = raw + 16 + 33;
+    static const unsigned char t_ns[8] = { 0xE8, 0x03, 0, 0, 0, 0, 0, 0 };
+    static const unsigned char site[4] = { 0xD4, 0xC3, 0xB2, 0xA1 };
+    assert_memory_equal(e1, t_ns, 8);
+    assert_int_equal(e1[8], 2);
+    assert_memory_equal(e1 + 12, site, 4);
+    assert_int_equal(e1[28], 0x02);
+    assert_int_equal(e1[29], 0x01);
+    assert_int_equal(e1[31], LOG_WARNING);
+    assert_int_equal(e1[32], LOGGER_TRACE_COLLAPSED);
+
+    size_t n = 0;
+    assert_true(logger_trace_load(path, NULL, 0, &n));
+    assert_int_equal(n, 3);
+    LoggerTraceEvent back[3];
+    set_errno_sentinel();
+    assert_false(logger_trace_load(path, back, 2, &n));
+    assert_int_equal(errno, ERANGE);
+    assert_true(logger_trace_load(path, back, 3, &n));
+    assert_memory_equal(back, ev, sizeof(ev));
+
+    /* Traces longer than one I/O chunk. */
+    static LoggerTraceEvent many[300], many_back[300];
+    for (size_t i = 0; i < 300; ++i) {
+        many[i] = ev[i % 3];
+        many[i].t_ns = (uint64_t)i << 33;
+    }
+    assert_true(logger_trace_save(path, many, 300));
+    assert_true(logger_trace_load(path, many_back, 300, &n));
+    assert_int_equal(n, 300);
+    assert_memory_equal(many_back, many, sizeof(many));
+
+    /* Anything without the header is rejected. */
+    FILE* f = fopen(path, "wb");
+    assert_non_null(f);
+    fputs("not a trace file", f);
+    fclose(f);
+    set_errno_sentinel();
+    assert_false(logger_trace_load(path, back, 3, &n));
+    assert_int_equal(errno, EINVAL);
+    remove(path);
+
+    set_errno_sentinel();
+    assert_false(logger_trace_save(NULL, ev, 3));
+    assert_int_equal(errno, EINVAL);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST LARGE RECORDS 
+
+static char* make_filler(size_t n, char c) {
+    char* s = (char*)malloc(n + 1);
+    assert_non_null(s);
+    memset(s, c, n);
+    s[n] = '\0';
+    return s;
+}
+// -------------------------------------------------------------------------------- 
+
+void large_message_not_truncated(void **state) {
+    (void)state;
+    char* big = make_filler(10000, 'x');
+    static const LoggerFormat formats[] = { LOGGER_FORMAT_TEXT, LOGGER_FORMAT_JSON,
+                                            LOGGER_FORMAT_LOGFMT };
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+        FILE* sink = make_temp_stream();
+        Logger lg;
+        assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+        logger_enable_timestamps(&lg, false);
+        assert_true(logger_set_format(&lg, LOGGER_SINK_STREAM, formats[f]));
+        LOG_INFO(&lg, "<%s>", big);
+        LOG_INFO(&lg, "short %d", 1);   /* stack buffers still used afterwards */
+
+        size_t len = 0;
+        char* buf = slurp_stream(sink, &len);
+        assert_int_equal(count_newlines(buf), 2);
+        const char* open = strchr(buf, '<');
+        assert_non_null(open);
+        assert_memory_equal(open + 1, big, 10000);
+        assert_int_equal(open[10001], '>');
+        assert_non_null(strstr(buf, "short 1"));
+
+        free(buf);
+        logger_close(&lg);
+        fclose(sink);
+    }
+    free(big);
+    logger_thread_release();
+}
+// -------------------------------------------------------------------------------- 
+
+void large_message_otlp_frame(void **state) {
+    (void)state;
+    char* big = make_filler(20000, 'y');
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_set_name(&lg, "svc");
+    assert_true(logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_OTLP));
+    LOG_CAT_INFO(&lg, "net", "%s", big);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    uint64_t n;
+    size_t hdr = read_varint((const unsigned char*)buf, &n);
+    assert_int_equal(hdr + n, len);
+    assert_non_null(find_bytes(buf, len, big, 20000));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+    free(big);
+    logger_thread_release();
+}
+// -------------------------------------------------------------------------------- 
+
+void large_message_capped(void **state) {
+    (void)state;
+    char* huge = make_filler((size_t)3 << 20, 'z');
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    LOG_WARNING(&lg, "%s", huge);
+    LOG_WARNING(&lg, "after %d", 2);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 2);
+    assert_true(len > (size_t)1 << 19);
+    assert_true(len <= ((size_t)1 << 20) + 64);
+    assert_non_null(strstr(buf, "after 2"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+    free(huge);
+    logger_thread_release();
+    logger_thread_release();   /* idempotent */
+}
+// -------------------------------------------------------------------------------- 
+
+void large_message_truncation_marked(void **state) {
+    (void)state;
+    const size_t msg_max = ((size_t)1 << 20) - 4096;   /* record limit less one line */
+    char* huge = make_filler((size_t)3 << 20, 'z');
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    /* Formatted, then a pre-sized message in JSON: both say what was cut. */
+    LOG_WARNING(&lg, "%s", huge);
+    logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_JSON);
+    logger_write_n(&lg, LOG_INFO, "t.c", 1, "f", huge, (size_t)2 << 20);
+    logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_TEXT);
+
+    /* A streamed record keeps counting after it is full. */
+    LoggerRecord rec;
+    assert_true(logger_record_begin(&lg, &rec, LOG_INFO, NULL));
+    size_t appended = 0;
+    for (int i = 0; i < 4; ++i) {
+        logger_record_append(&rec, "%.*s", 300 * 1024, huge);
+        appended += 300 * 1024;
+    }
+    assert_false(logger_record_append(&rec, "%s", "tail"));
+    appended += 4;
+    logger_record_commit(&rec);
+
+    /* A dump cut while rendering. */
+    LOG_HEXDUMP(&lg, LOG_INFO, huge, (size_t)512 * 1024);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_true(count_newlines(buf) >= 4);
+    char expect[64];
+    snprintf(expect, sizeof(expect), "z...[truncated %zu bytes]\n", ((size_t)3 << 20) - msg_max);
+    assert_non_null(strstr(buf, expect));
+    snprintf(expect, sizeof(expect), "z...[truncated %zu bytes]\"", ((size_t)2 << 20) - msg_max);
+    assert_non_null(strstr(buf, expect));
+
+    const char* line = strstr(buf, "?:0:?: z");
+    assert_non_null(line);
+    const char* mark = strstr(line, "...[truncated ");
+    assert_non_null(mark);
+    size_t kept = strspn(line + 7, "z");
+    assert_true(kept > 0);
+    assert_true(line + 7 + kept == mark);
+    assert_int_equal(kept + strtoull(mark + 14, NULL, 10), appended);
+
+    const char* dump = strstr(buf, "hexdump 524288 bytes...[truncated ");
+    assert_non_null(dump);
+
+    LoggerStats st;
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.truncated, 4);
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+    free(huge);
+    logger_thread_release();
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST VECTORED WRITES 
+
+void writev_matches_concatenation(void **state) {
+    (void)state;
+    static const char payload[] = { 'a', ' ', '"', 'b', '"', '=', '\n', 'Z' };
+    static const LoggerFormat formats[] = { LOGGER_FORMAT_TEXT, LOGGER_FORMAT_JSON,
+                                            LOGGER_FORMAT_LOGFMT, LOGGER_FORMAT_CBOR,
+                                            LOGGER_FORMAT_OTLP };
+    const LoggerFrag frags[] = { LFRAG_LIT("peer "), LFRAG("", 0), LFRAG("x1", 2),
+                                 LFRAG_LIT(": "), LFRAG(payload, 7) };
+    const char whole[] = "peer x1: a \"b\"=\n";
+    const LogSite site = { "v.c", 3, "f" };
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+        FILE* a = make_temp_stream();
+        FILE* b = make_temp_stream();
+        Logger la, lb;
+        assert_true(logger_init_stream(&la, a, LOG_DEBUG));
+        assert_true(logger_init_stream(&lb, b, LOG_DEBUG));
+        logger_enable_timestamps(&la, false);
+        logger_enable_timestamps(&lb, false);
+        assert_true(logger_set_format(&la, LOGGER_SINK_STREAM, formats[f]));
+        assert_true(logger_set_format(&lb, LOGGER_SINK_STREAM, formats[f]));
+
+        logger_writev(&la, LOG_INFO, &site, frags, sizeof(frags) / sizeof(frags[0]));
+        logger_write_n(&lb, LOG_INFO, "v.c", 3, "f", whole, sizeof(whole) - 1);
+
+        size_t na = 0, nb = 0;
+        char* ba = slurp_stream(a, &na);
+        char* bb = slurp_stream(b, &nb);
+        assert_int_equal(na, nb);
+        assert_memory_equal(ba, bb, na);
+
+        free(ba);
+        free(bb);
+        logger_close(&la);
+        logger_close(&lb);
+        fclose(a);
+        fclose(b);
+    }
+}
+// -------------------------------------------------------------------------------- 
+
+void writev_macro_and_errors(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    const char* key = "user=alice;more";
+    LOG_WRITEV(&lg, LOG_WARNING, LFRAG_LIT("login "), LFRAG(key, 10));
+    logger_writev(&lg, LOG_INFO, NULL, NULL, 0);
+
+    errno = 0;
+    logger_writev(NULL, LOG_INFO, NULL, NULL, 0);
+    assert_int_equal(errno, EINVAL);
+    errno = 0;
+    logger_writev(&lg, LOG_INFO, NULL, NULL, 2);
+    assert_int_equal(errno, EINVAL);
+    const LoggerFrag bad[] = { LFRAG_LIT("ok"), LFRAG(NULL, 4) };
+    errno = 0;
+    logger_writev(&lg, LOG_INFO, NULL, bad, 2);
+    assert_int_equal(errno, EINVAL);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 2);
+    assert_non_null(strstr(buf, ": login user=alice\n"));
+    assert_non_null(strstr(buf, "?:0:?: \n"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void writev_large_record_single_line(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    assert_true(logger_set_format(&lg, LOGGER_SINK_STREAM, LOGGER_FORMAT_JSON));
+
+    static char chunk[3000];
+    memset(chunk, 'q', sizeof(chunk));
+    const LoggerFrag frags[] = { LFRAG(chunk, sizeof(chunk)), LFRAG(chunk, sizeof(chunk)),
+                                 LFRAG(chunk, sizeof(chunk)) };
+    logger_writev(&lg, LOG_INFO, LOG_SITE(), frags, 3);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 1);
+    const char* msg = strstr(buf, "\"msg\":\"");
+    assert_non_null(msg);
+    assert_int_equal(strspn(msg + 7, "q"), 9000);
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+    logger_thread_release();
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST BATCH WRITES 
+
+void batch_matches_single_calls(void **state) {
+    (void)state;
+    const LogSite s1 = { "b.c", 10, "work" };
+    const LogSite s2 = { "b.c", 20, "work" };
+    const LoggerField kv[] = { LKV_INT("n", 7), LKV_STR("who", "w1") };
+    const LogRecord recs[] = {
+        { LOG_INFO,    &s1, "first",  (size_t)-1, NULL, 0 },
+        { LOG_DEBUG,   &s1, "hidden", (size_t)-1, NULL, 0 },   /* filtered */
+        { LOG_WARNING, &s2, "slice!!", 5,         kv,   2 },
+        { LOG_ERROR,   NULL, "no site", (size_t)-1, NULL, 0 },
+    };
+    static const LoggerFormat formats[] = { LOGGER_FORMAT_TEXT, LOGGER_FORMAT_JSON };
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+        FILE* a = make_temp_stream();
+        FILE* b = make_temp_stream();
+        Logger la, lb;
+        assert_true(logger_init_stream(&la, a, LOG_INFO));
+        assert_true(logger_init_stream(&lb, b, LOG_INFO));
+        logger_enable_timestamps(&la, false);
+        logger_enable_timestamps(&lb, false);
+        assert_true(logger_set_format(&la, LOGGER_SINK_STREAM, formats[f]));
+        assert_true(logger_set_format(&lb, LOGGER_SINK_STREAM, formats[f]));
+
+        logger_write_batch(&la, recs, sizeof(recs) / sizeof(recs[0]));
+        logger_write_n(&lb, LOG_INFO, "b.c", 10, "work", "first", 5);
+        logger_kv_impl(&lb, LOG_WARNING, &s2, "slice", kv, 2);
+        logger_write_n(&lb, LOG_ERROR, "?", 0, "?", "no site", 7);
+
+        size_t na = 0, nb = 0;
+        char* ba = slurp_stream(a, &na);
+        char* bb = slurp_stream(b, &nb);
+        assert_int_equal(count_newlines(ba), 3);
+        assert_int_equal(na, nb);
+        assert_memory_equal(ba, bb, na);
+
+        LoggerStats st;
+        assert_true(logger_get_stats(&la, &st));
+        assert_int_equal(st.emitted[1], 1);   /* INFO */
+        assert_int_equal(st.emitted[2], 1);   /* WARNING */
+        assert_int_equal(st.emitted[3], 1);   /* ERROR */
+        assert_int_equal(st.filtered[0], 1);  /* DEBUG */
+        assert_int_equal(st.flushes, 1);            /* the ERROR, once */
+        assert_int_equal(st.bytes[LOGGER_SINK_STREAM], na);
+
+        free(ba);
+        free(bb);
+        logger_close(&la);
+        logger_close(&lb);
+        fclose(a);
+        fclose(b);
+    }
+}
+// -------------------------------------------------------------------------------- 
+
+void batch_keeps_order_and_repeats(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+    logger_enable_repeat_collapse(&lg, true);
+
+    /* 40 KB records overflow the 64 KiB batch buffer; the 100 KB one is
+       written on its own. Order must survive both. */
+    char* big = (char*)malloc(100000);
+    assert_non_null(big);
+    memset(big, 'k', 100000);
+    const LogSite s = { "r.c", 1, "f" };
+    const LogSite t = { "r.c", 2, "f" };
+    const LogRecord recs[] = {
+        { LOG_INFO, &s, "same", 4, NULL, 0 },
+        { LOG_INFO, &s, "same", 4, NULL, 0 },
+        { LOG_INFO, &s, "same", 4, NULL, 0 },
+        { LOG_INFO, &t, big, 40000, NULL, 0 },
+        { LOG_INFO, &t, big, 40001, NULL, 0 },
+        { LOG_INFO, &t, big, 100000, NULL, 0 },
+        { LOG_INFO, &t, "tail", 4, NULL, 0 },
+    };
+    logger_write_batch(&lg, recs, sizeof(recs) / sizeof(recs[0]));
+    logger_write_batch(&lg, NULL, 0);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 6);
+    const char* rep = strstr(buf, "last message repeated 2 times");
+    const char* k1 = strstr(buf, "r.c:2:f: kkk");
+    const char* tail = strstr(buf, "r.c:2:f: tail");
+    assert_non_null(rep);
+    assert_non_null(k1);
+    assert_non_null(tail);
+    assert_true(buf < rep && rep < k1 && k1 < tail);
+    assert_int_equal(strspn(k1 + 9, "k"), 40000);
+    const char* k3 = strstr(strstr(k1 + 1, "r.c:2:f: kkk") + 1, "r.c:2:f: kkk");
+    assert_non_null(k3);
+    assert_int_equal(strspn(k3 + 9, "k"), 100000);
+
+    free(buf);
+    free(big);
+    logger_close(&lg);
+    fclose(sink);
+    logger_thread_release();
+}
+// -------------------------------------------------------------------------------- 
+
+void batch_bad_args(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    const LogRecord bad[] = {
+        { LOG_INFO, NULL, "ok", (size_t)-1, NULL, 0 },
+        { LOG_INFO, NULL, NULL, 3, NULL, 0 },
+    };
+    errno = 0;
+    logger_write_batch(NULL, bad, 1);
+    assert_int_equal(errno, EINVAL);
+    errno = 0;
+    logger_write_batch(&lg, NULL, 2);
+    assert_int_equal(errno, EINVAL);
+    errno = 0;
+    logger_write_batch(&lg, bad, 2);
+    assert_int_equal(errno, EINVAL);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(len, 0);   /* nothing from a rejected batch */
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST STREAMING RECORDS 
+
+void record_stream_builds_one_line(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_INFO));
+    logger_enable_timestamps(&lg, false);
+
+    LoggerRecord rec;
+    assert_true(LOG_RECORD_BEGIN(&lg, &rec, LOG_INFO));
+    assert_true(logger_record_append(&rec, "dump:"));
+    for (int i = 0; i < 2000; ++i) assert_true(logger_record_append(&rec, " %04d", i));
+    LOG_INFO(&lg, "%s", "other");          /* the open record is not in the way */
+    logger_record_commit(&rec);
+    logger_record_commit(&rec);            /* already closed: no-op */
+
+    LoggerRecord quiet;
+    errno = 0;
+    assert_false(LOG_RECORD_BEGIN(&lg, &quiet, LOG_DEBUG));
+    assert_int_equal(errno, 0);
+    assert_false(logger_record_append(&quiet, "never %d", 1));
+    logger_record_commit(&quiet);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 2);
+    assert_non_null(strstr(buf, ": other\n"));
+    const char* dump = strstr(buf, ": dump: 0000 0001 ");
+    assert_non_null(dump);
+    const char* end = strchr(dump, '\n');
+    assert_int_equal(end - dump, 7 + 2000 * 5);
+    assert_memory_equal(end - 5, " 1999", 5);
+
+    LoggerStats st;
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.emitted[1], 2);
+    assert_int_equal(st.filtered[0], 1);
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+    logger_thread_release();
+}
+// -------------------------------------------------------------------------------- 
+
+void record_stream_limits_and_errors(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    LoggerRecord a, b;
+    assert_true(logger_record_begin(&lg, &a, LOG_INFO, NULL));
+    errno = 0;
+    assert_false(logger_record_begin(&lg, &b, LOG_INFO, NULL));
+    assert_int_equal(errno, EBUSY);
+
+    /* Stop at the record limit, keeping what fitted. */
+    static char chunk[300 * 1024];
+    memset(chunk, 'm', sizeof(chunk) - 1);
+    bool ok = true;
+    for (int i = 0; i < 4 && ok; ++i) ok = logger_record_append(&a, "%s", chunk);
+    assert_false(ok);
+    assert_true(a.truncated);
+    assert_false(logger_record_append(&a, "x"));
+    logger_record_commit(&a);
+
+    errno = 0;
+    assert_false(logger_record_begin(NULL, &b, LOG_INFO, NULL));
+    assert_int_equal(errno, EINVAL);
+    errno = 0;
+    assert_false(logger_record_append(NULL, "x"));
+    assert_int_equal(errno, EINVAL);
+    assert_true(logger_record_begin(&lg, &b, LOG_INFO, NULL));   /* reopened */
+    logger_record_commit(&b);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 2);
+    assert_true(len > (size_t)900 * 1024);
+    assert_true(len < (size_t)1 << 20);
+    assert_non_null(strstr(buf, "?:0:?: \n"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+    logger_thread_release();
+}
+// -------------------------------------------------------------------------------- 
+
+#ifndef _WIN32
+static void* record_stream_worker(void* arg) {
+    Logger* lg = (Logger*)arg;
+    for (int r = 0; r < 20; ++r) {
+        LoggerRecord rec;
+        if (!LOG_RECORD_BEGIN(lg, &rec, LOG_INFO)) continue;
+        logger_record_append(&rec, "<");
+        for (int i = 0; i < 1000; ++i) logger_record_append(&rec, "%c", 'a' + r % 26);
+        logger_record_append(&rec, ">");
+        logger_record_commit(&rec);
+    }
+    logger_thread_release();
+    return NULL;
+}
+#endif
+
+void record_stream_not_interleaved(void **state) {
+    (void)state;
+#ifdef _WIN32
+    skip();
+#else
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    pthread_t th[4];
+    for (int i = 0; i < 4; ++i) {
+        assert_int_equal(pthread_create(&th[i], NULL, record_stream_worker, &lg), 0);
+    }
+    for (int i = 0; i < 4; ++i) pthread_join(th[i], NULL);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 80);
+    for (char* line = buf; *line; line = strchr(line, '\n') + 1) {
+        const char* open = strchr(line, '<');
+        assert_non_null(open);
+        assert_int_equal(strspn(open + 1, "abcdefghijklmnopqrst"), 1000);
+        assert_memory_equal(open + 1001, ">\n", 2);
+    }
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+#endif
+}
+// -------------------------------------------------------------------------------- 
+
+void record_stream_abort_and_busy(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    /* An abandoned record blocks the thread until it is aborted. */
+    LoggerRecord dropped;
+    assert_true(logger_record_begin(&lg, &dropped, LOG_INFO, NULL));
+    assert_true(logger_record_append(&dropped, "dropped"));
+    LoggerRecord next;
+    errno = 0;
+    assert_false(logger_record_begin(&lg, &next, LOG_INFO, NULL));
+    assert_int_equal(errno, EBUSY);
+    logger_record_abort(&dropped);
+    logger_record_abort(&dropped);            /* already closed: no-op */
+    logger_record_commit(&dropped);           /* nothing left to write */
+
+    /* A second begin on the open record leaves it intact. */
+    LoggerRecord rec;
+    assert_true(logger_record_begin(&lg, &rec, LOG_WARNING, NULL));
+    assert_true(logger_record_append(&rec, "kept"));
+    errno = 0;
+    assert_false(logger_record_begin(&lg, &rec, LOG_INFO, NULL));
+    assert_int_equal(errno, EBUSY);
+    assert_true(rec.open);
+    assert_true(logger_record_append(&rec, " whole"));
+    logger_record_commit(&rec);
+
+    LoggerRecord quiet;
+    lg.level = LOG_ERROR;
+    assert_false(logger_record_begin(&lg, &quiet, LOG_INFO, NULL));
+    logger_record_abort(&quiet);              /* filtered: no-op */
+    lg.level = LOG_DEBUG;
+    errno = 0;
+    logger_record_abort(NULL);
+    assert_int_equal(errno, EINVAL);
+
+    assert_true(logger_record_begin(&lg, &rec, LOG_INFO, NULL));  /* recovered */
+    logger_record_commit(&rec);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 2);
+    assert_null(strstr(buf, "dropped"));
+    assert_non_null(strstr(buf, ": kept whole\n"));
+
+    LoggerStats st;
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.emitted[1] + st.emitted[2], 2);
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+    logger_thread_release();
+}
+// -------------------------------------------------------------------------------- 
+
+#ifndef _WIN32
+static void* record_stream_foreign(void* arg) {
+    LoggerRecord* rec = (LoggerRecord*)arg;
+    errno = 0;
+    bool appended = logger_record_append(rec, "foreign");
+    int append_err = errno;
+    errno = 0;
+    logger_record_commit(rec);
+    int commit_err = errno;
+    errno = 0;
+    logger_record_abort(rec);
+    int abort_err = errno;
+    return (!appended && append_err == EINVAL && commit_err == EINVAL &&
+            abort_err == EINVAL && rec->open) ? rec : NULL;
+}
+#endif
+
+void record_stream_rejects_other_thread(void **state) {
+    (void)state;
+#ifdef _WIN32
+    skip();
+#else
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    LoggerRecord rec;
+    assert_true(logger_record_begin(&lg, &rec, LOG_INFO, NULL));
+    assert_true(logger_record_append(&rec, "mine"));
+    pthread_t th;
+    void* res = NULL;
+    assert_int_equal(pthread_create(&th, NULL, record_stream_foreign, &rec), 0);
+    pthread_join(th, &res);
+    assert_true(res == &rec);
+    logger_record_commit(&rec);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 1);
+    assert_non_null(strstr(buf, ": mine\n"));
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+    logger_thread_release();
+#endif
+}
+// ================================================================================ 
+// ================================================================================ 
+// TEST HEX DUMPS 
+
+void hexdump_text_is_canonical(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    const char pkt[] = "Hello, world!\n\x01\x7f\x80\xff";   /* 18 bytes */
+    const LogSite site = { "h.c", 5, "f" };
+    logger_hexdump(&lg, LOG_DEBUG, &site, pkt, sizeof(pkt) - 1);
+    logger_hexdump(&lg, LOG_DEBUG, &site, NULL, 0);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    const char* expect =
+        "DEBUG    h.c:5:f: hexdump 18 bytes\n"
+        "00000000  48 65 6c 6c 6f 2c 20 77  6f 72 6c 64 21 0a 01 7f  |Hello, world!...|\n"
+        "00000010  80 ff                                             |..|\n"
+        "00000012\n"
+        "DEBUG    h.c:5:f: hexdump 0 bytes\n"
+        "00000000\n";
+    assert_string_equal(buf, expect);
+
+    free(buf);
+    logger_close(&lg);
+    fclose(sink);
+}
+// -------------------------------------------------------------------------------- 
+
+void hexdump_machine_formats(void **state) {
+    (void)state;
+    static const unsigned char raw[] = { 0xde, 0xad, 0x00, 0xbe, 0xef, 0x22, 0x0a };
+    const LogSite site = { "h.c", 6, "f" };
+    static const LoggerFormat formats[] = { LOGGER_FORMAT_JSON, LOGGER_FORMAT_LOGFMT,
+                                            LOGGER_FORMAT_CBOR, LOGGER_FORMAT_OTLP };
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+        FILE* sink = make_temp_stream();
+        Logger lg;
+        assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+        logger_enable_timestamps(&lg, false);
+        assert_true(logger_set_format(&lg, LOGGER_SINK_STREAM, formats[f]));
+        logger_hexdump(&lg, LOG_INFO, &site, raw, sizeof(raw));
+
+        size_t len = 0;
+        char* buf = slurp_stream(sink, &len);
+        switch (formats[f]) {
+            case LOGGER_FORMAT_JSON:
+                assert_non_null(strstr(buf, "\"msg\":\"hexdump 7 bytes\",\"data\":\"dead00beef220a\"}\n"));
+                break;
+            case LOGGER_FORMAT_LOGFMT:
+                assert_non_null(strstr(buf, "msg=\"hexdump 7 bytes\" data=dead00beef220a\n"));
+                break;
+            case LOGGER_FORMAT_CBOR: {
+                /* "data": byte string of 7, then the bytes unchanged. */
+                static const unsigned char tail[] = { 0x64, 'd', 'a', 't', 'a', 0x47,
+                                                      0xde, 0xad, 0x00, 0xbe, 0xef, 0x22, 0x0a };
+                assert_true(len > sizeof(tail));
+                assert_memory_equal(buf + len - sizeof(tail), tail, sizeof(tail));
+
+                char out[512];
+                size_t used = 0, n = 0;
+                assert_true(logger_cbor_decode(buf, len, &used, LOGGER_FORMAT_TEXT,
+                                               out, sizeof(out), &n));
+                assert_int_equal(used, len);
+                out[n] = '\0';
+                assert_non_null(strstr(out, "hexdump 7 bytes\n00000000  de ad 00 be ef 22 0a"));
+                break;
+            }
+            default: {
+                /* KeyValue{ key "data", value AnyValue{ bytes_value (7) } } */
+                static const unsigned char attr[] = { 0x0A, 0x04, 'd', 'a', 't', 'a', 0x12, 0x09,
+                                                      0x3A, 0x07, 0xde, 0xad, 0x00, 0xbe, 0xef,
+                                                      0x22, 0x0a };
+                assert_non_null(find_bytes(buf, len, attr, sizeof(attr)));
+                break;
+            }
+        }
+        free(buf);
+        logger_close(&lg);
+        fclose(sink);
+    }
+}
+// -------------------------------------------------------------------------------- 
+
+void hexdump_large_payload_one_record(void **state) {
+    (void)state;
+    FILE* sink = make_temp_stream();
+    Logger lg;
+    assert_true(logger_init_stream(&lg, sink, LOG_DEBUG));
+    logger_enable_timestamps(&lg, false);
+
+    size_t n = 64u * 1024u;
+    unsigned char* p = (unsigned char*)malloc(n);
+    assert_non_null(p);
+    for (size_t i = 0; i < n; ++i) p[i] = (unsigned char)(i * 7u);
+    LOG_HEXDUMP(&lg, LOG_WARNING, p, n);
+
+    errno = 0;
+    logger_hexdump(NULL, LOG_INFO, NULL, p, 1);
+    assert_int_equal(errno, EINVAL);
+    errno = 0;
+    logger_hexdump(&lg, LOG_INFO, NULL, NULL, 4);
+    assert_int_equal(errno, EINVAL);
+
+    size_t len = 0;
+    char* buf = slurp_stream(sink, &len);
+    assert_int_equal(count_newlines(buf), 1 + n / 16 + 1);
+    assert_non_null(strstr(buf, "hexdump 65536 bytes\n00000000  00 07 0e 15"));
+    assert_non_null(strstr(buf, "\n0000fff0  "));
+    assert_string_equal(buf + len - 10, "\n00010000\n");
+
+    LoggerStats st;
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.emitted[2], 1);
+
+    free(buf);
+    free(p);
+    logger_close(&lg);
+    fclose(sink);
+    logger_thread_release();
+}
 // ================================================================================
 // ================================================================================
 // eof
@@ -45,6 +45,10 @@ void init_file_null_path(void **state);
 // -------------------------------------------------------------------------------- 
 
 void init_file_open_fail_bad_parent(void **state);
+
+// -------------------------------------------------------------------------------- 
+
+void init_file_buffered_bad_args(void **state);
 // -------------------------------------------------------------------------------- 
 
 void init_dual_null_logger(void **state);
@@ -129,6 +133,246 @@ void write_errno_null_args(void **state);
 // -------------------------------------------------------------------------------- 
 
 void write_name_toggle(void **state);
+// -------------------------------------------------------------------------------- 
+
+void write_n_uses_exact_length(void **state);
+// -------------------------------------------------------------------------------- 
+
+void write_n_errno_null_args(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST CATEGORIES 
+
+void category_inherits_from_ancestor(void **state);
+// -------------------------------------------------------------------------------- 
+
+void category_macro_filters_and_tags(void **state);
+// -------------------------------------------------------------------------------- 
+
+void category_follows_root_level(void **state);
+// -------------------------------------------------------------------------------- 
+
+void category_errno_null_args(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST RATE LIMITING 
+
+void every_n_emits_period_and_count(void **state);
+// -------------------------------------------------------------------------------- 
+
+void ratelimit_allows_burst_then_drops(void **state);
+// -------------------------------------------------------------------------------- 
+
+void ratelimit_reports_suppressed(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST REPEAT COLLAPSING 
+
+void repeat_collapse_summarizes_run(void **state);
+// -------------------------------------------------------------------------------- 
+
+void repeat_collapse_counts_and_flushes(void **state);
+// -------------------------------------------------------------------------------- 
+
+void repeat_collapse_distinguishes_sites(void **state);
+// -------------------------------------------------------------------------------- 
+
+void repeat_collapse_disabled_by_default(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST ADAPTIVE BUDGET 
+
+void budget_throttles_noisy_site(void **state);
+// -------------------------------------------------------------------------------- 
+
+void budget_drop_keeps_suppressed_count(void **state);
+// -------------------------------------------------------------------------------- 
+
+void budget_restores_when_quiet(void **state);
+// -------------------------------------------------------------------------------- 
+
+void budget_evicts_idle_sites(void **state);
+// -------------------------------------------------------------------------------- 
+
+void budget_charges_message_bytes(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST SAMPLING 
+
+void sample_probability_bounds(void **state);
+// -------------------------------------------------------------------------------- 
+
+void sample_keyed_is_deterministic(void **state);
+// -------------------------------------------------------------------------------- 
+
+void sample_macro_skips_arguments(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST STRUCTURED FIELDS 
+
+void kv_text_renders_fields(void **state);
+// -------------------------------------------------------------------------------- 
+
+void kv_text_escapes_control_bytes(void **state);
+// -------------------------------------------------------------------------------- 
+
+void kv_keys_are_sanitized(void **state);
+// -------------------------------------------------------------------------------- 
+
+void kv_reserved_keys_prefixed(void **state);
+// -------------------------------------------------------------------------------- 
+
+void kv_filters_and_validates(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST JSON FORMAT 
+
+void json_format_fields(void **state);
+// -------------------------------------------------------------------------------- 
+
+void json_escaping_matches_reference(void **state);
+// -------------------------------------------------------------------------------- 
+
+void utf8_invalid_bytes_replaced(void **state);
+// -------------------------------------------------------------------------------- 
+
+void json_oversized_record_stays_valid(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST LOGFMT FORMAT 
+
+void logfmt_format_and_quoting(void **state);
+// -------------------------------------------------------------------------------- 
+
+void prefix_cache_tracks_layout_changes(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST CBOR FORMAT 
+
+void cbor_round_trips_to_json(void **state);
+// -------------------------------------------------------------------------------- 
+
+void cbor_encoding_is_exact(void **state);
+// -------------------------------------------------------------------------------- 
+
+void cbor_decode_rejects_bad_input(void **state);
+// -------------------------------------------------------------------------------- 
+
+void cbor_decode_null_line(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST OTLP FORMAT 
+
+void otlp_frame_is_exact(void **state);
+// -------------------------------------------------------------------------------- 
+
+void otlp_frames_and_attributes(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST STATISTICS 
+
+void stats_count_records_and_bytes(void **state);
+// -------------------------------------------------------------------------------- 
+
+void stats_count_write_errors(void **state);
+// -------------------------------------------------------------------------------- 
+
+void stats_measure_lock_wait(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST LATENCY HISTOGRAM 
+
+void latency_histogram_records_calls(void **state);
+// -------------------------------------------------------------------------------- 
+
+void latency_percentile_bucket_edges(void **state);
+
+// -------------------------------------------------------------------------------- 
+
+void latency_add_matches_recorder(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST PROMETHEUS EXPORT 
+
+void prometheus_export_writes_textfile(void **state);
+// -------------------------------------------------------------------------------- 
+
+void prometheus_exporter_thread_publishes(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST CALL TRACE 
+
+void trace_records_call_shapes(void **state);
+// -------------------------------------------------------------------------------- 
+
+void trace_overflow_counts_dropped(void **state);
+// -------------------------------------------------------------------------------- 
+
+void trace_save_load_roundtrip(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST LARGE RECORDS 
+
+void large_message_not_truncated(void **state);
+// -------------------------------------------------------------------------------- 
+
+void large_message_otlp_frame(void **state);
+// -------------------------------------------------------------------------------- 
+
+void large_message_capped(void **state);
+// -------------------------------------------------------------------------------- 
+
+void large_message_truncation_marked(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST VECTORED WRITES 
+
+void writev_matches_concatenation(void **state);
+// -------------------------------------------------------------------------------- 
+
+void writev_macro_and_errors(void **state);
+// -------------------------------------------------------------------------------- 
+
+void writev_large_record_single_line(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST BATCH WRITES 
+
+void batch_matches_single_calls(void **state);
+// -------------------------------------------------------------------------------- 
+
+void batch_keeps_order_and_repeats(void **state);
+// -------------------------------------------------------------------------------- 
+
+void batch_bad_args(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST STREAMING RECORDS 
+
+void record_stream_builds_one_line(void **state);
+// -------------------------------------------------------------------------------- 
+
+void record_stream_limits_and_errors(void **state);
+// -------------------------------------------------------------------------------- 
+
+void record_stream_not_interleaved(void **state);
+// -------------------------------------------------------------------------------- 
+
+void record_stream_abort_and_busy(void **state);
+// -------------------------------------------------------------------------------- 
+
+void record_stream_rejects_other_thread(void **state);
+// ================================================================================ 
+// ================================================================================ 
+// TEST HEX DUMPS 
+
+void hexdump_text_is_canonical(void **state);
+// -------------------------------------------------------------------------------- 
+
+void hexdump_machine_formats(void **state);
+// -------------------------------------------------------------------------------- 
+
+void hexdump_large_payload_one_record(void **state);
 // ================================================================================ 
 // ================================================================================ 
 #endif /* test_H */
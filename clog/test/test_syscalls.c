@@ -0,0 +1,302 @@
+// ================================================================================
+// ================================================================================
+// - File:    test_syscalls.c
+// - Purpose: Upper bounds on the system calls the write path issues per record.
+//            write(2) calls are read from /proc/self/io; isatty/ioctl/fsync
+//            are interposed here, so this is its own test executable.
+//
+// Source Metadata
+// - Author:  Jonathan A. Webb
+// - Date:    August 31, 2022
+// - Version: 1.0
+// - Copyright: Copyright 2022, Jon Webb Inc.
+// ================================================================================
+// ================================================================================
+// Include modules here
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <pty.h>
+#include <cmocka.h>
+
+#include "logger.h"
+// ================================================================================
+// ================================================================================
+
+#define SYSCALL_TEST_RECORDS 20000u
+#define SYSCALL_TEST_BUFFER  (64u * 1024u)
+
+static atomic_ulong g_isatty;
+static atomic_ulong g_ioctl;
+static atomic_ulong g_fsync;
+
+// --------------------------------------------------------------------------------
+
+int isatty(int fd) {
+    static int (*real)(int);
+    if (!real) *(void**)&real = dlsym(RTLD_NEXT, "isatty");
+    atomic_fetch_add(&g_isatty, 1u);
+    return real(fd);
+}
+
+// --------------------------------------------------------------------------------
+
+int ioctl(int fd, unsigned long req, ...) {
+    static int (*real)(int, unsigned long, ...);
+    if (!real) *(void**)&real = dlsym(RTLD_NEXT, "ioctl");
+    va_list ap;
+    va_start(ap, req);
+    void* arg = va_arg(ap, void*);
+    va_end(ap);
+    atomic_fetch_add(&g_ioctl, 1u);
+    return real(fd, req, arg);
+}
+
+// --------------------------------------------------------------------------------
+
+int fsync(int fd) {
+    static int (*real)(int);
+    if (!real) *(void**)&real = dlsym(RTLD_NEXT, "fsync");
+    atomic_fetch_add(&g_fsync, 1u);
+    return real(fd);
+}
+
+// --------------------------------------------------------------------------------
+
+int fdatasync(int fd) {
+    static int (*real)(int);
+    if (!real) *(void**)&real = dlsym(RTLD_NEXT, "fdatasync");
+    atomic_fetch_add(&g_fsync, 1u);
+    return real(fd);
+}
+
+// --------------------------------------------------------------------------------
+
+/* Write-type syscalls (write, writev, pwrite...) issued by this process so
+   far, or -1 when the kernel has no per-task I/O accounting. */
+static long long syscw(void) {
+    FILE* f = fopen("/proc/self/io", "r");
+    if (!f) return -1;
+    char line[128];
+    long long n = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "syscw: %lld", &n) == 1) break;
+    }
+    fclose(f);
+    return n;
+}
+
+// --------------------------------------------------------------------------------
+
+typedef struct {
+    long long     writes;
+    unsigned long isatty;
+    unsigned long ioctl;
+    unsigned long fsync;
+    uint64_t      bytes;
+    uint64_t      flushes;
+} syscall_count;
+
+/* Logs 'n' records (every 'error_every'-th at ERROR, 0 = never), closes the
+   Logger and reports what it cost. The final flush in logger_close() is
+   included. */
+static syscall_count run_records(Logger* lg, unsigned n, unsigned error_every) {
+    syscall_count c;
+    atomic_store(&g_isatty, 0u);
+    atomic_store(&g_ioctl, 0u);
+    atomic_store(&g_fsync, 0u);
+    logger_reset_stats(lg);
+    long long w0 = syscw();
+    for (unsigned i = 0; i < n; ++i) {
+        LogLevel lvl = (error_every && i % error_every == 0) ? LOG_ERROR : LOG_INFO;
+        logger_log_impl(lg, lvl, __FILE__, __LINE__, __func__,
+                        "request %u finished with status %d in %.3f ms", i, 200, (double)i * 0.01);
+    }
+    LoggerStats st;
+    assert_true(logger_get_stats(lg, &st));
+    logger_close(lg);
+    c.writes  = syscw() - w0;
+    c.isatty  = atomic_load(&g_isatty);
+    c.ioctl   = atomic_load(&g_ioctl);
+    c.fsync   = atomic_load(&g_fsync);
+    c.bytes   = st.bytes[LOGGER_SINK_STREAM] + st.bytes[LOGGER_SINK_FILE];
+    c.flushes = st.flushes;
+    return c;
+}
+
+// --------------------------------------------------------------------------------
+
+static void assert_no_control_calls(const syscall_count* c) {
+    assert_int_equal(c->isatty, 0);
+    assert_int_equal(c->ioctl, 0);
+    assert_int_equal(c->fsync, 0);
+}
+
+// --------------------------------------------------------------------------------
+
+/* One write(2) per full buffer, plus the final partial buffer. */
+static long long buffered_bound(uint64_t bytes) {
+    return (long long)(bytes / SYSCALL_TEST_BUFFER) + 1;
+}
+
+// --------------------------------------------------------------------------------
+
+static char* temp_path(void) {
+    static char path[64];
+    strcpy(path, "/tmp/clog_syscalls_XXXXXX");
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    close(fd);
+    return path;
+}
+
+// --------------------------------------------------------------------------------
+
+static char g_file_buf[SYSCALL_TEST_BUFFER];
+static char g_stream_buf[SYSCALL_TEST_BUFFER];
+// ================================================================================
+// ================================================================================
+// TEST SYSCALL BUDGET
+
+void syscalls_file_buffered(void **state) {
+    (void)state;
+    if (syscw() < 0) skip();
+    static const LoggerFlushPolicy policies[] = { LOGGER_FLUSH_BUFFERED, LOGGER_FLUSH_ON_ERROR };
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        char* path = temp_path();
+        Logger lg;
+        assert_true(logger_init_file_buffered(&lg, path, LOG_INFO, g_file_buf, sizeof(g_file_buf)));
+        assert_true(logger_set_flush_policy(&lg, policies[p]));
+        syscall_count c = run_records(&lg, SYSCALL_TEST_RECORDS, 0);
+        assert_true(c.bytes > 4u * SYSCALL_TEST_BUFFER);
+        assert_true(c.writes <= buffered_bound(c.bytes));
+        assert_int_equal(c.flushes, 0);
+        assert_no_control_calls(&c);
+        remove(path);
+    }
+}
+
+// --------------------------------------------------------------------------------
+
+void syscalls_file_flush_on_error(void **state) {
+    (void)state;
+    if (syscw() < 0) skip();
+    char* path = temp_path();
+    Logger lg;
+    assert_true(logger_init_file_buffered(&lg, path, LOG_INFO, g_file_buf, sizeof(g_file_buf)));
+    syscall_count c = run_records(&lg, SYSCALL_TEST_RECORDS, 100u);
+    assert_int_equal(c.flushes, SYSCALL_TEST_RECORDS / 100u);
+    assert_true(c.writes <= (long long)c.flushes + buffered_bound(c.bytes));
+    assert_no_control_calls(&c);
+    remove(path);
+}
+
+// --------------------------------------------------------------------------------
+
+void syscalls_file_flush_always(void **state) {
+    (void)state;
+    if (syscw() < 0) skip();
+    char* path = temp_path();
+    Logger lg;
+    assert_true(logger_init_file_buffered(&lg, path, LOG_INFO, g_file_buf, sizeof(g_file_buf)));
+    assert_true(logger_set_flush_policy(&lg, LOGGER_FLUSH_ALWAYS));
+    syscall_count c = run_records(&lg, 1000u, 0);
+    assert_true(c.writes <= 1000);
+    assert_no_control_calls(&c);
+    remove(path);
+}
+
+// --------------------------------------------------------------------------------
+
+void syscalls_dual_buffered(void **state) {
+    (void)state;
+    if (syscw() < 0) skip();
+    char* path = temp_path();
+    FILE* tmp = tmpfile();
+    assert_non_null(tmp);
+    assert_int_equal(setvbuf(tmp, g_stream_buf, _IOFBF, sizeof(g_stream_buf)), 0);
+    Logger lg;
+    assert_true(logger_init_dual(&lg, path, tmp, LOG_INFO));
+    setvbuf(lg.file, g_file_buf, _IOFBF, sizeof(g_file_buf));  /* before any I/O */
+    syscall_count c = run_records(&lg, SYSCALL_TEST_RECORDS, 0);
+    /* Each sink got half of the bytes. */
+    assert_true(c.writes <= 2 * buffered_bound(c.bytes / 2u));
+    assert_no_control_calls(&c);
+    fclose(tmp);
+    remove(path);
+}
+
+// --------------------------------------------------------------------------------
+
+void syscalls_tty_line_buffered(void **state) {
+    (void)state;
+    if (syscw() < 0) skip();
+    int master = -1, slave = -1;
+    if (openpty(&master, &slave, NULL, NULL, NULL) != 0) skip();
+    FILE* tty = fdopen(slave, "w");
+    assert_non_null(tty);
+    Logger lg;
+    assert_true(logger_init_stream(&lg, tty, LOG_INFO));  /* isatty once, here */
+    syscall_count c = run_records(&lg, 16u, 0);           /* fits the pty buffer */
+    assert_true(c.writes <= 16);                          /* one per line */
+    assert_no_control_calls(&c);
+    fclose(tty);
+    close(master);
+}
+// --------------------------------------------------------------------------------
+
+void syscalls_batch_one_flush(void **state) {
+    (void)state;
+    if (syscw() < 0) skip();
+    char* path = temp_path();
+    Logger lg;
+    assert_true(logger_init_file_buffered(&lg, path, LOG_INFO, g_file_buf, sizeof(g_file_buf)));
+    assert_true(logger_set_flush_policy(&lg, LOGGER_FLUSH_ALWAYS));
+    const LogSite site = { __FILE__, __LINE__, __func__ };
+    LogRecord recs[200];
+    for (size_t i = 0; i < 200u; ++i) {
+        recs[i] = (LogRecord){ LOG_INFO, &site, "batched record", (size_t)-1, NULL, 0 };
+    }
+    logger_reset_stats(&lg);
+    long long w0 = syscw();
+    logger_write_batch(&lg, recs, 200u);
+    long long writes = syscw() - w0;
+    LoggerStats st;
+    assert_true(logger_get_stats(&lg, &st));
+    assert_int_equal(st.flushes, 1);   /* not one per record */
+    assert_true(writes <= 1);
+    logger_close(&lg);
+    remove(path);
+}
+// ================================================================================
+// ================================================================================
+
+const struct CMUnitTest test_syscalls[] = {
+    cmocka_unit_test(syscalls_file_buffered),
+    cmocka_unit_test(syscalls_file_flush_on_error),
+    cmocka_unit_test(syscalls_file_flush_always),
+    cmocka_unit_test(syscalls_dual_buffered),
+    cmocka_unit_test(syscalls_tty_line_buffered),
+    cmocka_unit_test(syscalls_batch_one_flush),
+};
+// ================================================================================
+// ================================================================================
+
+int main(void) {
+    return cmocka_run_group_tests(test_syscalls, NULL, NULL);
+}
+// ================================================================================
+// ================================================================================
+// eof
@@ -33,6 +33,7 @@ const struct CMUnitTest test_init[] = {
     cmocka_unit_test(init_file_null_logger),
     cmocka_unit_test(init_file_null_path),
     cmocka_unit_test(init_file_open_fail_bad_parent),
+    cmocka_unit_test(init_file_buffered_bad_args),
     /* init_dual_* */
     cmocka_unit_test(init_dual_null_logger),
     cmocka_unit_test(init_dual_null_path),
@@ -85,6 +86,149 @@ const struct CMUnitTest test_misra[] = {
     cmocka_unit_test(write_timestamp_toggle),
     cmocka_unit_test(write_errno_null_args),
     cmocka_unit_test(write_name_toggle),
+    cmocka_unit_test(write_n_uses_exact_length),
+    cmocka_unit_test(write_n_errno_null_args),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_category[] = {
+    cmocka_unit_test(category_inherits_from_ancestor),
+    cmocka_unit_test(category_macro_filters_and_tags),
+    cmocka_unit_test(category_follows_root_level),
+    cmocka_unit_test(category_errno_null_args),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_ratelimit[] = {
+    cmocka_unit_test(every_n_emits_period_and_count),
+    cmocka_unit_test(ratelimit_allows_burst_then_drops),
+    cmocka_unit_test(ratelimit_reports_suppressed),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_repeat[] = {
+    cmocka_unit_test(repeat_collapse_summarizes_run),
+    cmocka_unit_test(repeat_collapse_counts_and_flushes),
+    cmocka_unit_test(repeat_collapse_distinguishes_sites),
+    cmocka_unit_test(repeat_collapse_disabled_by_default),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_budget[] = {
+    cmocka_unit_test(budget_throttles_noisy_site),
+    cmocka_unit_test(budget_drop_keeps_suppressed_count),
+    cmocka_unit_test(budget_restores_when_quiet),
+    cmocka_unit_test(budget_evicts_idle_sites),
+    cmocka_unit_test(budget_charges_message_bytes),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_sampling[] = {
+    cmocka_unit_test(sample_probability_bounds),
+    cmocka_unit_test(sample_keyed_is_deterministic),
+    cmocka_unit_test(sample_macro_skips_arguments),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_kv[] = {
+    cmocka_unit_test(kv_text_renders_fields),
+    cmocka_unit_test(kv_text_escapes_control_bytes),
+    cmocka_unit_test(kv_keys_are_sanitized),
+    cmocka_unit_test(kv_reserved_keys_prefixed),
+    cmocka_unit_test(kv_filters_and_validates),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_json[] = {
+    cmocka_unit_test(json_format_fields),
+    cmocka_unit_test(json_escaping_matches_reference),
+    cmocka_unit_test(utf8_invalid_bytes_replaced),
+    cmocka_unit_test(json_oversized_record_stays_valid),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_logfmt[] = {
+    cmocka_unit_test(logfmt_format_and_quoting),
+    cmocka_unit_test(prefix_cache_tracks_layout_changes),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_cbor[] = {
+    cmocka_unit_test(cbor_round_trips_to_json),
+    cmocka_unit_test(cbor_encoding_is_exact),
+    cmocka_unit_test(cbor_decode_rejects_bad_input),
+    cmocka_unit_test(cbor_decode_null_line),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_otlp[] = {
+    cmocka_unit_test(otlp_frame_is_exact),
+    cmocka_unit_test(otlp_frames_and_attributes),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_stats[] = {
+    cmocka_unit_test(stats_count_records_and_bytes),
+    cmocka_unit_test(stats_count_write_errors),
+    cmocka_unit_test(stats_measure_lock_wait),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_latency[] = {
+    cmocka_unit_test(latency_histogram_records_calls),
+    cmocka_unit_test(latency_percentile_bucket_edges),
+    cmocka_unit_test(latency_add_matches_recorder),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_prometheus[] = {
+    cmocka_unit_test(prometheus_export_writes_textfile),
+    cmocka_unit_test(prometheus_exporter_thread_publishes),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_trace[] = {
+    cmocka_unit_test(trace_records_call_shapes),
+    cmocka_unit_test(trace_overflow_counts_dropped),
+    cmocka_unit_test(trace_save_load_roundtrip),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_large[] = {
+    cmocka_unit_test(large_message_not_truncated),
+    cmocka_unit_test(large_message_otlp_frame),
+    cmocka_unit_test(large_message_capped),
+    cmocka_unit_test(large_message_truncation_marked),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_writev[] = {
+    cmocka_unit_test(writev_matches_concatenation),
+    cmocka_unit_test(writev_macro_and_errors),
+    cmocka_unit_test(writev_large_record_single_line),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_batch[] = {
+    cmocka_unit_test(batch_matches_single_calls),
+    cmocka_unit_test(batch_keeps_order_and_repeats),
+    cmocka_unit_test(batch_bad_args),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_record_stream[] = {
+    cmocka_unit_test(record_stream_builds_one_line),
+    cmocka_unit_test(record_stream_limits_and_errors),
+    cmocka_unit_test(record_stream_not_interleaved),
+    cmocka_unit_test(record_stream_abort_and_busy),
+    cmocka_unit_test(record_stream_rejects_other_thread),
+};
+// -------------------------------------------------------------------------------- 
+
+const struct CMUnitTest test_hexdump[] = {
+    cmocka_unit_test(hexdump_text_is_canonical),
+    cmocka_unit_test(hexdump_machine_formats),
+    cmocka_unit_test(hexdump_large_payload_one_record),
 };
 // ================================================================================ 
 // ================================================================================ 
@@ -110,6 +254,63 @@ int main(int argc, const char * argv[]) {
     if (status != 0)
         return status;
     status = cmocka_run_group_tests(test_misra, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_category, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_ratelimit, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_repeat, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_budget, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_sampling, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_kv, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_json, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_logfmt, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_cbor, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_otlp, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_stats, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_latency, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_prometheus, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_trace, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_large, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_writev, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_batch, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_record_stream, NULL, NULL);
+    if (status != 0)
+        return status;
+    status = cmocka_run_group_tests(test_hexdump, NULL, NULL);
     return status;
 }
 // ================================================================================
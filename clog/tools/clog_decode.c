@@ -0,0 +1,115 @@
+// ================================================================================
+// ================================================================================
+// - File:    clog_decode.c
+// - Purpose: Convert a LOGGER_FORMAT_CBOR log stream back into text, JSON
+//            or logfmt lines
+//
+// Source Metadata
+// - Author:  Jonathan A. Webb
+// - Date:    October 16, 2026
+// - Version: 1.0
+// - Copyright: Copyright 2026, Jon Webb Inc.
+// ================================================================================
+// ================================================================================
+// Include modules here
+
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+// ================================================================================ 
+// ================================================================================ 
+
+static void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-f text|json|logfmt] [file]\n"
+                    "Reads a CBOR log stream from file (or stdin) and writes one line per record.\n",
+            prog);
+}
+// -------------------------------------------------------------------------------- 
+
+static char* read_all(FILE* in, size_t* out_len) {
+    size_t cap = 1 << 16, len = 0;
+    char* buf = malloc(cap);
+    while (buf) {
+        len += fread(buf + len, 1, cap - len, in);
+        if (len < cap) break;
+        char* grown = realloc(buf, cap * 2);
+        if (!grown) { free(buf); return NULL; }
+        buf = grown;
+        cap *= 2;
+    }
+    if (buf && ferror(in)) { free(buf); return NULL; }
+    *out_len = len;
+    return buf;
+}
+// ================================================================================ 
+// ================================================================================ 
+
+int main(int argc, char* argv[]) {
+    LoggerFormat format = LOGGER_FORMAT_TEXT;
+    const char* path = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            const char* f = argv[++i];
+            if (strcmp(f, "text") == 0)        format = LOGGER_FORMAT_TEXT;
+            else if (strcmp(f, "json") == 0)   format = LOGGER_FORMAT_JSON;
+            else if (strcmp(f, "logfmt") == 0) format = LOGGER_FORMAT_LOGFMT;
+            else { usage(argv[0]); return 2; }
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    FILE* in = path ? fopen(path, "rb") : stdin;
+    if (!in) {
+        fprintf(stderr, "clog_decode: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    size_t len = 0;
+    char* data = read_all(in, &len);
+    if (in != stdin) fclose(in);
+    if (!data) {
+        fprintf(stderr, "clog_decode: read failed\n");
+        return 1;
+    }
+
+    int status = 0;
+    size_t cap = (size_t)1 << 16;
+    char* line = malloc(cap);
+    for (size_t pos = 0; line && pos < len; ) {
+        size_t used = 0, n = 0;
+        if (!logger_cbor_decode(data + pos, len - pos, &used, format, line, cap, &n)) {
+            /* Hex dumps and long messages render larger than they encode. */
+            if (errno == ERANGE && cap < ((size_t)1 << 24)) {
+                char* bigger = realloc(line, cap * 2);
+                if (bigger) {
+                    line = bigger;
+                    cap *= 2;
+                    continue;
+                }
+            }
+            fprintf(stderr, "clog_decode: bad record at byte %zu: %s\n", pos, strerror(errno));
+            status = 1;
+            break;
+        }
+        fwrite(line, 1, n, stdout);
+        pos += used;
+    }
+    if (!line) {
+        fprintf(stderr, "clog_decode: out of memory\n");
+        status = 1;
+    }
+
+    free(line);
+    free(data);
+    return status;
+}
+// ================================================================================
+// ================================================================================
+// eof